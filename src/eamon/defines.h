@@ -85,10 +85,22 @@
  * Settings IDs for the virtual machine
  */
 #define SETTING_VM_SLOWDOWN "vm/slowdown"
+#define SETTING_VM_APPLE2_SPEED "vm/apple2speed"
+#define SETTING_VM_THREADED_DISPATCH "vm/threadeddispatch"
+#define SETTING_VM_SUPERINSTRUCTIONS "vm/superinstructions"
+#define SETTING_VM_REGISTER_BACKEND "vm/registerbackend"
+#define SETTING_VM_JIT "vm/jit"
+#define SETTING_VM_NATIVE_MODULES "vm/nativemodules"
 /*
  * Settings value for the virtual machine
  */
 #define SETTING_VALUE_VM_SLOWDOWN 0
+#define SETTING_VALUE_VM_APPLE2_SPEED false
+#define SETTING_VALUE_VM_THREADED_DISPATCH true
+#define SETTING_VALUE_VM_SUPERINSTRUCTIONS true
+#define SETTING_VALUE_VM_REGISTER_BACKEND false
+#define SETTING_VALUE_VM_JIT true
+#define SETTING_VALUE_VM_NATIVE_MODULES false
 
 /*
  * Settings IDs for general behaviour
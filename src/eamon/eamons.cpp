@@ -22,6 +22,7 @@
 
 #include "eamons.h"
 #include "runtime/diskfile.h"
+#include "runtime/numberformat.h"
 #include <QDomDocument>
 #include <QFile>
 #include <sstream>
@@ -81,7 +82,7 @@ bool Eamons::exportCharacters(const std::string &filename) const
   std::filesystem::path p = std::filesystem::path(main_hall) / "characters";
   DiskFile file(p.string(),150);
   file.setIndex(0,true);
-  int n = std::stoi(file.read());
+  int n = NumberFormat::scanInt(file.read());
   for (int i=0;i<n;i++)
   {
     file.setIndex(i+1,true);
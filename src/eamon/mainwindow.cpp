@@ -40,12 +40,14 @@
 #include <QFile>
 #include <QTextStream>
 #include <QSettings>
+#include <QStandardPaths>
 #include <QFont>
 #include <QFontMetrics>
 #include <QSyntaxHighlighter>
 #include <sstream>
 #include <iostream>
 #include <filesystem>
+#include <fstream>
 
 MainWindow::MainWindow(QWidget *parent) :
   QMainWindow(parent),
@@ -183,7 +185,9 @@ void MainWindow::run(QString file)
   QFileInfo f(currentDisk.absoluteFilePath(file));
   if (f.exists())
   {
+    QSettings settings;
     compiler->reset();
+    compiler->setSuperinstructions(settings.value(SETTING_VM_SUPERINSTRUCTIONS,SETTING_VALUE_VM_SUPERINSTRUCTIONS).toBool());
     executable = std::shared_ptr<Executable>(compiler->compile(f.absoluteFilePath().toStdString()));
     if (!compiler->getErrors().getMessages().empty())
     {
@@ -192,8 +196,29 @@ void MainWindow::run(QString file)
     }
     if (executable)
     {
-      QSettings settings;
       vm->setSlowdown(settings.value(SETTING_VM_SLOWDOWN,SETTING_VALUE_VM_SLOWDOWN).toUInt());
+      if (settings.value(SETTING_VM_APPLE2_SPEED,SETTING_VALUE_VM_APPLE2_SPEED).toBool())
+        vm->setInstructionRate(THROTTLE_APPLE2_RATE);
+      if (settings.value(SETTING_VM_THREADED_DISPATCH,SETTING_VALUE_VM_THREADED_DISPATCH).toBool())
+        vm->setDispatchMode(VM::ThreadedDispatch);
+      else
+        vm->setDispatchMode(VM::SwitchDispatch);
+      if (settings.value(SETTING_VM_REGISTER_BACKEND,SETTING_VALUE_VM_REGISTER_BACKEND).toBool())
+        vm->setBackend(VM::RegisterBackend);
+      else
+        vm->setBackend(VM::StackBackend);
+      vm->setJitEnabled(settings.value(SETTING_VM_JIT,SETTING_VALUE_VM_JIT).toBool());
+      if (settings.value(SETTING_VM_NATIVE_MODULES,SETTING_VALUE_VM_NATIVE_MODULES).toBool())
+      {
+        QString dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/modules";
+        QDir().mkpath(dir);
+        vm->setNativeModuleDirectory(dir.toStdString());
+      }
+      else
+      {
+        vm->setNativeModuleDirectory("");
+      }
+      vm->setProfile(ui->actionProfile_Op_Codes->isChecked() ? opProfile : nullptr);
       ui->screenWidget->setFocus();
       vm->setDisk(currentDisk.absolutePath().toStdString());
       vmthread->run(executable);
@@ -561,3 +586,29 @@ void MainWindow::on_actionInsert_Master_Disk_triggered()
   vm->setDisk(currentDisk.absolutePath().toStdString());
   ui->currentDiskLabel->setText(currentDisk.dirName());
 }
+
+void MainWindow::on_actionProfile_Op_Codes_toggled(bool checked)
+{
+  /* each profiling session starts with an empty histogram */
+  if (checked) opProfile = std::make_shared<OpProfile>();
+  ui->actionSave_Op_Code_Profile->setEnabled(opProfile != nullptr);
+}
+
+void MainWindow::on_actionSave_Op_Code_Profile_triggered()
+{
+  if (!opProfile) return;
+  QSettings settings;
+  QString path = settings.value(SETTING_PATH_EXPORT,SETTING_VALUE_PATH_EXPORT).toString();
+  QString fn = QFileDialog::getSaveFileName(this,QApplication::applicationDisplayName(),path,"CSV files(*.csv)");
+  if (!fn.isNull())
+  {
+    QFileInfo info(fn);
+    settings.setValue(SETTING_PATH_EXPORT,info.absolutePath());
+    std::ofstream os(fn.toStdString());
+    if (os) opProfile->save(os);
+    if (!os)
+    {
+      QMessageBox::warning(this,QApplication::applicationDisplayName(),tr("Failed to save op code profile!"));
+    }
+  }
+}
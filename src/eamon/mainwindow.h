@@ -102,6 +102,10 @@ private slots:
 
   void on_actionInsert_Master_Disk_triggered();
 
+  void on_actionProfile_Op_Codes_toggled(bool checked);
+
+  void on_actionSave_Op_Code_Profile_triggered();
+
 private:
   void setupGames();
   void copyMainHall(const std::string& gameDisk);
@@ -118,6 +122,7 @@ private:
   std::shared_ptr<VM> vm;
   Disassembler disassembler;
   std::shared_ptr<Executable> executable;
+  std::shared_ptr<OpProfile> opProfile;
   VMThread* vmthread;
   QDir currentDisk;
   ErrorMessagesDialog* errorDlg;
@@ -24,6 +24,7 @@
 #include "ui_optionsdialog.h"
 #include "defines.h"
 #include "palettefactory.h"
+#include "runtime/vm.h"
 #include <QDebug>
 #include <QStyleFactory>
 
@@ -37,6 +38,9 @@ OptionsDialog::OptionsDialog(QWidget *parent) :
   {
     ui->paletteBox->addItem(key);
   }
+  ui->threadedDispatchBox->setEnabled(VM::isThreadedDispatchAvailable());
+  ui->jitBox->setEnabled(VM::isJitAvailable());
+  ui->nativeModulesBox->setEnabled(NativeModule::isAvailable());
   QSettings settings;
   updateFields(settings);
 }
@@ -73,6 +77,12 @@ void OptionsDialog::commitFields(QSettings &settings)
   QString palette = settings.value(SETTING_STYLE_PALETTE,SETTING_VALUE_STYLE_PALETTE).toString();
   QApplication::setPalette(PaletteFactory::getPalette(palette));
   settings.setValue(SETTING_VM_SLOWDOWN,ui->slowdownBox->value());
+  settings.setValue(SETTING_VM_APPLE2_SPEED,ui->apple2SpeedBox->isChecked());
+  settings.setValue(SETTING_VM_THREADED_DISPATCH,ui->threadedDispatchBox->isChecked());
+  settings.setValue(SETTING_VM_SUPERINSTRUCTIONS,ui->superinstructionsBox->isChecked());
+  settings.setValue(SETTING_VM_REGISTER_BACKEND,ui->registerBackendBox->isChecked());
+  settings.setValue(SETTING_VM_JIT,ui->jitBox->isChecked());
+  settings.setValue(SETTING_VM_NATIVE_MODULES,ui->nativeModulesBox->isChecked());
   settings.setValue(SETTING_AUTOSTART,ui->autostartBox->isChecked());
 }
 
@@ -99,5 +109,11 @@ void OptionsDialog::updateFields(const QSettings &settings)
   ui->styleBox->setCurrentText(settings.value(SETTING_STYLE_STYLE,SETTING_VALUE_STYLE_STYLE).toString());
   ui->paletteBox->setCurrentText(settings.value(SETTING_STYLE_PALETTE,SETTING_VALUE_STYLE_PALETTE).toString());
   ui->slowdownBox->setValue(settings.value(SETTING_VM_SLOWDOWN,SETTING_VALUE_VM_SLOWDOWN).toInt());
+  ui->apple2SpeedBox->setChecked(settings.value(SETTING_VM_APPLE2_SPEED,SETTING_VALUE_VM_APPLE2_SPEED).toBool());
+  ui->threadedDispatchBox->setChecked(settings.value(SETTING_VM_THREADED_DISPATCH,SETTING_VALUE_VM_THREADED_DISPATCH).toBool());
+  ui->superinstructionsBox->setChecked(settings.value(SETTING_VM_SUPERINSTRUCTIONS,SETTING_VALUE_VM_SUPERINSTRUCTIONS).toBool());
+  ui->registerBackendBox->setChecked(settings.value(SETTING_VM_REGISTER_BACKEND,SETTING_VALUE_VM_REGISTER_BACKEND).toBool());
+  ui->jitBox->setChecked(settings.value(SETTING_VM_JIT,SETTING_VALUE_VM_JIT).toBool());
+  ui->nativeModulesBox->setChecked(settings.value(SETTING_VM_NATIVE_MODULES,SETTING_VALUE_VM_NATIVE_MODULES).toBool());
   ui->autostartBox->setChecked(settings.value(SETTING_AUTOSTART,SETTING_VALUE_AUTOSTART).toBool());
 }
@@ -25,6 +25,7 @@
 #include "op.h"
 #include "compilerdata.h"
 #include "address.h"
+#include "peephole.h"
 #include <stdlib.h>
 #include <string.h>
 #include <iostream>
@@ -265,11 +266,12 @@ void Assembler::assembleBlock(const CodeBlock &block)
   assembleBlock(*block.getCodePtr());
 }
 
-void Assembler::assembleBlock(const Code& ops)
+void Assembler::assembleBlock(const Code& block)
 {
+  const Code ops = data.superinstructions ? Peephole::optimize(block) : block;
   for (const COp& op : ops)
   {
-    if (cptr-code > maxSize - 5) reallocateCode();
+    if (cptr-code > maxSize - 8) reallocateCode();
     if (op.getLabel() > 0) labelAddr[op.getLabel()] = cptr - code;
     if (op.getMnemonic() == OP_NOP)
       continue;
@@ -303,6 +305,10 @@ void Assembler::assembleBlock(const Code& ops)
 //            *cptr++ = storeArray(op.getParameterArray(),op.getParameterType());
 //            break;
       }
+      for (int32_t v : op.getOperands())
+      {
+        *cptr++ = static_cast<uint32_t>(v);
+      }
     }
   }
 }
@@ -323,6 +329,10 @@ void Assembler::resolveLabels()
         {
           *cptr = data.constants.getConstants()[Address::getAddress(*cptr)].getAddress();
         }
+        else if (COp::getType(op) == Type::doubleType)
+        {
+          cptr++; /* the double takes two words */
+        }
         cptr++;
         break;
       case OP_STO:
@@ -330,6 +340,7 @@ void Assembler::resolveLabels()
       case OP_RCL:
       case OP_INC:
       case OP_DEC:
+      case OP_APPEND:
       case OP_CALL:
       case OP_RSZ:
       case OP_CLR:
@@ -348,6 +359,26 @@ void Assembler::resolveLabels()
         *cptr = labelAddr[*cptr];
         cptr++;
         break;
+      case OP_NEXT:
+        *cptr = labelAddr[*cptr];
+        cptr += 5;
+        break;
+      case OP_CMPJZ:
+        *cptr = labelAddr[*cptr];
+        cptr += 4;
+        break;
+      case OP_STOI2:
+      case OP_RCLI2:
+      {
+        /* the stride is only known after all DIM statements are compiled */
+        auto s = data.arrayStrides.find(static_cast<int32_t>(*cptr));
+        cptr[2] = s != data.arrayStrides.end() ? static_cast<uint32_t>(s->second) : 0;
+        cptr += 3;
+        break;
+      }
+      case OP_ARISTO:
+        cptr += 4;
+        break;
       case ASM_LINE:
         cptr++;
         break;
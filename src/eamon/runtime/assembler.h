@@ -52,7 +52,7 @@ private:
 //  uint32_t storeText(const std::string& s);
   uint32_t storeArray(const std::vector<TypedValue>& values, Type type);
   void assembleBlock(const CodeBlock& block);
-  void assembleBlock(const Code& code);
+  void assembleBlock(const Code& block);
   void resolveLabels();
   void checkIdentifierLength(std::string name);
 
@@ -21,6 +21,7 @@
  ********************************************************************************/
 
 #include "compiler.h"
+#include "address.h"
 #include "library.h"
 #include "assembler.h"
 #include "executable.h"
@@ -90,6 +91,11 @@ const Errors& Compiler::getErrors() const
   return errors;
 }
 
+void Compiler::setSuperinstructions(bool flag)
+{
+  data.superinstructions = flag;
+}
+
 void Compiler::reset()
 {
   errors.clear();
@@ -126,11 +132,17 @@ void Compiler::createDimVar(std::string name, int ndim, const yy::Parser::locati
 //  std::cout << name << " " << std::endl;
   name = normalizeVar(name) + arrayIndicator;
   Variable v = data.globalVariables.findVariable(name);
-  if (!v)
+  bool created = !v;
+  if (created)
   {
     Variable nv(name,getType(name).getArrayType());
     data.globalVariables.addVariable(nv);
+    v = data.globalVariables.findVariable(name);
   }
+  /* an array used before it is dimensioned has the stride read at runtime */
+  int32_t stride = ndim == 2 ? getConstantStride() : 0;
+  auto s = data.arrayStrides.emplace(static_cast<int32_t>(v.getAddress()),created ? stride : 0);
+  if (!s.second && s.first->second != stride) s.first->second = 0;
   v = data.globalVariables.findVariable(name+"dim1");
   if (!v)
   {
@@ -270,41 +282,46 @@ void Compiler::createOperator(const std::string& op, const yy::Parser::location_
   Type t = Type::resultType(t1,t2);
   COp cop;
   if (op == "+")
-    code->push_back(COp(OP_ARIADD));
+  {
+    if (t1 == Type::stringType && t2 == Type::stringType)
+      code->push_back(COp(OP_CONCAT));
+    else
+      code->push_back(COp(selectArithmeticOp(t1,t2,OP_ARIADD,OP_ADDI,OP_ADDD)));
+  }
   else if (op == "-")
-    code->push_back(COp(OP_ARISUB));
+    code->push_back(COp(selectArithmeticOp(t1,t2,OP_ARISUB,OP_SUBI,OP_SUBD)));
   else if (op == "*")
-    code->push_back(COp(OP_ARIMUL));
+    code->push_back(COp(selectArithmeticOp(t1,t2,OP_ARIMUL,OP_MULI,OP_MULD)));
   else if (op == "/")
-    code->push_back(COp(OP_ARIDIV));
+    code->push_back(COp(selectArithmeticOp(t1,t2,OP_ARIDIV,OP_DIVI,OP_DIVD)));
   else if (op == "=")
   {
-    code->push_back(COp(OP_ARIEQ));
+    code->push_back(COp(selectCompareOp(t1,t2,OP_ARIEQ,OP_EQN)));
     t = Type::int32Type;
   }
   else if (op == "<>")
   {
-    code->push_back(COp(OP_ARINE));
+    code->push_back(COp(selectCompareOp(t1,t2,OP_ARINE,OP_NEN)));
     t = Type::int32Type;
   }
   else if (op == ">")
   {
-    code->push_back(COp(OP_ARIGT));
+    code->push_back(COp(selectCompareOp(t1,t2,OP_ARIGT,OP_GTN)));
     t = Type::int32Type;
   }
   else if (op == "<")
   {
-    code->push_back(COp(OP_ARILT));
+    code->push_back(COp(selectCompareOp(t1,t2,OP_ARILT,OP_LTN)));
     t = Type::int32Type;
   }
   else if (op == ">=")
   {
-    code->push_back(COp(OP_ARIGE));
+    code->push_back(COp(selectCompareOp(t1,t2,OP_ARIGE,OP_GEN)));
     t = Type::int32Type;
   }
   else if (op == "<=")
   {
-    code->push_back(COp(OP_ARILE));
+    code->push_back(COp(selectCompareOp(t1,t2,OP_ARILE,OP_LEN)));
     t = Type::int32Type;
   }
   else if (op == "&&")
@@ -320,6 +337,43 @@ void Compiler::createOperator(const std::string& op, const yy::Parser::location_
   typeStack->push_back(t);
 }
 
+void Compiler::markConcatOperand()
+{
+  appendData.operands.push_back(code->size());
+}
+
+void Compiler::createConcat(const yy::Parser::location_type &l)
+{
+  size_t operand = appendData.operands.back();
+  appendData.operands.pop_back();
+  createOperator("+",l);
+  if (appendData.active && typeStack->size() == appendData.depth + 1)
+  {
+    appendData.tail.push_back(std::make_pair(operand,code->size()-1));
+  }
+}
+
+void Compiler::startStringAssignment()
+{
+  appendData.active = true;
+  appendData.start = code->size();
+  appendData.depth = typeStack->size();
+  appendData.tail.clear();
+}
+
+int32_t Compiler::selectArithmeticOp(Type t1, Type t2, int32_t generic, int32_t int32Op, int32_t doubleOp)
+{
+  if (t1 == Type::int32Type && t2 == Type::int32Type) return int32Op;
+  if ((t1 == Type::int32Type || t1 == Type::doubleType) && (t2 == Type::int32Type || t2 == Type::doubleType)) return doubleOp;
+  return generic;
+}
+
+int32_t Compiler::selectCompareOp(Type t1, Type t2, int32_t generic, int32_t numericOp)
+{
+  if ((t1 == Type::int32Type || t1 == Type::doubleType) && (t2 == Type::int32Type || t2 == Type::doubleType)) return numericOp;
+  return generic;
+}
+
 void Compiler::createNegate()
 {
   if (typeStack->back().isNumericType())
@@ -354,6 +408,32 @@ void Compiler::createArrayOffset(std::string name, int32_t ndim, const yy::Parse
 {
   name = normalizeVar(name);
   std::string var = name + arrayIndicator;
+  Variable v = createArray(name,ndim,l);
+  if (ndim == 2)
+  {
+    v = data.globalVariables.findVariable(var+"dim1"); /* column major memory */
+    COp cop(OP_RCL,v.getType());
+    cop.setParameter(static_cast<int32_t>(v.getAddress()));
+    code->push_back(cop);
+    typeStack->push_back(v.getType());
+    createOperator("*",l);
+    createOperator("+",l);
+  }
+  typeStack->back();
+  if (typeStack->back() != Type::int32Type)
+  {
+    code->push_back(COp(OP_CAST,Type::int32Type));
+    typeStack->back() = Type::int32Type;
+  }
+}
+
+/*
+ * Finds the array variable; an array used without DIM statement gets 11
+ * elements per dimension.
+ */
+Variable Compiler::createArray(const std::string& name, int32_t ndim, const yy::Parser::location_type &l)
+{
+  std::string var = name + arrayIndicator;
 //  if (userFunction) v = userFunction->f.localvars.findVariable(var);
   Variable v = data.globalVariables.findVariable(var);
   if (!v)
@@ -384,24 +464,34 @@ void Compiler::createArrayOffset(std::string name, int32_t ndim, const yy::Parse
   {
 //    parser->error(yy::Parser::syntax_error(l,"Variable '"+name+"' is already used as a scalar variable"));
     throw yy::Parser::syntax_error(l,"Variable '"+name+"' is already used as a scalar variable");
-    return;
   }
-  if (ndim == 2)
-  {
-    v = data.globalVariables.findVariable(var+"dim1"); /* column major memory */
-    COp cop(OP_RCL,v.getType());
-    cop.setParameter(static_cast<int32_t>(v.getAddress()));
-    code->push_back(cop);
-    typeStack->push_back(v.getType());
-    createOperator("*",l);
-    createOperator("+",l);
-  }
-  typeStack->back();
-  if (typeStack->back() != Type::int32Type)
+  return v;
+}
+
+void Compiler::createArrayIndices(std::string name, const yy::Parser::location_type &l)
+{
+  auto isNumber = [](const Type& t){ return t == Type::int32Type || t == Type::doubleType; };
+  if (typeStack->size() < 2 || !isNumber(typeStack->back()) || !isNumber((*typeStack)[typeStack->size()-2]))
   {
-    code->push_back(COp(OP_CAST,Type::int32Type));
-    typeStack->back() = Type::int32Type;
+    createArrayOffset(name,2,l);
+    return;
   }
+  createArray(normalizeVar(name),2,l);
+  arrayIndices.push_back(typeStack->size());
+}
+
+/*
+ * DIM A(d1,d2) is compiled after "push d1, push d2", so constant dimensions
+ * are the operands of the last two ops.
+ */
+int32_t Compiler::getConstantStride() const
+{
+  if (code->size() < 2) return 0;
+  const COp& d1 = (*code)[code->size()-2];
+  const COp& d2 = (*code)[code->size()-1];
+  if (d1.getMnemonic() != OP_PUSH || d1.getParameterType() != Type::int32Type || d1.getType() != Type::int32Type) return 0;
+  if (d2.getMnemonic() != OP_PUSH || d2.getParameterType() != Type::int32Type || d2.getType() != Type::int32Type || d2.getLabel() > 0) return 0;
+  return d1.getParameterInt32() >= 0 ? d1.getParameterInt32() + 1 : 0;
 }
 
 void Compiler::createInputArrayOffset(int32_t ndim, const yy::Parser::location_type &l)
@@ -419,7 +509,18 @@ void Compiler::store(std::string var, const yy::Parser::location_type &l, bool a
 
 void Compiler::store(const Variable& v, const yy::Parser::location_type &l, bool swap)
 {
-  if (v.getType().isArrayType())
+  if (v.getType().isArrayType() && swap && !arrayIndices.empty() && arrayIndices.back() + 1 == typeStack->size())
+  {
+    /* data on top of the two indices */
+    arrayIndices.pop_back();
+    typeStack->resize(typeStack->size()-3);
+    COp cop(OP_STOI2,v.getType().getScalarType());
+    cop.setParameter(static_cast<int32_t>(v.getAddress()));
+    cop.addOperand(static_cast<int32_t>(data.globalVariables.findVariable(v.getName()+"dim1").getAddress()));
+    cop.addOperand(0); /* the stride is filled in by the assembler */
+    code->push_back(cop);
+  }
+  else if (v.getType().isArrayType())
   {
     if (typeStack->size() < 2)
     {
@@ -448,6 +549,9 @@ void Compiler::store(const Variable& v, const yy::Parser::location_type &l, bool
     {
       throw yy::Parser::syntax_error(l,"Stack underflow in store");
     }
+    bool append = appendData.active && createAppend(v);
+    appendData.active = false;
+    if (append) return;
     typeStack->back();
     typeStack->pop_back();
     COp cop(OP_STO,v.getType());
@@ -456,6 +560,29 @@ void Compiler::store(const Variable& v, const yy::Parser::location_type &l, bool
   }
 }
 
+/*
+ * The code of X$ = X$ + e1 + ... + en is "rcl X$ e1 concat e2 concat ...
+ * en concat", as '+' is left associative. It is rewritten to "e1 e2 concat
+ * ... en concat append X$", so X$ is only modified after all operands were
+ * evaluated.
+ */
+bool Compiler::createAppend(const Variable& v)
+{
+  const AppendData& a = appendData;
+  if (v.getType() != Type::stringType || !Address::isGlobalAddress(v.getAddress())) return false;
+  if (a.tail.empty() || a.tail.front().first != a.start + 1 || a.tail.back().second != code->size() - 1) return false;
+  const COp& first = (*code)[a.start];
+  if (first.getMnemonic() != OP_RCL || first.getType() != Type::stringType || first.getLabel() > 0) return false;
+  if (first.getParameterInt32() != static_cast<int32_t>(v.getAddress())) return false;
+  code->erase(code->begin() + static_cast<std::ptrdiff_t>(a.tail.front().second));
+  code->erase(code->begin() + static_cast<std::ptrdiff_t>(a.start));
+  typeStack->pop_back();
+  COp cop(OP_APPEND,Type::stringType);
+  cop.setParameter(static_cast<int32_t>(v.getAddress()));
+  code->push_back(cop);
+  return true;
+}
+
 void Compiler::recall(std::string var, const yy::Parser::location_type &l, bool array)
 {
   Variable v = findAndCreateVar(var,array,true);
@@ -464,7 +591,18 @@ void Compiler::recall(std::string var, const yy::Parser::location_type &l, bool
 
 void Compiler::recall(const Variable& v, const yy::Parser::location_type &l)
 {
-  if (v.getType().isArrayType())
+  if (v.getType().isArrayType() && !arrayIndices.empty() && arrayIndices.back() == typeStack->size())
+  {
+    arrayIndices.pop_back();
+    typeStack->resize(typeStack->size()-2);
+    COp cop(OP_RCLI2,v.getType().getScalarType());
+    cop.setParameter(static_cast<int32_t>(v.getAddress()));
+    cop.addOperand(static_cast<int32_t>(data.globalVariables.findVariable(v.getName()+"dim1").getAddress()));
+    cop.addOperand(0); /* the stride is filled in by the assembler */
+    code->push_back(cop);
+    typeStack->push_back(v.getType().getScalarType());
+  }
+  else if (v.getType().isArrayType())
   {
     if (typeStack->empty())
     {
@@ -931,6 +1069,7 @@ Executable* Compiler::compile_helper(std::istream& stream)
    labels.clear();
    forLoop.clear();
    ifData.clear();
+   arrayIndices.clear();
    inputData.clear();
    userFunction.reset();
    data.clear();
@@ -77,6 +77,13 @@ public:
    */
   const Errors& getErrors() const;
 
+  /**
+   * @brief Enables or disables the fusion of frequent op code sequences into
+   * superinstructions. Disable it to profile the plain op codes.
+   * @param flag true to create superinstructions
+   */
+  void setSuperinstructions(bool flag);
+
   void reset();
 
   void createLabel(int lineno, const yy::Parser::location_type &l);
@@ -105,12 +112,41 @@ public:
 
   void createOperator(const std::string& op, const yy::Parser::location_type &l);
 
+  /**
+   * @brief Marks the start of the right operand of a string concatenation.
+   */
+  void markConcatOperand();
+
+  /**
+   * @brief Creates a string concatenation.
+   * @param l the location
+   */
+  void createConcat(const yy::Parser::location_type &l);
+
+  /**
+   * @brief Marks the start of the expression of a string assignment.
+   *
+   * An assignment X$ = X$ + expr is compiled into an in place append to X$.
+   */
+  void startStringAssignment();
+
   void createNegate();
 
   void createNot();
 
   void createArrayOffset(std::string var, int32_t ndim, const yy::Parser::location_type &l);
 
+  /**
+   * @brief Prepares the access to an element of a 2-D array.
+   *
+   * Both indices are left on the stack for the OP_RCLI2 or OP_STOI2 of the
+   * following recall() or store(), which combine them with the stride of
+   * the array. Falls back to createArrayOffset() if an index is no number.
+   * @param var the name of the array
+   * @param l the location
+   */
+  void createArrayIndices(std::string var, const yy::Parser::location_type &l);
+
   void createInputArrayOffset(int32_t ndim, const yy::Parser::location_type &l);
 
   /**
@@ -207,6 +243,14 @@ private:
     Code code;
     std::vector<Type> typeStack;
   };
+  struct AppendData
+  {
+    bool active = false;          /* a scalar string assignment is being parsed */
+    size_t start = 0;             /* index of the first op of the expression */
+    size_t depth = 0;             /* type stack depth before the expression */
+    std::vector<size_t> operands; /* start of the right operand of each open concatenation */
+    std::vector<std::pair<size_t,size_t>> tail; /* right operand and op of each top level concatenation */
+  };
   struct UserFunction
   {
     std::string name;
@@ -223,7 +267,14 @@ private:
   std::string normalizeVar(std::string var);
   void store(const Variable& var, const yy::Parser::location_type &l, bool swap);
   void recall(const Variable& var, const yy::Parser::location_type &l);
+  bool createAppend(const Variable& var);
+  Variable createArray(const std::string& name, int32_t ndim, const yy::Parser::location_type &l);
+  /* the stride of a DIM statement whose dimensions are the last two ops */
+  int32_t getConstantStride() const;
   Type getType(const std::string& var);
+  /* select the type specialized op if both operand types are known */
+  int32_t selectArithmeticOp(Type t1, Type t2, int32_t generic, int32_t int32Op, int32_t doubleOp);
+  int32_t selectCompareOp(Type t1, Type t2, int32_t generic, int32_t numericOp);
 
 
   CompilerData data;
@@ -241,6 +292,8 @@ private:
   std::map<std::string,ForLoopData> forLoop;
   std::vector<IfData> ifData;
   std::vector<InputData> inputData;
+  AppendData appendData;
+  std::vector<size_t> arrayIndices; /* type stack depth of the pending indices of 2-D arrays */
   std::unique_ptr<UserFunction> userFunction;
   std::set<int32_t> labels;
   int32_t printCount;
@@ -24,7 +24,8 @@
 #include "library.h"
 
 CompilerData::CompilerData():
-  noDebug(false)
+  noDebug(false),
+  superinstructions(true)
 {
 }
 
@@ -35,5 +36,6 @@ void CompilerData::clear()
   globalVariables.clear();
   codeblock = CodeBlock();
   labelCounter = 1;
+  arrayStrides.clear();
 }
 
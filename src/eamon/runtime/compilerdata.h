@@ -27,6 +27,7 @@
 #include "op.h"
 #include "function.h"
 #include "variable.h"
+#include <map>
 #include <memory>
 
 
@@ -51,9 +52,14 @@ public:
   CodeBlock codeblock;
   /* counter for internally generated Labels */
   int32_t labelCounter;
+  /* stride of the second index of the 2-D arrays by address; 0 if it is
+   * not the same constant in all DIM statements */
+  std::map<int32_t,int32_t> arrayStrides;
 
   /* remove debug information */
   bool noDebug;
+  /* fuse frequent op code sequences into superinstructions */
+  bool superinstructions;
 
 };
 
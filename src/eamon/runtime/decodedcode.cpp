@@ -0,0 +1,244 @@
+/********************************************************************************
+ *                                                                              *
+ * EamonInterpreter - decoded code                                              *
+ *                                                                              *
+ * modified: 2026-10-16                                                         *
+ *                                                                              *
+ ********************************************************************************
+ * Copyright (C) Harald Braeuning                                               *
+ ********************************************************************************
+ * This file is part of EamonInterpreter.                                       *
+ * EamonInterpreter is free software: you can redistribute it and/or modify it  *
+ * under the terms of the GNU General Public License as published by the Free   *
+ * Software Foundation, either version 3 of the License, or (at your option)    *
+ * any later version.                                                           *
+ * EamonInterpreter is distributed in the hope that it will be useful, but      *
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY   *
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for  *
+ * more details.                                                                *
+ * You should have received a copy of the GNU General Public License along with *
+ * EamonInterpreter. If not, see <https://www.gnu.org/licenses/>.               *
+ ********************************************************************************/
+
+#include "decodedcode.h"
+#include "executable.h"
+#include "address.h"
+#include "op.h"
+#include <stdexcept>
+
+
+
+DecodedCode::DecodedCode():
+  globalSize(0)
+{
+}
+
+std::shared_ptr<const DecodedCode> DecodedCode::translate(Executable* x)
+{
+  std::shared_ptr<DecodedCode> dc(new DecodedCode());
+  const uint32_t* code = x->getCode();
+  const uint32_t length = x->getCodeLength() / sizeof(uint32_t);
+  if (length < 2 || COp::getMnemonic(*code) != OP_ENTRY) throw std::runtime_error("Missing entry point in code");
+  const uint32_t* cptr = code + 1;
+  dc->globalSize = *cptr++;
+  /* index of the instruction at each code offset, -1 if no instruction starts there */
+  std::vector<int32_t> index(length+1,-1);
+  /* raw jump targets, resolved once all instructions are decoded */
+  std::vector<uint32_t> targets;
+  while (cptr-code < length)
+  {
+    Instruction in;
+    in.pc = static_cast<uint32_t>(cptr-code);
+    uint32_t op = *cptr++;
+    in.op = COp::getMnemonic(op);
+    in.type = COp::getType(op);
+    in.arg = 0;
+    in.value = nullptr;
+    in.constant = nullptr;
+    in.target = nullptr;
+    in.src1 = 0;
+    in.src2 = 0;
+    in.subop = 0;
+    in.safepoint = false;
+    uint32_t target = 0;
+    switch (in.op)
+    {
+      case OP_PUSH:
+        if (in.type == Type::int32Type)
+        {
+          dc->immediates.push_back(Value(static_cast<int32_t>(*cptr++)));
+          in.value = &dc->immediates.back();
+        }
+        else if (in.type == Type::doubleType)
+        {
+          dc->immediates.push_back(Value(*(reinterpret_cast<const double*>(cptr))));
+          in.value = &dc->immediates.back();
+          cptr += 2;
+        }
+        else if (in.type == Type::stringType)
+        {
+          const std::vector<Value>& c = x->getConstantValues(*cptr++);
+          if (c.empty()) throw std::runtime_error("Illegal getConstant access");
+          in.value = &c.front();
+        }
+        else if (in.type.isArrayType())
+        {
+          in.constant = &x->getConstantValues(*cptr++);
+        }
+        break;
+      case OP_STO:
+      case OP_STOI:
+      case OP_CLR:
+      case OP_APPEND:
+        /* only global variables can be written */
+        if (Address::isGlobalAddress(*cptr))
+          in.arg = Address::getAddress(*cptr);
+        else
+          in.op = OP_NOP;
+        cptr++;
+        break;
+      case OP_STOI2:
+      case OP_RCLI2:
+        /* 2-D arrays are always global variables */
+        in.arg = Address::getAddress(*cptr++);
+        in.src1 = Address::getAddress(*cptr++);
+        in.src2 = *cptr++;
+        break;
+      case OP_RSZ:
+        /* the new size is always taken from the stack */
+        if (Address::isGlobalAddress(*cptr))
+          in.arg = Address::getAddress(*cptr);
+        else
+          in.op = OP_POP;
+        cptr++;
+        break;
+      case OP_RCL:
+      case OP_RCLI:
+        if (Address::isGlobalAddress(*cptr))
+          in.arg = Address::getAddress(*cptr);
+        else if (Address::isConstantAddress(*cptr))
+          in.constant = &x->getConstantValues(*cptr);
+        else
+          in.op = OP_NOP;
+        cptr++;
+        break;
+      case OP_INC:
+      case OP_DEC:
+        if (Address::isConstantAddress(*cptr))
+          in.op = OP_NOP;
+        else
+          in.arg = Address::getAddress(*cptr);
+        cptr++;
+        break;
+      case OP_CALL:
+        in.arg = *cptr++ & 0xFFFF;
+        break;
+      case OP_JSR:
+      case OP_JZ:
+      case OP_JNZ:
+      case OP_JUMP:
+      case OP_ERRHDL:
+        target = *cptr++;
+        break;
+      case OP_NEXT:
+        target = *cptr++;
+        in.arg = Address::getAddress(*cptr++);
+        in.src1 = Address::getAddress(*cptr++);
+        in.src2 = Address::getAddress(*cptr++);
+        in.subop = *cptr++;
+        break;
+      case OP_ARISTO:
+        in.arg = Address::getAddress(*cptr++);
+        in.src1 = Address::getAddress(*cptr++);
+        in.src2 = Address::getAddress(*cptr++);
+        in.subop = *cptr++;
+        break;
+      case OP_CMPJZ:
+        target = *cptr++;
+        in.src1 = Address::getAddress(*cptr++);
+        dc->immediates.push_back(Value(static_cast<int32_t>(*cptr++)));
+        in.value = &dc->immediates.back();
+        in.subop = *cptr++;
+        break;
+      case ASM_LINE:
+        in.arg = *cptr++;
+        break;
+      default:
+        break;
+    }
+    index[in.pc] = static_cast<int32_t>(dc->code.size());
+    dc->code.push_back(in);
+    targets.push_back(target);
+  }
+  /* terminating instruction, also the target of jumps to the end of the code */
+  Instruction end;
+  end.op = OP_END;
+  end.type = Type::undefinedType;
+  end.arg = 0;
+  end.value = nullptr;
+  end.constant = nullptr;
+  end.target = nullptr;
+  end.src1 = 0;
+  end.src2 = 0;
+  end.subop = 0;
+  end.safepoint = true;
+  end.pc = length;
+  index[length] = static_cast<int32_t>(dc->code.size());
+  dc->code.push_back(end);
+  /*
+   * Resolve the jump targets. Targets which do not point to an instruction
+   * are left as nullptr: a jump to such a target raises an error at runtime
+   * and for OP_ERRHDL it clears the error handler.
+   */
+  for (size_t i=0;i<targets.size();i++)
+  {
+    if (targets[i] > 0 && targets[i] <= length && index[targets[i]] >= 0)
+      dc->code[i].target = &dc->code[static_cast<size_t>(index[targets[i]])];
+  }
+  for (Instruction& in : dc->code)
+  {
+    switch (in.op)
+    {
+      case OP_JSR:
+      case OP_RET:
+      case OP_CALL:
+      case OP_END:
+        in.safepoint = true;
+        break;
+      case OP_JZ:
+      case OP_JNZ:
+      case OP_JUMP:
+      case OP_NEXT:
+      case OP_CMPJZ:
+        in.safepoint = in.target == nullptr || in.target <= &in;
+        break;
+    }
+  }
+  return dc;
+}
+
+const Instruction* DecodedCode::getStart() const
+{
+  return code.data();
+}
+
+const Instruction* DecodedCode::getInstruction(int32_t index) const
+{
+  if (index < 0 || static_cast<size_t>(index) >= code.size()) throw std::runtime_error("Illegal code address");
+  return &code[static_cast<size_t>(index)];
+}
+
+int32_t DecodedCode::getIndex(const Instruction* i) const
+{
+  return static_cast<int32_t>(i-code.data());
+}
+
+int32_t DecodedCode::getSize() const
+{
+  return static_cast<int32_t>(code.size());
+}
+
+uint32_t DecodedCode::getGlobalSize() const
+{
+  return globalSize;
+}
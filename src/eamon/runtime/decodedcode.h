@@ -0,0 +1,123 @@
+/********************************************************************************
+ *                                                                              *
+ * EamonInterpreter - decoded code                                              *
+ *                                                                              *
+ * modified: 2026-10-16                                                         *
+ *                                                                              *
+ ********************************************************************************
+ * Copyright (C) Harald Braeuning                                               *
+ ********************************************************************************
+ * This file is part of EamonInterpreter.                                       *
+ * EamonInterpreter is free software: you can redistribute it and/or modify it  *
+ * under the terms of the GNU General Public License as published by the Free   *
+ * Software Foundation, either version 3 of the License, or (at your option)    *
+ * any later version.                                                           *
+ * EamonInterpreter is distributed in the hope that it will be useful, but      *
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY   *
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for  *
+ * more details.                                                                *
+ * You should have received a copy of the GNU General Public License along with *
+ * EamonInterpreter. If not, see <https://www.gnu.org/licenses/>.               *
+ ********************************************************************************/
+
+#ifndef DECODEDCODE_H
+#define DECODEDCODE_H
+
+#include "type.h"
+#include "value.h"
+#include <stdint.h>
+#include <deque>
+#include <memory>
+#include <vector>
+
+
+
+class Executable;
+
+/**
+ * @brief A single instruction of the decoded code.
+ *
+ * All operands are resolved when the code is decoded, so the virtual machine
+ * never has to look at the raw code words again.
+ */
+struct Instruction
+{
+  uint32_t op;                        /**< mnemonic; selects the handler in the dispatch loop */
+  Type type;                          /**< type the op code acts on */
+  uint32_t arg;                       /**< global memory address, line number or library function id */
+  const Value* value;                 /**< immediate value or string constant to push */
+  const std::vector<Value>* constant; /**< constant to recall or array constant to push */
+  const Instruction* target;          /**< jump target */
+  uint32_t src1;                      /**< first source address of a superinstruction */
+  uint32_t src2;                      /**< second source address of a superinstruction */
+  uint32_t subop;                     /**< mnemonic(s) of the operation(s) of a superinstruction */
+  bool safepoint;                     /**< the virtual machine polls for a pause request after this instruction */
+  uint32_t pc;                        /**< offset of the op in the code segment */
+};
+
+/**
+ * @brief The DecodedCode class holds the code segment of an executable
+ * translated into an array of decoded instructions.
+ *
+ * The decoded code is immutable and only refers to data of the executable,
+ * hence it may be shared by all virtual machines running the executable.
+ * The last instruction is always an OP_END.
+ *
+ * Safepoints are the backward jumps, subroutine calls and returns, library
+ * calls and OP_END. Every loop passes a safepoint, so the time between two
+ * safepoints is bounded by the length of the code.
+ */
+class DecodedCode
+{
+public:
+  /**
+   * @brief Translates the code segment of the executable.
+   * @param x the executable
+   * @return the decoded code
+   * @throws runtime_error if the code segment is malformed
+   */
+  static std::shared_ptr<const DecodedCode> translate(Executable* x);
+
+  /**
+   * @brief Returns the first instruction after the entry op.
+   * @return pointer to the first executable instruction
+   */
+  const Instruction* getStart() const;
+
+  /**
+   * @brief Returns the instruction with the given index.
+   * @param index the index of the instruction
+   * @return pointer to the instruction
+   */
+  const Instruction* getInstruction(int32_t index) const;
+
+  /**
+   * @brief Returns the index of an instruction.
+   * @param i pointer to the instruction
+   * @return index of the instruction
+   */
+  int32_t getIndex(const Instruction* i) const;
+
+  /**
+   * @brief Returns the number of instructions including the final OP_END.
+   * @return number of instructions
+   */
+  int32_t getSize() const;
+
+  /**
+   * @brief Returns the global memory size requested by the entry op.
+   * @return size of the global memory
+   */
+  uint32_t getGlobalSize() const;
+
+private:
+  DecodedCode();
+
+  std::vector<Instruction> code;
+  std::deque<Value> immediates; /* storage for the immediate values; never reallocates */
+  uint32_t globalSize;
+};
+
+
+
+#endif // DECODEDCODE_H
@@ -88,6 +88,20 @@ void Disassembler::disassemble(Executable* executable)
         printType(op);
         cptr = printAddr(op,cptr);
         break;
+      case OP_STOI2:
+        *os << "stoi2";
+        printType(op);
+        cptr = printAddr(op,cptr);
+        cptr = printAddr(op,cptr);
+        *os << " " << *cptr++;
+        break;
+      case OP_RCLI2:
+        *os << "rcli2";
+        printType(op);
+        cptr = printAddr(op,cptr);
+        cptr = printAddr(op,cptr);
+        *os << " " << *cptr++;
+        break;
       case OP_DUP:
         *os << "dup";
         break;
@@ -112,6 +126,55 @@ void Disassembler::disassemble(Executable* executable)
       case OP_ARIMOD:
         *os << "mod";
         break;
+      case OP_ADDI:
+        *os << "addi";
+        break;
+      case OP_SUBI:
+        *os << "subi";
+        break;
+      case OP_MULI:
+        *os << "muli";
+        break;
+      case OP_DIVI:
+        *os << "divi";
+        break;
+      case OP_ADDD:
+        *os << "addd";
+        break;
+      case OP_SUBD:
+        *os << "subd";
+        break;
+      case OP_MULD:
+        *os << "muld";
+        break;
+      case OP_DIVD:
+        *os << "divd";
+        break;
+      case OP_CONCAT:
+        *os << "concat";
+        break;
+      case OP_APPEND:
+        *os << "append";
+        cptr = printAddr(op,cptr);
+        break;
+      case OP_EQN:
+        *os << "numeq";
+        break;
+      case OP_NEN:
+        *os << "numne";
+        break;
+      case OP_GEN:
+        *os << "numge";
+        break;
+      case OP_LEN:
+        *os << "numle";
+        break;
+      case OP_GTN:
+        *os << "numgt";
+        break;
+      case OP_LTN:
+        *os << "numlt";
+        break;
       case OP_CAST:
         *os << "cast";
         printType(op);
@@ -194,6 +257,31 @@ void Disassembler::disassemble(Executable* executable)
         *os << "errhdl";
         cptr = printAddr(op,cptr);
         break;
+      case OP_NEXT:
+        *os << "next";
+        printType(op);
+        cptr = printAddr(op,cptr);
+        cptr = printAddr(op,cptr);
+        cptr = printAddr(op,cptr);
+        cptr = printAddr(op,cptr);
+        for (int i=0;i<4;i++) *os << " " << getMnemonicName((*cptr >> (8 * i)) & 0xFF);
+        cptr++;
+        break;
+      case OP_ARISTO:
+        *os << "aristo";
+        printType(op);
+        cptr = printAddr(op,cptr);
+        cptr = printAddr(op,cptr);
+        cptr = printAddr(op,cptr);
+        *os << " " << getMnemonicName(*cptr++);
+        break;
+      case OP_CMPJZ:
+        *os << "cmpjz";
+        cptr = printAddr(op,cptr);
+        cptr = printAddr(op,cptr);
+        *os << " " << static_cast<int32_t>(*cptr++);
+        *os << " " << getMnemonicName(*cptr++);
+        break;
       case OP_END:
         *os << "end";
         break;
@@ -210,6 +298,140 @@ void Disassembler::disassemble(Executable* executable)
 
 
 
+std::string Disassembler::getMnemonicName(uint32_t mnemonic)
+{
+  switch (mnemonic)
+  {
+    case OP_NOP:
+      return "nop";
+    case OP_ENTRY:
+      return "ENTRY";
+    case OP_PUSH:
+      return "push";
+    case OP_POP:
+      return "pop";
+    case OP_STO:
+      return "sto";
+    case OP_STOI:
+      return "stoi";
+    case OP_RCL:
+      return "rcl";
+    case OP_RCLI:
+      return "rcli";
+    case OP_STOI2:
+      return "stoi2";
+    case OP_RCLI2:
+      return "rcli2";
+    case OP_DUP:
+      return "dup";
+    case OP_SWAP:
+      return "swap";
+    case OP_ARIADD:
+      return "add";
+    case OP_ARISUB:
+      return "sub";
+    case OP_ARIMUL:
+      return "mul";
+    case OP_ARIDIV:
+      return "div";
+    case OP_ARIMOD:
+      return "mod";
+    case OP_ADDI:
+      return "addi";
+    case OP_SUBI:
+      return "subi";
+    case OP_MULI:
+      return "muli";
+    case OP_DIVI:
+      return "divi";
+    case OP_ADDD:
+      return "addd";
+    case OP_SUBD:
+      return "subd";
+    case OP_MULD:
+      return "muld";
+    case OP_DIVD:
+      return "divd";
+    case OP_CONCAT:
+      return "concat";
+    case OP_APPEND:
+      return "append";
+    case OP_CAST:
+      return "cast";
+    case OP_NEG:
+      return "neg";
+    case OP_INC:
+      return "inc";
+    case OP_DEC:
+      return "dec";
+    case OP_ARIEQ:
+      return "eq";
+    case OP_ARINE:
+      return "ne";
+    case OP_ARIGE:
+      return "ge";
+    case OP_ARILE:
+      return "le";
+    case OP_ARIGT:
+      return "gt";
+    case OP_ARILT:
+      return "lt";
+    case OP_EQN:
+      return "numeq";
+    case OP_NEN:
+      return "numne";
+    case OP_GEN:
+      return "numge";
+    case OP_LEN:
+      return "numle";
+    case OP_GTN:
+      return "numgt";
+    case OP_LTN:
+      return "numlt";
+    case OP_ARIAND:
+      return "bitand";
+    case OP_ARIOR:
+      return "bitor";
+    case OP_ARINOT:
+      return "not";
+    case OP_AND:
+      return "and";
+    case OP_OR:
+      return "or";
+    case OP_JSR:
+      return "jsr";
+    case OP_RET:
+      return "ret";
+    case OP_JZ:
+      return "jz";
+    case OP_JNZ:
+      return "jnz";
+    case OP_JUMP:
+      return "jump";
+    case OP_CALL:
+      return "call";
+    case OP_CLR:
+      return "clr";
+    case OP_RSZ:
+      return "rsz";
+    case OP_ERRHDL:
+      return "errhdl";
+    case OP_NEXT:
+      return "next";
+    case OP_ARISTO:
+      return "aristo";
+    case OP_CMPJZ:
+      return "cmpjz";
+    case OP_END:
+      return "end";
+    case ASM_LINE:
+      return ".LINE";
+  }
+  return "??? " + std::to_string(mnemonic);
+}
+
+
+
 void Disassembler::printType(uint32_t op)
 {
   printType(COp::getType(op));
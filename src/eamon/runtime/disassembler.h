@@ -42,6 +42,13 @@ public:
 
   void disassemble(Executable* x);
 
+  /**
+   * @brief Gets the name of an op code as printed by the disassembler.
+   * @param mnemonic the mnemonic of the op code
+   * @return the name of the op code
+   */
+  static std::string getMnemonicName(uint32_t mnemonic);
+
 private:
   void printType(uint32_t op);
   const uint32_t* printPar(Executable* executable, uint32_t op, const uint32_t* cptr);
@@ -110,6 +110,7 @@ Executable::Executable(uint32_t codelength, uint32_t textlength, uint32_t vtable
 
 Executable::~Executable()
 {
+  releaseConstantValues();
   if (buffer != nullptr) free(buffer);
 }
 
@@ -144,6 +145,13 @@ std::vector<Value> Executable::getConstantArray(uint32_t addr) const
   return constantValues[addr];
 }
 
+const std::vector<Value>& Executable::getConstantValues(uint32_t addr) const
+{
+  addr = Address::getAddress(addr);
+  if (addr >= constantValues.size()) throw std::runtime_error("Illegal getConstantValues access");
+  return constantValues[addr];
+}
+
 const Symbol* Executable::findConstant(const std::string& name) const
 {
   return findSymbol(name,Symbol::CONSTANT);
@@ -182,6 +190,29 @@ const Symbol* Executable::findSymbol(const std::string& name, Symbol::SymbolType
   return nullptr;
 }
 
+std::shared_ptr<const DecodedCode> Executable::getDecodedCode()
+{
+  std::lock_guard<std::mutex> lock(decodedCodeMutex);
+  if (!decodedCode) decodedCode = DecodedCode::translate(this);
+  return decodedCode;
+}
+
+std::shared_ptr<const RegisterCode> Executable::getRegisterCode()
+{
+  std::lock_guard<std::mutex> lock(decodedCodeMutex);
+  if (!decodedCode) decodedCode = DecodedCode::translate(this);
+  if (!registerCode) registerCode = RegisterCode::translate(decodedCode);
+  return registerCode;
+}
+
+std::shared_ptr<const Verifier::Verdict> Executable::getStackVerdict()
+{
+  std::lock_guard<std::mutex> lock(decodedCodeMutex);
+  if (!decodedCode) decodedCode = DecodedCode::translate(this);
+  if (!stackVerdict) stackVerdict = Verifier::verify(*decodedCode);
+  return stackVerdict;
+}
+
 std::vector<Symbol> Executable::getSymbolTable(Symbol::SymbolType type) const
 {
   const Symbol* s;
@@ -280,6 +311,9 @@ bool Executable::load(char *buf, uint32_t size)
 void Executable::setCodeSegment(const uint32_t* c)
 {
   memcpy(code,c,codelength);
+  decodedCode.reset();
+  registerCode.reset();
+  stackVerdict.reset();
 }
 
 void Executable::setTextSegment(const char* t)
@@ -359,7 +393,11 @@ void Executable::setupTables()
 
 void Executable::buildConstantValueTable()
 {
-  constantValues.clear();
+  decodedCode.reset(); /* refers to the constant values */
+  registerCode.reset();
+  stackVerdict.reset();
+  releaseConstantValues();
+  StringHeap::Scope scope(nullptr); /* the constants outlive the string space of a virtual machine */
   const char* p = text;
   while (p-text < textlength)
   {
@@ -391,8 +429,18 @@ void Executable::buildConstantValueTable()
         constant.push_back(Value(v));
       }
     }
-    constantValues.push_back(constant);
+    for (Value& v : constant) v.pin();
+    constantValues.push_back(std::move(constant));
+  }
+}
+
+void Executable::releaseConstantValues()
+{
+  for (auto& constant : constantValues)
+  {
+    for (Value& v : constant) v.unpin();
   }
+  constantValues.clear();
 }
 
 
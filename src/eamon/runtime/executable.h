@@ -24,10 +24,15 @@
 #define EXECUTABLE_H
 
 #include "constant.h"
+#include "decodedcode.h"
+#include "registercode.h"
 #include "memory.h"
 #include "symbol.h"
+#include "verifier.h"
 #include "value.h"
 #include <stdint.h>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -69,6 +74,14 @@ public:
    */
   virtual std::vector<Value> getConstantArray(uint32_t addr) const override;
 
+  /**
+   * @brief Returns a reference to all values belonging to the constant at the given address.
+   * @param addr the address of the constant
+   * @return list of values
+   * @throws runtime_error if there is no constant at the given address
+   */
+  const std::vector<Value>& getConstantValues(uint32_t addr) const;
+
   /**
    * @brief Return a pointer to the symbol structure for a constant of the given name.
    * If the constant is not found, a nullptr will be returned.
@@ -96,6 +109,29 @@ public:
 
   std::vector<Symbol> getSymbolTable(Symbol::SymbolType type) const;
 
+  /**
+   * @brief Returns the decoded code of this executable.
+   * The code segment is translated on the first call. All later calls return
+   * the same instance, so virtual machines running this executable share it.
+   * @return the decoded code
+   */
+  std::shared_ptr<const DecodedCode> getDecodedCode();
+
+  /**
+   * @brief Returns the code of this executable translated for the register
+   * machine. Like the decoded code it is created on the first call and shared.
+   * @return the register machine code
+   */
+  std::shared_ptr<const RegisterCode> getRegisterCode();
+
+  /**
+   * @brief Returns the verdict of the stack verifier on the decoded code.
+   * The code is verified on the first call and the verdict is kept with the
+   * executable.
+   * @return the verdict
+   */
+  std::shared_ptr<const Verifier::Verdict> getStackVerdict();
+
   /**
    * @brief Saves the executable data to file.
    * @param filename the filename
@@ -164,6 +200,7 @@ protected:
 private:
   void setupTables();
   void buildConstantValueTable();
+  void releaseConstantValues();
 
 
   char* buffer; /* buffer containing everything as one chunk */
@@ -180,7 +217,11 @@ private:
   uint32_t functionSymbolTableLength;
   Symbol* constantSymbolTable;
   uint32_t constantSymbolTableLength;
-  std::vector<std::vector<Value>> constantValues;
+  std::vector<std::vector<Value>> constantValues; /* the strings are pinned, so the virtual machines share them without counting */
+  std::shared_ptr<const DecodedCode> decodedCode;
+  std::shared_ptr<const RegisterCode> registerCode;
+  std::shared_ptr<const Verifier::Verdict> stackVerdict;
+  std::mutex decodedCodeMutex;
 };
 
 
@@ -0,0 +1,838 @@
+/********************************************************************************
+ *                                                                              *
+ * EamonInterpreter - x86-64 JIT compiler                                       *
+ *                                                                              *
+ * modified: 2026-10-16                                                         *
+ *                                                                              *
+ ********************************************************************************
+ * Copyright (C) Harald Braeuning                                               *
+ ********************************************************************************
+ * This file is part of EamonInterpreter.                                       *
+ * EamonInterpreter is free software: you can redistribute it and/or modify it  *
+ * under the terms of the GNU General Public License as published by the Free   *
+ * Software Foundation, either version 3 of the License, or (at your option)    *
+ * any later version.                                                           *
+ * EamonInterpreter is distributed in the hope that it will be useful, but      *
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY   *
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for  *
+ * more details.                                                                *
+ * You should have received a copy of the GNU General Public License along with *
+ * EamonInterpreter. If not, see <https://www.gnu.org/licenses/>.               *
+ ********************************************************************************/
+
+
+#include "jit.h"
+#include "op.h"
+#include <stdexcept>
+#include <cstring>
+#if defined(EAMON_JIT) && defined(__x86_64__) && !defined(_WIN32)
+#define JIT_NATIVE
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+
+
+namespace {
+
+/* x86-64 general purpose registers */
+const int RAX = 0;
+const int RCX = 1;
+const int RDX = 2;
+const int RSI = 6;
+const int RDI = 7;
+
+/* condition codes */
+const int CC_E = 0x4;
+const int CC_NE = 0x5;
+const int CC_AE = 0x3;
+const int CC_A = 0x7;
+const int CC_P = 0xA;
+const int CC_NP = 0xB;
+const int CC_ALWAYS = -1;
+
+/* scalar double instructions (prefix F2 0F) */
+const uint8_t SSE_ADD = 0x58;
+const uint8_t SSE_MUL = 0x59;
+const uint8_t SSE_SUB = 0x5C;
+const uint8_t SSE_DIV = 0x5E;
+
+const uint32_t FAILED = 0xFFFFFFFF;
+
+/*
+ * Maps the generic and the type specialized op codes to the generic one.
+ * Returns 0 for operations which are not compiled.
+ */
+uint32_t getArithmetic(uint32_t op)
+{
+  switch (op)
+  {
+    case OP_ARIADD:
+    case OP_ADDI:
+    case OP_ADDD:
+      return OP_ARIADD;
+    case OP_ARISUB:
+    case OP_SUBI:
+    case OP_SUBD:
+      return OP_ARISUB;
+    case OP_ARIMUL:
+    case OP_MULI:
+    case OP_MULD:
+      return OP_ARIMUL;
+    case OP_ARIDIV:
+    case OP_DIVI:
+    case OP_DIVD:
+      return OP_ARIDIV;
+  }
+  return 0;
+}
+
+uint32_t getComparison(uint32_t op)
+{
+  switch (op)
+  {
+    case OP_ARIEQ:
+    case OP_EQN:
+      return OP_ARIEQ;
+    case OP_ARINE:
+    case OP_NEN:
+      return OP_ARINE;
+    case OP_ARILE:
+    case OP_LEN:
+      return OP_ARILE;
+    case OP_ARIGE:
+    case OP_GEN:
+      return OP_ARIGE;
+    case OP_ARILT:
+    case OP_LTN:
+      return OP_ARILT;
+    case OP_ARIGT:
+    case OP_GTN:
+      return OP_ARIGT;
+  }
+  return 0;
+}
+
+}
+
+
+
+/**
+ * @brief The Emitter class assembles the native code of a block.
+ *
+ * Values are addressed by a general purpose register holding the address of
+ * the value plus the offset of the field. Type checks jump to the exit of the
+ * instruction being compiled, which returns this instruction to the
+ * interpreter.
+ */
+class Jit::Emitter
+{
+public:
+  Emitter(int32_t typeOffset, int32_t intOffset, int32_t doubleOffset):
+    typeOffset(static_cast<uint8_t>(typeOffset)),
+    intOffset(static_cast<uint8_t>(intOffset)),
+    doubleOffset(static_cast<uint8_t>(doubleOffset)),
+    current(nullptr)
+  {
+  }
+
+  void setInstruction(const RegisterInstruction* in)
+  {
+    current = in;
+  }
+
+  const std::vector<uint8_t>& getCode() const
+  {
+    return code;
+  }
+
+  /* mov reg,imm64 */
+  void loadAddress(int reg, const void* p)
+  {
+    byte(0x48);
+    byte(static_cast<uint8_t>(0xB8 + reg));
+    uint64_t v = reinterpret_cast<uintptr_t>(p);
+    for (int i=0;i<8;i++) byte(static_cast<uint8_t>(v >> (8 * i)));
+  }
+
+  /* cmp dword [base+type],imm8 */
+  void compareType(int base, int32_t type)
+  {
+    byte(0x83);
+    modrm(7,base,typeOffset);
+    byte(static_cast<uint8_t>(type));
+  }
+
+  /* mov dword [base+type],imm32 */
+  void storeType(int base, int32_t type)
+  {
+    storeImmediate(base,typeOffset,type);
+  }
+
+  /* mov dword [base+disp],imm32 */
+  void storeImmediate(int base, uint8_t disp, int32_t v)
+  {
+    byte(0xC7);
+    modrm(0,base,disp);
+    dword(static_cast<uint32_t>(v));
+  }
+
+  /* mov reg,dword [base+int] */
+  void loadInt(int reg, int base)
+  {
+    byte(0x8B);
+    modrm(reg,base,intOffset);
+  }
+
+  /* mov dword [base+int],reg */
+  void storeInt(int base, int reg)
+  {
+    byte(0x89);
+    modrm(reg,base,intOffset);
+  }
+
+  /* cmp dword [base+int],imm8 */
+  void compareInt(int base, int8_t v)
+  {
+    byte(0x83);
+    modrm(7,base,intOffset);
+    byte(static_cast<uint8_t>(v));
+  }
+
+  /* copies type and payload of a number: rax and ecx are clobbered */
+  void copyNumber(int dst, int src)
+  {
+    byte(0x48);
+    byte(0x8B);
+    modrm(RAX,src,doubleOffset);
+    byte(0x8B);
+    modrm(RCX,src,typeOffset);
+    byte(0x48);
+    byte(0x89);
+    modrm(RAX,dst,doubleOffset);
+    byte(0x89);
+    modrm(RCX,dst,typeOffset);
+  }
+
+  /* movsd xmm,[base+double] */
+  void loadDouble(int xmm, int base)
+  {
+    sse(0x10);
+    modrm(xmm,base,doubleOffset);
+  }
+
+  /* movsd [base+double],xmm */
+  void storeDouble(int base, int xmm)
+  {
+    sse(0x11);
+    modrm(xmm,base,doubleOffset);
+  }
+
+  /* cvtsi2sd xmm,dword [base+int] */
+  void convertInt(int xmm, int base)
+  {
+    sse(0x2A);
+    modrm(xmm,base,intOffset);
+  }
+
+  /* addsd, subsd, mulsd or divsd xmm,xmm */
+  void calculateDouble(uint8_t op, int dst, int src)
+  {
+    sse(op);
+    byte(static_cast<uint8_t>(0xC0 | (dst << 3) | src));
+  }
+
+  /* ucomisd xmm,xmm */
+  void compareDouble(int x1, int x2)
+  {
+    byte(0x66);
+    byte(0x0F);
+    byte(0x2E);
+    byte(static_cast<uint8_t>(0xC0 | (x1 << 3) | x2));
+  }
+
+  /* eax = eax op ecx */
+  void calculateInt(uint32_t op)
+  {
+    switch (op)
+    {
+      case OP_ARIADD:
+        byte(0x01); /* add eax,ecx */
+        byte(0xC8);
+        break;
+      case OP_ARISUB:
+        byte(0x29); /* sub eax,ecx */
+        byte(0xC8);
+        break;
+      case OP_ARIMUL:
+        byte(0x0F); /* imul eax,ecx */
+        byte(0xAF);
+        byte(0xC1);
+        break;
+      case OP_ARIDIV:
+        /* a division by zero and the overflow of INT_MIN / -1 are left to the interpreter */
+        byte(0x85); /* test ecx,ecx */
+        byte(0xC9);
+        bail(CC_E);
+        byte(0x83); /* cmp ecx,-1 */
+        byte(0xF9);
+        byte(0xFF);
+        bail(CC_E);
+        byte(0x99); /* cdq */
+        byte(0xF7); /* idiv ecx */
+        byte(0xF9);
+        break;
+    }
+  }
+
+  /* setcc al or cl */
+  void set(int cc, int reg)
+  {
+    byte(0x0F);
+    byte(static_cast<uint8_t>(0x90 + cc));
+    byte(static_cast<uint8_t>(0xC0 + reg));
+  }
+
+  /* and al,cl */
+  void andFlags()
+  {
+    byte(0x20);
+    byte(0xC8);
+  }
+
+  /* or al,cl */
+  void orFlags()
+  {
+    byte(0x08);
+    byte(0xC8);
+  }
+
+  /* movzx eax,al */
+  void extend()
+  {
+    byte(0x0F);
+    byte(0xB6);
+    byte(0xC0);
+  }
+
+  /* test eax,eax */
+  void testResult()
+  {
+    byte(0x85);
+    byte(0xC0);
+  }
+
+  /* jcc or jmp rel32 to a position bound later */
+  size_t jump(int cc)
+  {
+    if (cc == CC_ALWAYS)
+      byte(0xE9);
+    else
+    {
+      byte(0x0F);
+      byte(static_cast<uint8_t>(0x80 + cc));
+    }
+    dword(0);
+    return code.size();
+  }
+
+  void bind(size_t patch)
+  {
+    uint32_t rel = static_cast<uint32_t>(code.size() - patch);
+    std::memcpy(&code[patch-4],&rel,sizeof(rel));
+  }
+
+  /* returns the current instruction to the interpreter if the condition holds */
+  void bail(int cc)
+  {
+    bails.push_back(std::make_pair(jump(cc),current));
+  }
+
+  /* returns the instruction to continue with */
+  void exit(const RegisterInstruction* next)
+  {
+    loadAddress(RAX,next);
+    byte(0xC3);
+  }
+
+  /* emits the exits of the type checks */
+  void finish()
+  {
+    const RegisterInstruction* in = nullptr;
+    size_t pos = 0;
+    for (const auto& b : bails)
+    {
+      if (b.second != in)
+      {
+        in = b.second;
+        pos = code.size();
+        exit(in);
+      }
+      uint32_t rel = static_cast<uint32_t>(pos - b.first);
+      std::memcpy(&code[b.first-4],&rel,sizeof(rel));
+    }
+  }
+
+private:
+  void byte(uint8_t b)
+  {
+    code.push_back(b);
+  }
+
+  void dword(uint32_t v)
+  {
+    for (int i=0;i<4;i++) byte(static_cast<uint8_t>(v >> (8 * i)));
+  }
+
+  /* [base+disp8] */
+  void modrm(int reg, int base, uint8_t disp)
+  {
+    byte(static_cast<uint8_t>(0x40 | (reg << 3) | base));
+    byte(disp);
+  }
+
+  void sse(uint8_t op)
+  {
+    byte(0xF2);
+    byte(0x0F);
+    byte(op);
+  }
+
+  uint8_t typeOffset;
+  uint8_t intOffset;
+  uint8_t doubleOffset;
+  const RegisterInstruction* current;
+  std::vector<uint8_t> code;
+  std::vector<std::pair<size_t,const RegisterInstruction*>> bails;
+};
+
+
+
+Jit::Jit():
+  mem(nullptr),
+  registers(nullptr),
+  line(nullptr),
+  generation(0),
+  zero(0.0)
+{
+  Value v;
+  typeOffset = static_cast<int32_t>(reinterpret_cast<char*>(&v.type) - reinterpret_cast<char*>(&v));
+  intOffset = static_cast<int32_t>(reinterpret_cast<char*>(&v.i) - reinterpret_cast<char*>(&v));
+  doubleOffset = static_cast<int32_t>(reinterpret_cast<char*>(&v.d) - reinterpret_cast<char*>(&v));
+}
+
+Jit::~Jit()
+{
+  clear();
+}
+
+bool Jit::isAvailable()
+{
+#ifdef JIT_NATIVE
+  /* the emitter uses 8 bit displacements and 32 bit type fields */
+  Jit jit;
+  return sizeof(Value::ValueType) == 4 && jit.typeOffset < 128 && jit.intOffset < 128 && jit.doubleOffset < 128;
+#else
+  return false;
+#endif
+}
+
+void Jit::reset(std::shared_ptr<const RegisterCode> c, Memory* m, std::vector<Value>* r, uint32_t* l)
+{
+  clear();
+  code = c;
+  mem = m;
+  registers = r;
+  line = l;
+  generation = mem->getGeneration();
+  counters.assign(static_cast<size_t>(code->getSize()),0);
+  blocks.assign(static_cast<size_t>(code->getSize()),nullptr);
+}
+
+Jit::Block Jit::getBlock(const RegisterInstruction* i)
+{
+  if (mem->getGeneration() != generation)
+  {
+    /* the compiled blocks refer to values which no longer exist */
+    clear();
+    generation = mem->getGeneration();
+    counters.assign(counters.size(),0);
+    blocks.assign(blocks.size(),nullptr);
+  }
+  size_t index = static_cast<size_t>(i - code->getStart());
+  if (blocks[index] != nullptr) return blocks[index];
+  if (counters[index] == FAILED) return nullptr;
+  if (++counters[index] < JIT_THRESHOLD) return nullptr;
+  blocks[index] = compile(static_cast<int32_t>(index));
+  if (mem->getGeneration() != generation)
+  {
+    /* taking a target copied a shared page, which a source may point into;
+     * the next call drops the block and starts over */
+    return nullptr;
+  }
+  if (blocks[index] == nullptr) counters[index] = FAILED;
+  return blocks[index];
+}
+
+void Jit::clear()
+{
+#ifdef JIT_NATIVE
+  for (const auto& p : pages) munmap(p.first,p.second);
+#endif
+  pages.clear();
+}
+
+/*
+ * A block follows the instructions from its start up to the first
+ * instruction which cannot be compiled and returns it to the interpreter.
+ * Taken jumps leave the block as well, the interpreter then looks up the
+ * block starting at the target.
+ */
+Jit::Block Jit::compile(int32_t index)
+{
+#ifdef JIT_NATIVE
+  if (pages.size() >= JIT_MAX_BLOCKS) return nullptr;
+  Emitter e(typeOffset,intOffset,doubleOffset);
+  const RegisterInstruction* in = code->getStart() + index;
+  const RegisterInstruction* last = code->getStart() + code->getSize();
+  int32_t n = 0;
+  bool end = false;
+  try
+  {
+    while (!end && n < JIT_MAX_BLOCK_LENGTH && in < last)
+    {
+      e.setInstruction(in);
+      if (!compileInstruction(e,*in,end)) break;
+      in++;
+      n++;
+    }
+  }
+  catch (std::exception&)
+  {
+    return nullptr;
+  }
+  if (n == 0) return nullptr;
+  if (!end) e.exit(in);
+  e.finish();
+  const std::vector<uint8_t>& bytes = e.getCode();
+  size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  size_t size = (bytes.size() + pageSize - 1) / pageSize * pageSize;
+  void* p = mmap(nullptr,size,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS,-1,0);
+  if (p == MAP_FAILED) return nullptr;
+  std::memcpy(p,bytes.data(),bytes.size());
+  if (mprotect(p,size,PROT_READ|PROT_EXEC) != 0)
+  {
+    munmap(p,size);
+    return nullptr;
+  }
+  pages.push_back(std::make_pair(p,size));
+  return reinterpret_cast<Block>(p);
+#else
+  (void)index;
+  return nullptr;
+#endif
+}
+
+/*
+ * Nothing may be emitted for an instruction which cannot be compiled, hence
+ * all checks are done before the code is emitted.
+ */
+bool Jit::compileInstruction(Emitter& e, const RegisterInstruction& in, bool& end)
+{
+  if (in.op == ROP_STACK) return compileStackInstruction(e,*in.source,end);
+  if (in.a.kind == Operand::Stack) return false;
+  switch (in.op)
+  {
+    case ROP_MOVE:
+      emitWritable(e,&(*registers)[in.dst]);
+      emitMove(e,getOperand(in.a),&(*registers)[in.dst]);
+      return true;
+    case ROP_ARI:
+      if (getArithmetic(in.subop) == 0 || in.b.kind == Operand::Stack) return false;
+      emitWritable(e,&(*registers)[in.dst]);
+      emitArithmetic(e,in.subop,getOperand(in.a),getOperand(in.b),&(*registers)[in.dst]);
+      return true;
+    case ROP_CMP:
+      if (getComparison(in.subop) == 0 || in.b.kind == Operand::Stack) return false;
+      emitWritable(e,&(*registers)[in.dst]);
+      emitCompare(e,in.subop,getOperand(in.a),getOperand(in.b));
+      e.loadAddress(RDI,&(*registers)[in.dst]);
+      e.storeInt(RDI,RAX);
+      e.storeType(RDI,Value::INT32);
+      return true;
+    case ROP_STO:
+      if (in.type != Type::int32Type && in.type != Type::doubleType) return false;
+      emitStore(e,in.type,getOperand(in.a),mem->getScalar(in.dst));
+      return true;
+    case ROP_JZ:
+    case ROP_JNZ:
+      if (in.target == nullptr) return false;
+      e.loadAddress(RSI,getOperand(in.a));
+      e.compareType(RSI,Value::INT32);
+      e.bail(CC_NE);
+      e.compareInt(RSI,0);
+      {
+        size_t skip = e.jump(in.op == ROP_JZ ? CC_NE : CC_E);
+        e.exit(in.target);
+        e.bind(skip);
+      }
+      return true;
+  }
+  return false;
+}
+
+bool Jit::compileStackInstruction(Emitter& e, const Instruction& in, bool& end)
+{
+  switch (in.op)
+  {
+    case ASM_LINE:
+      e.loadAddress(RDI,line);
+      e.storeImmediate(RDI,0,static_cast<int32_t>(in.arg));
+      return true;
+    case OP_JUMP:
+      if (in.target == nullptr) return false;
+      e.exit(code->getInstruction(in.target));
+      end = true;
+      return true;
+    case OP_ARISTO:
+      if (getArithmetic(in.subop) == 0) return false;
+      if (in.type != Type::int32Type && in.type != Type::doubleType) return false;
+      emitArithmetic(e,in.subop,&mem->getScalarValue(in.src1),&mem->getScalarValue(in.src2),&scratch[0]);
+      emitStore(e,in.type,&scratch[0],mem->getScalar(in.arg));
+      return true;
+    case OP_CMPJZ:
+      if (getComparison(in.subop) == 0 || in.target == nullptr) return false;
+      emitCompare(e,in.subop,&mem->getScalarValue(in.src1),in.value);
+      emitBranch(e,true,code->getInstruction(in.target));
+      return true;
+    case OP_NEXT:
+    {
+      uint32_t add = in.subop & 0xFF;
+      uint32_t sub = (in.subop >> 8) & 0xFF;
+      uint32_t mul = (in.subop >> 16) & 0xFF;
+      uint32_t cmp = (in.subop >> 24) & 0xFF;
+      if (getArithmetic(add) != OP_ARIADD || getArithmetic(sub) != OP_ARISUB || getArithmetic(mul) != OP_ARIMUL) return false;
+      if (getComparison(cmp) == 0 || in.target == nullptr) return false;
+      if (in.type != Type::int32Type && in.type != Type::doubleType) return false;
+      const RegisterInstruction* target = code->getInstruction(in.target);
+      Value* var = mem->getScalar(in.arg);
+      const Value* step = &mem->getScalarValue(in.src1);
+      const Value* limit = &mem->getScalarValue(in.src2);
+      /* The variable is stored in the middle of the instruction, hence all
+       * checks are done in front: the sum must not need rounding and all
+       * other operations work on numbers. */
+      e.loadAddress(RSI,var);
+      e.loadAddress(RDX,step);
+      if (in.type == Type::int32Type)
+      {
+        e.compareType(RSI,Value::INT32);
+        e.bail(CC_NE);
+        e.compareType(RDX,Value::INT32);
+        e.bail(CC_NE);
+      }
+      else
+      {
+        emitNumeric(e,RSI);
+        emitNumeric(e,RDX);
+      }
+      e.loadAddress(RSI,limit);
+      emitNumeric(e,RSI);
+      emitArithmetic(e,add,var,step,&scratch[0]);
+      emitStore(e,in.type,&scratch[0],var);
+      emitArithmetic(e,sub,&scratch[0],limit,&scratch[1]);
+      emitArithmetic(e,mul,&scratch[1],step,&scratch[2]);
+      emitCompare(e,cmp,&scratch[2],&zero);
+      emitBranch(e,true,target);
+      return true;
+    }
+  }
+  return false;
+}
+
+/*
+ * Operands are only read, so a variable is taken without marking its page
+ * as changed.
+ */
+const Value* Jit::getOperand(const Operand& o)
+{
+  switch (o.kind)
+  {
+    case Operand::Global:
+      return &mem->getScalarValue(o.index);
+    case Operand::Immediate:
+      return o.value;
+    case Operand::Register:
+      return &(*registers)[o.index];
+    case Operand::Stack:
+      break;
+  }
+  throw std::runtime_error("Illegal operand");
+}
+
+/* leaves the block unless the value addressed by reg is a number */
+void Jit::emitNumeric(Emitter& e, int reg)
+{
+  e.compareType(reg,Value::INT32);
+  size_t ok = e.jump(CC_E);
+  e.compareType(reg,Value::DOUBLE);
+  e.bail(CC_NE);
+  e.bind(ok);
+}
+
+/*
+ * Leaves the block if a register still holds a string: overwriting it would
+ * lose the reference, so the interpreter has to release it.
+ */
+void Jit::emitWritable(Emitter& e, const Value* dst)
+{
+  e.loadAddress(RDI,dst);
+  e.compareType(RDI,Value::STRING);
+  e.bail(CC_E);
+}
+
+void Jit::emitToDouble(Emitter& e, int xmm, int reg)
+{
+  e.compareType(reg,Value::INT32);
+  size_t notInt = e.jump(CC_NE);
+  e.convertInt(xmm,reg);
+  size_t done = e.jump(CC_ALWAYS);
+  e.bind(notInt);
+  e.compareType(reg,Value::DOUBLE);
+  e.bail(CC_NE);
+  e.loadDouble(xmm,reg);
+  e.bind(done);
+}
+
+/*
+ * Same result as VM::calculate: two integers give an integer, two numbers
+ * with at least one double give a double. Everything else is left to the
+ * interpreter.
+ */
+void Jit::emitArithmetic(Emitter& e, uint32_t op, const Value* a, const Value* b, Value* dst)
+{
+  op = getArithmetic(op);
+  e.loadAddress(RSI,a);
+  e.loadAddress(RDX,b);
+  e.compareType(RSI,Value::INT32);
+  size_t double1 = e.jump(CC_NE);
+  e.compareType(RDX,Value::INT32);
+  size_t double2 = e.jump(CC_NE);
+  e.loadInt(RAX,RSI);
+  e.loadInt(RCX,RDX);
+  e.calculateInt(op);
+  e.loadAddress(RDI,dst);
+  e.storeInt(RDI,RAX);
+  e.storeType(RDI,Value::INT32);
+  size_t done = e.jump(CC_ALWAYS);
+  e.bind(double1);
+  e.bind(double2);
+  emitToDouble(e,0,RSI);
+  emitToDouble(e,1,RDX);
+  switch (op)
+  {
+    case OP_ARIADD:
+      e.calculateDouble(SSE_ADD,0,1);
+      break;
+    case OP_ARISUB:
+      e.calculateDouble(SSE_SUB,0,1);
+      break;
+    case OP_ARIMUL:
+      e.calculateDouble(SSE_MUL,0,1);
+      break;
+    case OP_ARIDIV:
+      e.calculateDouble(SSE_DIV,0,1);
+      break;
+  }
+  e.loadAddress(RDI,dst);
+  e.storeDouble(RDI,0);
+  e.storeType(RDI,Value::DOUBLE);
+  e.bind(done);
+}
+
+/*
+ * Numbers are compared as doubles, which is exact for all int32 values.
+ * The result (1 or 0) is left in eax.
+ */
+void Jit::emitCompare(Emitter& e, uint32_t op, const Value* a, const Value* b)
+{
+  op = getComparison(op);
+  e.loadAddress(RSI,a);
+  e.loadAddress(RDX,b);
+  emitToDouble(e,0,RSI);
+  emitToDouble(e,1,RDX);
+  /* unordered operands (NaN) set ZF, PF and CF */
+  switch (op)
+  {
+    case OP_ARIEQ:
+      e.compareDouble(0,1);
+      e.set(CC_E,RAX);
+      e.set(CC_NP,RCX);
+      e.andFlags();
+      break;
+    case OP_ARINE:
+      e.compareDouble(0,1);
+      e.set(CC_NE,RAX);
+      e.set(CC_P,RCX);
+      e.orFlags();
+      break;
+    case OP_ARIGT:
+      e.compareDouble(0,1);
+      e.set(CC_A,RAX);
+      break;
+    case OP_ARIGE:
+      e.compareDouble(0,1);
+      e.set(CC_AE,RAX);
+      break;
+    case OP_ARILT:
+      e.compareDouble(1,0);
+      e.set(CC_A,RAX);
+      break;
+    case OP_ARILE:
+      e.compareDouble(1,0);
+      e.set(CC_AE,RAX);
+      break;
+  }
+  e.extend();
+}
+
+/*
+ * Same conversion as VM::storeScalar, except that storing a double in an
+ * integer variable, which needs rounding, is left to the interpreter.
+ */
+void Jit::emitStore(Emitter& e, Type type, const Value* src, Value* dst)
+{
+  e.loadAddress(RSI,src);
+  if (type == Type::int32Type)
+  {
+    e.compareType(RSI,Value::INT32);
+    e.bail(CC_NE);
+    e.loadInt(RAX,RSI);
+    e.loadAddress(RDI,dst);
+    e.storeInt(RDI,RAX);
+    e.storeType(RDI,Value::INT32);
+  }
+  else
+  {
+    emitToDouble(e,0,RSI);
+    e.loadAddress(RDI,dst);
+    e.storeDouble(RDI,0);
+    e.storeType(RDI,Value::DOUBLE);
+  }
+}
+
+void Jit::emitMove(Emitter& e, const Value* src, Value* dst)
+{
+  e.loadAddress(RSI,src);
+  emitNumeric(e,RSI);
+  e.loadAddress(RDI,dst);
+  e.copyNumber(RDI,RSI);
+}
+
+/* jumps to target if eax is zero (or not zero) */
+void Jit::emitBranch(Emitter& e, bool ifZero, const RegisterInstruction* target)
+{
+  e.testResult();
+  size_t skip = e.jump(ifZero ? CC_NE : CC_E);
+  e.exit(target);
+  e.bind(skip);
+}
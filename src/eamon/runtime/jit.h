@@ -0,0 +1,144 @@
+/********************************************************************************
+ *                                                                              *
+ * EamonInterpreter - x86-64 JIT compiler                                       *
+ *                                                                              *
+ * modified: 2026-10-16                                                         *
+ *                                                                              *
+ ********************************************************************************
+ * Copyright (C) Harald Braeuning                                               *
+ ********************************************************************************
+ * This file is part of EamonInterpreter.                                       *
+ * EamonInterpreter is free software: you can redistribute it and/or modify it  *
+ * under the terms of the GNU General Public License as published by the Free   *
+ * Software Foundation, either version 3 of the License, or (at your option)    *
+ * any later version.                                                           *
+ * EamonInterpreter is distributed in the hope that it will be useful, but      *
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY   *
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for  *
+ * more details.                                                                *
+ * You should have received a copy of the GNU General Public License along with *
+ * EamonInterpreter. If not, see <https://www.gnu.org/licenses/>.               *
+ ********************************************************************************/
+
+
+#ifndef JIT_H
+#define JIT_H
+
+#include "registercode.h"
+#include "memory.h"
+#include <stdint.h>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+/* number of executions before a block is compiled */
+#define JIT_THRESHOLD 100
+/* maximum number of register machine instructions in a block */
+#define JIT_MAX_BLOCK_LENGTH 256
+/* maximum number of compiled blocks */
+#define JIT_MAX_BLOCKS 4096
+
+
+
+/**
+ * @brief Thrown if a compiled block and the interpreter disagree while the
+ * JIT compiler is verified.
+ */
+class JitMismatch : public std::runtime_error
+{
+public:
+  using std::runtime_error::runtime_error;
+};
+
+/**
+ * @brief The Jit class is a template JIT compiler for the register machine.
+ *
+ * A block of register machine instructions is compiled into native x86-64 code
+ * once it was entered JIT_THRESHOLD times. A block ends at the first
+ * instruction which cannot be compiled, e.g. a library call. Compiled are
+ * integer and double arithmetic, numeric comparisons and conditional jumps,
+ * loads and stores of global variables and the superinstructions working on
+ * them. Every instruction checks the types of its operands; if a check fails,
+ * the native code returns to the interpreter before the instruction has any
+ * effect.
+ *
+ * The native code refers to the values by address, hence the compiled
+ * blocks are discarded whenever the memory layout changes.
+ */
+class Jit
+{
+public:
+  /**
+   * @brief A compiled block.
+   * @return the register machine instruction to continue with
+   */
+  typedef const RegisterInstruction* (*Block)();
+
+  Jit();
+  ~Jit();
+
+  /**
+   * @brief Get whether the JIT compiler is available on this platform and
+   * in this build.
+   * @return true if native code can be generated
+   */
+  static bool isAvailable();
+
+  /**
+   * @brief Discards all compiled blocks and prepares the compilation of
+   * another program.
+   * @param code the register machine code
+   * @param mem the memory of the virtual machine
+   * @param registers the registers of the virtual machine
+   * @param line the current line number of the virtual machine
+   */
+  void reset(std::shared_ptr<const RegisterCode> code, Memory* mem, std::vector<Value>* registers, uint32_t* line);
+
+  /**
+   * @brief Returns the compiled block starting at an instruction.
+   *
+   * Counts the executions of the instruction and compiles the block once it
+   * gets hot.
+   * @param i the first instruction of the block
+   * @return the compiled block or nullptr
+   */
+  Block getBlock(const RegisterInstruction* i);
+
+private:
+  class Emitter;
+
+  Jit(const Jit&) = delete;
+  Jit& operator=(const Jit&) = delete;
+
+  void clear();
+  Block compile(int32_t index);
+  bool compileInstruction(Emitter& e, const RegisterInstruction& in, bool& end);
+  bool compileStackInstruction(Emitter& e, const Instruction& in, bool& end);
+  const Value* getOperand(const Operand& o);
+  void emitNumeric(Emitter& e, int reg);
+  void emitWritable(Emitter& e, const Value* dst);
+  void emitToDouble(Emitter& e, int xmm, int reg);
+  void emitArithmetic(Emitter& e, uint32_t op, const Value* a, const Value* b, Value* dst);
+  void emitCompare(Emitter& e, uint32_t op, const Value* a, const Value* b);
+  void emitStore(Emitter& e, Type type, const Value* src, Value* dst);
+  void emitMove(Emitter& e, const Value* src, Value* dst);
+  void emitBranch(Emitter& e, bool ifZero, const RegisterInstruction* target);
+
+  std::shared_ptr<const RegisterCode> code;
+  Memory* mem;
+  std::vector<Value>* registers;
+  uint32_t* line;
+  uint32_t generation;
+  int32_t typeOffset;   /* offsets of the fields of a Value */
+  int32_t intOffset;
+  int32_t doubleOffset;
+  std::vector<uint32_t> counters;
+  std::vector<Block> blocks;
+  std::vector<std::pair<void*,size_t>> pages;
+  Value scratch[3];
+  Value zero;
+};
+
+
+
+#endif // JIT_H
@@ -22,6 +22,7 @@
 
 #include "library.h"
 #include "memory.h"
+#include "numberformat.h"
 #include "stack.h"
 #include "symbol.h"
 #include "outputstream.h"
@@ -34,6 +35,9 @@
 #include <algorithm>
 #include <filesystem>
 
+/* snapshots of the changes appended to a memory log before it is compacted */
+#define MEMORY_LOG_DELTAS 32
+
 #define F_PRINT 0
 #define F_INPUT 1
 #define F_READ  2
@@ -141,7 +145,10 @@ Library::Library(std::shared_ptr<InputStream>& sin, std::shared_ptr<OutputStream
   chain(""),
   currentHiresPage(0),
   os(sout),
-  is(sin)
+  is(sin),
+  logDeltas(0),
+  logBaseSize(0),
+  logDeltaSize(0)
 {
   init();
 }
@@ -180,6 +187,98 @@ const std::vector<LibraryFunction>& Library::getFunctions()
   return definitions;
 }
 
+int32_t Library::getArgumentCountPosition(uint16_t id)
+{
+  switch (id)
+  {
+    case F_PRINT:
+    case F_PRINTF:
+      return 1;
+    case F_INPUT:
+      return 2; /* below the prompt flag */
+  }
+  return 0;
+}
+
+bool Library::getStackEffect(uint16_t id, int32_t narg, int32_t& pop, int32_t& push)
+{
+  switch (id)
+  {
+    case F_PRINT:
+    case F_PRINTF:
+      /* type and value of each argument plus the argument count */
+      if (narg < 0) return false;
+      pop = 1 + 2 * narg;
+      push = narg == 0 ? 1 : 0;
+      return true;
+    case F_INPUT:
+      /* the values read plus the argument count */
+      if (narg < 0) return false;
+      pop = 2 + narg;
+      push = narg + 1;
+      return true;
+    case F_READ:
+    case F_ATAN2:
+    case F_LEFT:
+    case F_MID1:
+    case F_RIGHT:
+    case F_POW:
+      pop = 2;
+      push = 1;
+      return true;
+    case F_MID:
+      pop = 3;
+      push = 1;
+      return true;
+    case F_SIN:
+    case F_COS:
+    case F_TAN:
+    case F_ASIN:
+    case F_ACOS:
+    case F_ATAN:
+    case F_SQRT:
+    case F_EXP:
+    case F_LOG:
+    case F_LOG10:
+    case F_LOG2:
+    case F_ABS:
+    case F_SIGN:
+    case F_RND:
+    case F_INT:
+    case F_LEN:
+    case F_ASC:
+    case F_CHR:
+    case F_VAL:
+    case F_STR:
+    case F_PEEK:
+    case F_GET:
+    case F_SPC:
+    case F_FRE:
+      pop = 1;
+      push = 1;
+      return true;
+    case F_TAB:
+    case F_VTAB:
+    case F_HTAB:
+      pop = 1;
+      push = 0;
+      return true;
+    case F_POKE:
+      pop = 2;
+      push = 0;
+      return true;
+    case F_INVERSE:
+    case F_NORMAL:
+    case F_HOME:
+    case F_FLASH:
+    case F_TEXT:
+      pop = 0;
+      push = 0;
+      return true;
+  }
+  return false;
+}
+
 void Library::execute(uint16_t id, Memory& mem, Stack& stack, const ConstantData* data)
 {
   switch (id)
@@ -237,7 +336,10 @@ void Library::execute(uint16_t id, Memory& mem, Stack& stack, const ConstantData
       stack.push(fabs(stack.pop().getDouble()));
       break;
     case F_TAB:
-      if (os) os->gotoColumn(round(stack.pop().getDouble()));
+      {
+        double c = stack.pop().getDouble();
+        if (os) os->gotoColumn(round(c));
+      }
       break;
     case F_SIGN:
       {
@@ -278,16 +380,19 @@ void Library::execute(uint16_t id, Memory& mem, Stack& stack, const ConstantData
       right(stack);
       break;
     case F_LEN:
-      stack.push(static_cast<int32_t>(stack.pop().getString().length()));
+      len(stack);
       break;
     case F_ASC:
-      stack.push(static_cast<double>(stack.pop().getString()[0]));
+      asc(stack);
       break;
     case F_CHR:
       chr(stack);
       break;
     case F_VAL:
-      stack.push(atof(stack.pop().getString().c_str()));
+      {
+        Value v = stack.pop();
+        stack.push(NumberFormat::scan(v.getChars(),v.getLength()));
+      }
       break;
     case F_STR:
       str(stack);
@@ -335,7 +440,7 @@ void Library::execute(uint16_t id, Memory& mem, Stack& stack, const ConstantData
       break;
     case F_FRE:
       stack.pop();
-      stack.push(0xFFFF);
+      fre(stack);
       break;
   }
 }
@@ -373,12 +478,15 @@ const std::vector<uint8_t>& Library::getHiresPage() const
 
 
 
+/*
+ * The substring functions replace the string on the stack by a part of it,
+ * which shares the characters of the string instead of copying them.
+ */
 void Library::left(Stack& stack) const
 {
   int32_t l = stack.pop().getInt();
   if (l <= 0 || l > 255) throw std::runtime_error("ILLEGAL QUANTITIY");
-  std::string s = stack.pop().getString();
-  stack.push(s.substr(0,l));
+  stack.top().substring(0,l);
 }
 
 void Library::mid(Stack& stack) const
@@ -388,11 +496,7 @@ void Library::mid(Stack& stack) const
   int32_t p = stack.pop().getInt();
   if (p <= 0 || p > 255) throw std::runtime_error("ILLEGAL QUANTITIY");
   p--;  /* counting starts with 1 in BASIC */
-  std::string s = stack.pop().getString();
-  if (p < s.length())
-    stack.push(s.substr(p,l));
-  else
-    stack.push(std::string(""));
+  stack.top().substring(p,l);
 }
 
 void Library::mid1(Stack& stack) const
@@ -400,24 +504,51 @@ void Library::mid1(Stack& stack) const
   int32_t p = stack.pop().getInt();
   if (p <= 0 || p > 255) throw std::runtime_error("ILLEGAL QUANTITIY");
   p--;  /* counting starts with 1 in BASIC */
-  std::string s = stack.pop().getString();
-  if (p < s.length())
-    stack.push(s.substr(p));
-  else
-    stack.push(std::string(""));
+  stack.top().substring(p,UINT32_MAX);
 }
 
 void Library::right(Stack& stack) const
 {
   int32_t l = stack.pop().getInt();
   if (l <= 0 || l > 255) throw std::runtime_error("ILLEGAL QUANTITIY");
-  std::string s = stack.pop().getString();
-  if (l == 0)
-    stack.push(std::string(""));
-  else if (l > s.length())
-    stack.push(s);
+  Value& s = stack.top();
+  s.stringify();
+  if (static_cast<uint32_t>(l) < s.getLength()) s.substring(s.getLength()-l,l);
+}
+
+/*
+ * LEN() and ASC() look at the string on the stack without copying it.
+ */
+void Library::len(Stack& stack) const
+{
+  Value& v = stack.top();
+  v.stringify();
+  v = Value(static_cast<int32_t>(v.getLength()));
+}
+
+void Library::asc(Stack& stack) const
+{
+  Value& v = stack.top();
+  v.stringify();
+  v = Value(static_cast<double>(v.getLength() > 0 ? v.getChars()[0] : 0));
+}
+
+/*
+ * Like Applesoft, FRE() collects the garbage of the string space and then
+ * reports the free space.
+ */
+void Library::fre(Stack& stack) const
+{
+  StringHeap* heap = StringHeap::getCurrent();
+  if (heap != nullptr)
+  {
+    heap->collect();
+    stack.push(static_cast<int32_t>(std::min(heap->getFree(),static_cast<uint32_t>(INT32_MAX))));
+  }
   else
-    stack.push(s.substr(s.length()-l));
+  {
+    stack.push(0xFFFF);
+  }
 }
 
 void Library::chr(Stack &stack) const
@@ -429,30 +560,30 @@ void Library::chr(Stack &stack) const
 
 void Library::str(Stack &stack) const
 {
-  std::ostringstream os;
-  os << stack.pop().getDouble();
-  stack.push(os.str());
+  Value v(stack.pop().getDouble());
+  v.stringify();
+  stack.push(std::move(v));
 }
 
 void Library::print(Stack& stack, Memory& mem)
 {
-  std::ostringstream s;
-  print(&s,stack,mem);
-  if (!s.str().empty())
+  std::string s;
+  print(s,stack,mem);
+  if (!s.empty())
   {
     if (outputfile)
     {
-      outputfile->write(s.str());
+      outputfile->write(s);
     }
     else if (os)
     {
-      os->write(s.str());
+      os->write(s);
       os->flush();
     }
   }
 }
 
-void Library::print(std::ostream* printstream, Stack& stack, Memory& mem)
+void Library::print(std::string& out, Stack& stack, Memory& mem)
 {
   int32_t narg = stack.pop().getInt();
   if (narg == 0)
@@ -483,7 +614,7 @@ void Library::print(std::ostream* printstream, Stack& stack, Memory& mem)
       doscmd.clear();
     }
     else
-      print(printstream,args);
+      print(out,args);
   }
   else
   {
@@ -499,31 +630,28 @@ void Library::print(std::ostream* printstream, Stack& stack, Memory& mem)
       }
       else
       {
-        std::ostringstream os;
         if (a.type == Type::int32Type)
-          os << a.i32;
+          NumberFormat::append(doscmd,a.i32);
         else if (a.type == Type::doubleType)
-          os << a.d;
+          NumberFormat::append(doscmd,a.d);
         else if (a.type == Type::stringType)
-          os << a.s;
-        doscmd += os.str();
+          doscmd += a.s;
       }
     }
   }
 }
 
-void Library::print(std::ostream *printstream, const std::vector<VariableArgument> &args)
+void Library::print(std::string& out, const std::vector<VariableArgument> &args)
 {
   for (const VariableArgument& a : args)
   {
     if (a.type == Type::int32Type)
-      *printstream << a.i32;
+      NumberFormat::append(out,a.i32);
     else if (a.type == Type::doubleType)
-      *printstream << a.d;
+      NumberFormat::append(out,a.d);
     else if (a.type == Type::stringType)
-      *printstream << a.s;
+      out += a.s;
   }
-  printstream->flush();
 }
 
 void Library::printInverse()
@@ -742,11 +870,7 @@ void Library::printf(std::ostream* printstream, Stack& stack) const
   }
   VariableArgument a = args.back();
   args.pop_back();
-  if (a.type != Type::stringType)
-  {
-    stack.push(0);
-    return;
-  }
+  if (a.type != Type::stringType) return;
   const char* c = a.s.c_str();
   while (*c != '\0')
   {
@@ -930,12 +1054,12 @@ void Library::input(Stack &stack) const
     {
       if (t == Type::int32Type)
       {
-        int32_t v = std::stoi(fields[index]);
+        int32_t v = NumberFormat::scanInt(fields[index]);
         stack.push(v);
       }
       else if (t == Type::doubleType)
       {
-        double v = std::stod(fields[index]);
+        double v = NumberFormat::scan(fields[index]);
         stack.push(v);
       }
       else if (t == Type::stringType)
@@ -1031,9 +1155,10 @@ void Library::peek(Stack &stack) const
       stack.push(DiskFile::getErrorCode());
       break;
     case -16384:
-      {
-        if (is) stack.push(static_cast<int32_t>(is->getLastKey())+128);
-      }
+      if (is)
+        stack.push(static_cast<int32_t>(is->getLastKey())+128);
+      else
+        stack.push(0);
       break;
     default:
       stack.push(0);
@@ -1092,39 +1217,110 @@ void Library::text() const
   os->setScreenMode(OutputStream::Text);
 }
 
-void Library::saveMemory(const std::string &filename, const Memory &mem)
+/*
+ * The memory is saved as a log: a full snapshot followed by snapshots of
+ * the changes, which BSAVE appends while the memory was saved to or loaded
+ * from the same file before. The log is compacted into a single snapshot
+ * after MEMORY_LOG_DELTAS changes or when the changes outgrow the full
+ * snapshot. The file starts with the load address and the length of the
+ * full snapshot like a binary file of DOS 3.3; the length covers only that
+ * snapshot, each appended snapshot of the changes carries a length of its
+ * own.
+ */
+void Library::saveMemory(const std::string &filename, Memory &mem)
 {
-  nlohmann::json j = mem.save();
+  bool append = filename == memoryLog && mem.canSaveChanges() && logDeltas < MEMORY_LOG_DELTAS
+      && logDeltaSize < logBaseSize && std::filesystem::exists(filename);
   std::ostringstream s;
-  s << j;
+  if (append)
+    mem.saveChanges(s);
+  else
+    mem.saveSnapshot(s);
   std::string data = s.str();
-  std::ofstream os(filename);
+  std::ofstream os(filename,append ? std::ios::binary | std::ios::app : std::ios::binary);
   if (!os.fail())
   {
-    uint32_t addr = 0x69;
-    os.write(reinterpret_cast<const char*>(&addr),sizeof(addr));
-    uint32_t len = data.length() +1;
+    if (!append)
+    {
+      uint32_t addr = 0x69;
+      os.write(reinterpret_cast<const char*>(&addr),sizeof(addr));
+    }
+    uint32_t len = data.length();
     os.write(reinterpret_cast<const char*>(&len),sizeof(len));
-    os.write(data.c_str(),len);
+    os.write(data.data(),len);
     os.close();
   }
+  if (os.fail())
+  {
+    memoryLog.clear();
+    return;
+  }
+  if (append)
+  {
+    logDeltas++;
+    logDeltaSize += data.length();
+  }
+  else
+  {
+    mem.markSaved();
+    memoryLog = filename;
+    logDeltas = 0;
+    logBaseSize = data.length();
+    logDeltaSize = 0;
+  }
 }
 
+/*
+ * Replays the log written by saveMemory(). A file of an older version holds
+ * the memory as JSON. A save which was interrupted leaves an incomplete
+ * record at the end of the log; the replay stops before it and the next
+ * save writes a new log instead of appending behind it.
+ */
 void Library::restoreMemory(const std::string &filename, Memory &mem)
 {
   uint32_t addr;
-  std::ifstream s(filename);
+  std::ifstream s(filename,std::ios::binary);
   if (s.is_open() && !s.fail())
   {
     s.read(reinterpret_cast<char*>(&addr),sizeof(addr));
-    uint32_t len;
+    uint32_t len = 0;
     s.read(reinterpret_cast<char*>(&len),sizeof(len));
-    char txt[len];
-    s.read(txt,len);
+    if (s.fail()) return;
+    std::vector<char> data(len);
+    s.read(data.data(),len);
+    data.resize(s.gcount());
+    if (!Memory::isSnapshot(data.data(),data.size()))
+    {
+      data.push_back(0);
+      mem.restore(nlohmann::json::parse(data.data()));
+      memoryLog.clear();
+      return;
+    }
+    mem.restoreSnapshot(data.data(),data.size());
+    logDeltas = 0;
+    logBaseSize = data.size();
+    logDeltaSize = 0;
+    bool torn = false;
+    while (s.read(reinterpret_cast<char*>(&len),sizeof(len)))
+    {
+      data.resize(len);
+      s.read(data.data(),len);
+      if (static_cast<uint32_t>(s.gcount()) < len)
+      {
+        torn = true;
+        break;
+      }
+      mem.restoreSnapshot(data.data(),data.size());
+      logDeltas++;
+      logDeltaSize += data.size();
+    }
+    torn = torn || s.gcount() > 0;
     s.close();
-    std::istringstream is(txt);
-    nlohmann::json j = nlohmann::json::parse(is);
-    mem.restore(j);
+    mem.markSaved();
+    if (torn)
+      memoryLog.clear();
+    else
+      memoryLog = filename;
   }
 }
 
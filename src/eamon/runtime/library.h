@@ -76,6 +76,26 @@ public:
 
   static const std::vector<LibraryFunction>& getFunctions();
 
+  /**
+   * @brief Returns the position of the argument count of a function with a
+   * variable number of arguments.
+   * The argument count is an int32 value below the given number of top most
+   * entries of the stack minus one, i.e. 1 denotes the top of the stack.
+   * @param id the id of the function
+   * @return position of the argument count or 0 if the number of arguments is fixed
+   */
+  static int32_t getArgumentCountPosition(uint16_t id);
+
+  /**
+   * @brief Returns the number of values a function takes from and puts on the stack.
+   * @param id the id of the function
+   * @param narg the argument count of a function with a variable number of arguments
+   * @param pop receives the number of values taken from the stack
+   * @param push receives the number of values put on the stack
+   * @return false if the function is unknown or the argument count is illegal
+   */
+  static bool getStackEffect(uint16_t id, int32_t narg, int32_t& pop, int32_t& push);
+
   virtual void execute(uint16_t id, Memory& mem, Stack& stack, const ConstantData* data);
 
   void reset();
@@ -98,11 +118,14 @@ private:
   void mid(Stack& stack) const;
   void mid1(Stack& stack) const;
   void right(Stack& stack) const;
+  void len(Stack& stack) const;
+  void asc(Stack& stack) const;
   void chr(Stack& stack) const;
   void str(Stack& stack) const;
+  void fre(Stack& stack) const;
   void print(Stack& stack, Memory& mem);
-  void print(std::ostream* printstream, Stack& stack, Memory& mem);
-  void print(std::ostream* printstream, const std::vector<VariableArgument>& args);
+  void print(std::string& out, Stack& stack, Memory& mem);
+  void print(std::string& out, const std::vector<VariableArgument>& args);
   void printInverse();
   void printNormal();
   void printExecute(Memory& mem);
@@ -128,7 +151,7 @@ private:
   void htab(Stack& stack) const;
   void home() const;
   void text() const;
-  void saveMemory(const std::string& filename, const Memory& mem);
+  void saveMemory(const std::string& filename, Memory& mem);
   void restoreMemory(const std::string& filename, Memory& mem);
 
   static std::string trim(std::string s);
@@ -149,6 +172,10 @@ private:
   std::vector<uint8_t> hiresPage2;
   std::shared_ptr<OutputStream> os;
   std::shared_ptr<InputStream> is;
+  std::string memoryLog;  /* file of the last BSAVE or BLOAD of the memory */
+  uint32_t logDeltas;     /* number of snapshots of the changes appended to the log */
+  uint64_t logBaseSize;   /* size of the full snapshot at the start of the log */
+  uint64_t logDeltaSize;  /* size of the appended snapshots */
 
   static LibraryFunction UNDEFINED;
 
@@ -21,147 +21,832 @@
  ********************************************************************************/
 
 #include "memory.h"
+#include <algorithm>
+#include <cstring>
 #include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+/* sections of the binary snapshot */
+#define SNAPSHOT_EXTENTS 1
+#define SNAPSHOT_VALUES 2
+#define SNAPSHOT_TEXT 3
+#define SNAPSHOT_CHUNKS 4
+#define SNAPSHOT_SECTIONS 5
+
+/* types of the value records */
+#define SNAPSHOT_INVALID 0
+#define SNAPSHOT_INT32 1
+#define SNAPSHOT_DOUBLE 2
+#define SNAPSHOT_STRING 3
+
+struct SnapshotHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t sections;
+};
 
+/* the data follows the section, padded to a multiple of 8 bytes */
+struct SnapshotSection
+{
+  uint32_t id;
+  uint32_t count;     /* number of records */
+  uint64_t size;      /* size of the data without the padding */
+  uint64_t checksum;  /* FNV-1a hash of the data */
+};
 
-ConstantData::ConstantData()
+struct SnapshotValue
 {
-}
+  uint32_t type;
+  uint32_t length;    /* number of characters of a string */
+  union {
+    int32_t i;
+    double d;
+    uint64_t offset;  /* position of the characters of a string in the text section */
+  };
+};
+
+/* a part of a variable saved by a snapshot of the changes */
+struct SnapshotChunk
+{
+  uint32_t addr;
+  uint32_t size;      /* number of values of the variable */
+  uint32_t offset;    /* first value of the part */
+  uint32_t count;     /* number of values of the part */
+};
 
-ConstantData::~ConstantData()
+static uint64_t checksum(const char* data, size_t size)
 {
+  uint64_t h = 14695981039346656037ULL;
+  for (size_t i=0;i<size;i++)
+  {
+    h ^= static_cast<uint8_t>(data[i]);
+    h *= 1099511628211ULL;
+  }
+  return h;
 }
 
+/* values of the same type which are equal */
+static bool identical(const Value& a, const Value& b)
+{
+  if (a.isInt() != b.isInt() || a.isDouble() != b.isDouble() || a.isString() != b.isString()) return false;
+  return Value::equals(a,b);
+}
 
+static void writeSection(std::ostream& os, uint32_t id, size_t count, const void* data, size_t size)
+{
+  static const char padding[8] = { 0 };
+  SnapshotSection s;
+  s.id = id;
+  s.count = static_cast<uint32_t>(count);
+  s.size = size;
+  s.checksum = checksum(static_cast<const char*>(data),size);
+  os.write(reinterpret_cast<const char*>(&s),sizeof(s));
+  os.write(static_cast<const char*>(data),size);
+  os.write(padding,(8 - size % 8) % 8);
+}
 
+/*
+ * Collects the value records and the characters of the strings and writes
+ * them after a table describing the variables.
+ */
+class SnapshotWriter
+{
+public:
+  void add(const Value& v)
+  {
+    SnapshotValue r;
+    r.length = 0;
+    r.offset = 0;
+    if (v.isInt())
+    {
+      r.type = SNAPSHOT_INT32;
+      r.i = v.getInt();
+    }
+    else if (v.isDouble())
+    {
+      r.type = SNAPSHOT_DOUBLE;
+      r.d = v.getDouble();
+    }
+    else if (v.isString())
+    {
+      r.type = SNAPSHOT_STRING;
+      r.length = v.getLength();
+      r.offset = text.size();
+      text.append(v.getChars(),v.getLength());
+    }
+    else
+    {
+      r.type = SNAPSHOT_INVALID;
+    }
+    records.push_back(r);
+  }
 
+  uint32_t getCount() const
+  {
+    return static_cast<uint32_t>(records.size());
+  }
 
+  template<typename T> void write(std::ostream& os, uint32_t id, const std::vector<T>& table) const
+  {
+    SnapshotHeader h;
+    memcpy(h.magic,MEMORY_SNAPSHOT_MAGIC,sizeof(h.magic));
+    h.version = MEMORY_SNAPSHOT_VERSION;
+    h.sections = 3;
+    os.write(reinterpret_cast<const char*>(&h),sizeof(h));
+    writeSection(os,id,table.size(),table.data(),table.size()*sizeof(T));
+    writeSection(os,SNAPSHOT_VALUES,records.size(),records.data(),records.size()*sizeof(SnapshotValue));
+    writeSection(os,SNAPSHOT_TEXT,text.size(),text.data(),text.size());
+  }
 
-Chunk::Chunk()
+private:
+  std::vector<SnapshotValue> records;
+  std::string text;
+};
+
+/*
+ * Checks the sections of a snapshot and decodes the values. Sections with
+ * an unknown id are skipped, so a later version may add sections without
+ * changing the version; the id 0 is never used.
+ */
+class SnapshotReader
 {
-  values.push_back(0);
-}
+public:
+  SnapshotReader(const char* data, size_t size):
+    sections(),
+    content()
+  {
+    if (!Memory::isSnapshot(data,size)) throw std::runtime_error("damaged memory snapshot");
+    SnapshotHeader h;
+    memcpy(&h,data,sizeof(h));
+    if (h.version != MEMORY_SNAPSHOT_VERSION) throw std::runtime_error("unsupported memory snapshot version");
+    size_t pos = sizeof(h);
+    for (uint32_t i=0;i<h.sections;i++)
+    {
+      SnapshotSection s;
+      if (size - pos < sizeof(s)) throw std::runtime_error("damaged memory snapshot");
+      memcpy(&s,data+pos,sizeof(s));
+      pos += sizeof(s);
+      uint64_t padded = (s.size + 7) & ~7ULL;
+      if (s.size > size - pos || padded > size - pos) throw std::runtime_error("damaged memory snapshot");
+      if (checksum(data+pos,s.size) != s.checksum || s.id == 0) throw std::runtime_error("damaged memory snapshot");
+      if (s.id < SNAPSHOT_SECTIONS)
+      {
+        sections[s.id] = s;
+        content[s.id] = data + pos;
+      }
+      pos += padded;
+    }
+    const SnapshotSection& sv = sections[SNAPSHOT_VALUES];
+    if (content[SNAPSHOT_VALUES] == nullptr || content[SNAPSHOT_TEXT] == nullptr || sv.size != sv.count * sizeof(SnapshotValue))
+      throw std::runtime_error("damaged memory snapshot");
+  }
 
-nlohmann::json Chunk::toJson() const
-{
-  nlohmann::json j;
-  nlohmann::json jv;
-  for (const auto& v : values)
+  bool has(uint32_t id) const
   {
-    jv.push_back(v.toJson());
+    return content[id] != nullptr;
   }
-  j["values"] = jv;
-  return j;
-}
 
-Chunk Chunk::fromJson(const nlohmann::json &j)
-{
-  Chunk c;
-  c.values.clear();
-  for (const nlohmann::json& tmp : j.at("values"))
+  /* the records of the table with the given id */
+  template<typename T> std::vector<T> table(uint32_t id) const
   {
-    c.values.push_back(Value::fromJson(tmp));
+    const SnapshotSection& s = sections[id];
+    if (s.size != s.count * sizeof(T)) throw std::runtime_error("damaged memory snapshot");
+    std::vector<T> t(s.count);
+    if (s.size > 0) memcpy(t.data(),content[id],s.size);
+    return t;
   }
-  return c;
+
+  std::vector<Value> values() const
+  {
+    const SnapshotSection& sv = sections[SNAPSHOT_VALUES];
+    const SnapshotSection& st = sections[SNAPSHOT_TEXT];
+    std::vector<Value> v;
+    v.reserve(sv.count);
+    for (uint32_t i=0;i<sv.count;i++)
+    {
+      SnapshotValue r;
+      memcpy(&r,content[SNAPSHOT_VALUES] + i * sizeof(r),sizeof(r));
+      switch (r.type)
+      {
+        case SNAPSHOT_INVALID:
+          v.push_back(Value());
+          break;
+        case SNAPSHOT_INT32:
+          v.push_back(Value(r.i));
+          break;
+        case SNAPSHOT_DOUBLE:
+          v.push_back(Value(r.d));
+          break;
+        case SNAPSHOT_STRING:
+          if (r.offset > st.size || r.length > st.size - r.offset) throw std::runtime_error("damaged memory snapshot");
+          v.push_back(Value(content[SNAPSHOT_TEXT] + r.offset,r.length));
+          break;
+        default:
+          throw std::runtime_error("damaged memory snapshot");
+      }
+    }
+    return v;
+  }
+
+private:
+  SnapshotSection sections[SNAPSHOT_SECTIONS];
+  const char* content[SNAPSHOT_SECTIONS];
+};
+
+ConstantData::ConstantData()
+{
+}
+
+ConstantData::~ConstantData()
+{
 }
 
 
 
 
-Memory::Memory()
+
+
+
+Memory::Memory():
+  slotStorage(std::make_shared<std::vector<Value>>()),
+  slotValues(nullptr),
+  slotCount(0),
+  extents(std::make_shared<std::vector<Extent>>()),
+  arrays(std::make_shared<std::map<uint32_t,uint32_t>>()),
+  count(0),
+  garbage(0),
+  generation(0),
+  tracked(false)
 {
 }
 
 void Memory::reset(uint32_t size)
 {
-  mem.clear();
-  mem.resize(size);
+  std::vector<Extent> e(size);
+  for (uint32_t i=0;i<size;i++) e[i] = { i, 1 };
+  assign(std::vector<Value>(size,Value(0)),std::move(e));
 }
 
 int32_t Memory::getInt(uint32_t addr)
 {
-  return mem[addr].values[0].getInt();
+  return getValue(addr,0).getInt();
 }
 
 double Memory::getDouble(uint32_t addr)
 {
-  return mem[addr].values[0].getDouble();
+  return getValue(addr,0).getDouble();
 }
 
 std::string Memory::getString(uint32_t addr)
 {
-  return mem[addr].values[0].getString();
+  return getValue(addr,0).getString();
 }
 
-const Value& Memory::getValue(uint32_t addr, int32_t offset) const
+uint32_t Memory::getGeneration() const
 {
-  return mem[addr].values[offset];
+  return generation;
 }
 
-void Memory::store(int32_t v, uint32_t addr, int32_t offset)
+void Memory::store(const std::string& v, uint32_t addr, int32_t offset)
 {
-  mem[addr].values[offset].set(v);
+  at(addr,offset).set(v);
 }
 
-void Memory::store(double v, uint32_t addr, int32_t offset)
+void Memory::clr(const Value &zero, uint32_t addr)
 {
-  mem[addr].values[offset].set(v);
+  const Extent& e = (*extents)[addr];
+  fill(e.start,e.size,zero);
 }
 
-void Memory::store(const std::string& v, uint32_t addr, int32_t offset)
+void Memory::dec(uint32_t addr)
 {
-  mem[addr].values[offset].set(v);
+  write(addr).dec();
 }
 
-void Memory::store(const Value& v, uint32_t addr, int32_t offset)
+void Memory::inc(uint32_t addr)
 {
-  mem[addr].values[offset] = v;
+  write(addr).inc();
 }
 
-void Memory::clr(const Value &zero, uint32_t addr)
+void Memory::append(const Value& v, uint32_t addr)
+{
+  write(addr).append(v);
+}
+
+/*
+ * An array keeps its range if it still fits, otherwise it is moved to the
+ * end of the values; the old range is cleared, so it does not keep strings
+ * alive. The values given up behind the slots are counted as garbage.
+ */
+void Memory::resize(uint32_t addr, uint32_t size)
 {
-  for (auto& v : mem[addr].values)
+  Extent e = (*extents)[addr];
+  const bool slot = e.start < extents->size();
+  const uint32_t start = e.start;
+  const uint32_t old = e.size;
+  Value v = e.size > 0 ? read(e.start) : Value();
+  v.clear();
+  if (size > e.size)
+  {
+    fill(e.start,e.size,Value());
+    if (!slot && e.start + e.size == count)
+      count = e.start; /* the array is the last one */
+    else if (!slot)
+      garbage += e.size;
+    e.start = count;
+    grow(size);
+  }
+  else
   {
-    v = zero;
+    fill(e.start+size,e.size-size,Value());
+    if (!slot) garbage += e.size - size;
   }
+  e.size = size;
+  fill(e.start,size,v);
+  if (!slot && old > 0) writeArrays().erase(start);
+  if (e.start >= extents->size() && size > 0) writeArrays()[e.start] = addr;
+  writeExtents()[addr] = e;
+  resized.push_back(addr);
+  generation++;
+  if (garbage > count - extents->size() - garbage) compact();
 }
 
-void Memory::dec(uint32_t addr)
+uint32_t Memory::getSize(uint32_t addr) const
 {
-  mem[addr].values[0].dec();
+  return (*extents)[addr].size;
 }
 
-void Memory::inc(uint32_t addr)
+Memory::Checkpoint Memory::checkpoint()
 {
-  mem[addr].values[0].inc();
+  Checkpoint c;
+  c.slotStorage = slotStorage;
+  c.pages = pages;
+  c.extents = extents;
+  c.arrays = arrays;
+  c.count = count;
+  c.garbage = garbage;
+  c.heap = StringHeap::getCurrent();
+  c.thread = std::this_thread::get_id();
+  generation++;
+  return c;
 }
 
-void Memory::resize(uint32_t addr, uint32_t size)
+void Memory::restore(const Checkpoint& c)
 {
-  Value v = mem[addr].values[0];
-  v.clear();
-  mem[addr].values.resize(size);
-  for (uint32_t i=0;i<size;i++) mem[addr].values[i] = v;
+  if (c.thread != std::this_thread::get_id()) throw std::runtime_error("checkpoint of another thread");
+  slotStorage = c.slotStorage;
+  slotValues = slotStorage->data();
+  slotCount = static_cast<uint32_t>(slotStorage->size());
+  pages = c.pages;
+  extents = c.extents;
+  arrays = c.arrays;
+  count = c.count;
+  garbage = c.garbage;
+  dirty.assign(pages.size(),0);
+  if (c.heap != StringHeap::getCurrent()) detach();
+  std::fill(dirty.begin(),dirty.end(),0);
+  changes.clear();
+  resized.clear();
+  tracked = false;
+  generation++;
+}
+
+/*
+ * The differing values are mapped to their variables: a value in the slots
+ * belongs to the address of the slot, unless that variable was moved; the
+ * moved arrays are looked up in a list sorted by their start. A variable
+ * which was only moved, e.g. by a compaction, is compared value by value.
+ */
+std::vector<uint32_t> Memory::diff(const Checkpoint& a, const Checkpoint& b)
+{
+  std::vector<uint32_t> changed;
+  auto compare = [&](uint32_t index) {
+    const Value* va = a.find(index);
+    const Value* vb = b.find(index);
+    if ((va == nullptr) != (vb == nullptr) || (va != nullptr && !identical(*va,*vb))) changed.push_back(index);
+  };
+  uint32_t slotCount = static_cast<uint32_t>(std::max(a.slotStorage->size(),b.slotStorage->size()));
+  if (a.slotStorage != b.slotStorage)
+  {
+    for (uint32_t index=0;index<slotCount;index++) compare(index);
+  }
+  size_t n = std::max(a.pages.size(),b.pages.size());
+  for (size_t p=0;p<n;p++)
+  {
+    const Page* pa = p < a.pages.size() ? a.pages[p].get() : nullptr;
+    const Page* pb = p < b.pages.size() ? b.pages[p].get() : nullptr;
+    if (pa == pb) continue;
+    for (uint32_t i=0;i<MEMORY_PAGE_SIZE;i++)
+    {
+      uint32_t index = static_cast<uint32_t>(p) * MEMORY_PAGE_SIZE + i;
+      if (index >= slotCount) compare(index);
+    }
+  }
+  std::vector<uint32_t> addrs;
+  const std::vector<Extent>& ea = *a.extents;
+  const std::vector<Extent>& eb = *b.extents;
+  if (a.extents != b.extents)
+  {
+    for (uint32_t addr=0;addr<std::max(ea.size(),eb.size());addr++)
+    {
+      if (addr >= ea.size() || addr >= eb.size() || ea[addr].start != eb[addr].start || ea[addr].size != eb[addr].size)
+        addrs.push_back(addr);
+    }
+  }
+  for (const std::vector<Extent>* e : { &ea, &eb })
+  {
+    std::vector<std::pair<uint32_t,uint32_t>> moved;
+    bool sorted = false;
+    for (uint32_t index : changed)
+    {
+      if (index < e->size() && (*e)[index].start == index)
+      {
+        addrs.push_back(index);
+        continue;
+      }
+      if (!sorted)
+      {
+        for (uint32_t addr=0;addr<e->size();addr++)
+          if ((*e)[addr].start != addr) moved.push_back({ (*e)[addr].start, addr });
+        std::sort(moved.begin(),moved.end());
+        sorted = true;
+      }
+      auto it = std::upper_bound(moved.begin(),moved.end(),std::make_pair(index,UINT32_MAX));
+      if (it != moved.begin())
+      {
+        --it;
+        if (index < it->first + (*e)[it->second].size) addrs.push_back(it->second);
+      }
+    }
+  }
+  std::sort(addrs.begin(),addrs.end());
+  addrs.erase(std::unique(addrs.begin(),addrs.end()),addrs.end());
+  auto moved = [&](uint32_t addr) {
+    if (addr >= ea.size() || addr >= eb.size() || ea[addr].size != eb[addr].size) return false;
+    for (uint32_t i=0;i<ea[addr].size;i++)
+    {
+      if (!identical(*a.find(ea[addr].start + i),*b.find(eb[addr].start + i))) return false;
+    }
+    return true;
+  };
+  addrs.erase(std::remove_if(addrs.begin(),addrs.end(),moved),addrs.end());
+  return addrs;
 }
 
 nlohmann::json Memory::save() const
 {
   nlohmann::json j;
   nlohmann::json jc;
-  for (const Chunk& c : mem)
+  for (const Extent& e : *extents)
   {
-    jc.push_back(c.toJson());
+    nlohmann::json jv;
+    for (uint32_t i=0;i<e.size;i++) jv.push_back(read(e.start+i).toJson());
+    nlohmann::json c;
+    c["values"] = jv;
+    jc.push_back(c);
   }
   j["mem"] = jc;
   return j;
 }
 
+/*
+ * The snapshot leaves out the ranges of moved arrays: the slots of the
+ * addresses come first, followed by the arrays which do not start in the
+ * slot of their address.
+ */
+void Memory::saveSnapshot(std::ostream& os) const
+{
+  std::vector<Extent> e = *extents;
+  SnapshotWriter w;
+  for (uint32_t i=0;i<e.size();i++) w.add(read(i));
+  for (Extent& x : e)
+  {
+    if (x.start < e.size()) continue;
+    uint32_t start = w.getCount();
+    for (uint32_t i=0;i<x.size;i++) w.add(read(x.start+i));
+    x.start = start;
+  }
+  w.write(os,SNAPSHOT_EXTENTS,e);
+}
+
+/*
+ * The changed pages are mapped to the variables on them: a value in the
+ * slots belongs to the address of the slot, unless that variable was
+ * moved; the moved arrays are looked up by their start. A resized variable
+ * is saved completely. The parts are sorted, so the snapshot does not
+ * depend on the order in which the pages were written.
+ */
+void Memory::saveChanges(std::ostream& os)
+{
+  std::sort(resized.begin(),resized.end());
+  resized.erase(std::unique(resized.begin(),resized.end()),resized.end());
+  auto all = [&](uint32_t addr) {
+    return std::binary_search(resized.begin(),resized.end(),addr);
+  };
+  std::vector<SnapshotChunk> chunks;
+  for (uint32_t addr : resized)
+  {
+    uint32_t size = (*extents)[addr].size;
+    chunks.push_back({ addr, size, 0, size });
+  }
+  for (uint32_t page : changes)
+  {
+    uint32_t index = page * MEMORY_PAGE_SIZE;
+    uint32_t end = index + MEMORY_PAGE_SIZE;
+    for (;index<std::min(end,slotCount);index++)
+    {
+      const Extent& e = (*extents)[index];
+      if (e.start == index && e.size > 0 && !all(index)) chunks.push_back({ index, 1, 0, 1 });
+    }
+    if (index == end) continue;
+    auto it = arrays->upper_bound(index);
+    if (it != arrays->begin()) --it;
+    for (;it!=arrays->end() && it->first<end;++it)
+    {
+      const Extent& e = (*extents)[it->second];
+      uint32_t from = std::max(e.start,index);
+      uint32_t to = std::min(e.start+e.size,end);
+      if (from < to && !all(it->second)) chunks.push_back({ it->second, e.size, from - e.start, to - from });
+    }
+  }
+  std::sort(chunks.begin(),chunks.end(),[](const SnapshotChunk& a, const SnapshotChunk& b) {
+    return a.addr < b.addr || (a.addr == b.addr && a.offset < b.offset);
+  });
+  SnapshotWriter w;
+  for (const SnapshotChunk& c : chunks)
+  {
+    const Extent& e = (*extents)[c.addr];
+    for (uint32_t i=0;i<c.count;i++) w.add(read(e.start+c.offset+i));
+  }
+  w.write(os,SNAPSHOT_CHUNKS,chunks);
+  markSaved();
+}
+
+/*
+ * A snapshot of the changes is checked completely before the first
+ * variable is changed.
+ */
+void Memory::restoreSnapshot(const char* data, size_t size)
+{
+  SnapshotReader r(data,size);
+  std::vector<Value> v = r.values();
+  if (r.has(SNAPSHOT_EXTENTS))
+  {
+    std::vector<Extent> e = r.table<Extent>(SNAPSHOT_EXTENTS);
+    if (v.size() < e.size()) throw std::runtime_error("damaged memory snapshot");
+    std::vector<Extent> moved;
+    uint64_t used = e.size();
+    for (uint32_t addr=0;addr<e.size();addr++)
+    {
+      const Extent& x = e[addr];
+      if (static_cast<uint64_t>(x.start) + x.size > v.size()) throw std::runtime_error("damaged memory snapshot");
+      if (x.start < e.size())
+      {
+        if (x.start != addr || x.size > 1) throw std::runtime_error("damaged memory snapshot");
+      }
+      else if (x.size > 0)
+      {
+        moved.push_back(x);
+        used += x.size;
+      }
+    }
+    std::sort(moved.begin(),moved.end(),[](const Extent& a, const Extent& b) { return a.start < b.start; });
+    for (size_t i=1;i<moved.size();i++)
+    {
+      if (moved[i-1].start + moved[i-1].size > moved[i].start) throw std::runtime_error("damaged memory snapshot");
+    }
+    uint32_t n = static_cast<uint32_t>(v.size());
+    assign(std::move(v),std::move(e));
+    garbage = static_cast<uint32_t>(n - used);
+  }
+  else if (r.has(SNAPSHOT_CHUNKS))
+  {
+    std::vector<SnapshotChunk> chunks = r.table<SnapshotChunk>(SNAPSHOT_CHUNKS);
+    uint64_t n = 0;
+    for (const SnapshotChunk& c : chunks)
+    {
+      if (c.addr >= extents->size() || static_cast<uint64_t>(c.offset) + c.count > c.size) throw std::runtime_error("damaged memory snapshot");
+      n += c.count;
+    }
+    if (n != v.size()) throw std::runtime_error("damaged memory snapshot");
+    uint32_t index = 0;
+    for (const SnapshotChunk& c : chunks)
+    {
+      if ((*extents)[c.addr].size != c.size) resize(c.addr,c.size);
+      for (uint32_t i=0;i<c.count;i++) at(c.addr,c.offset+i) = std::move(v[index++]);
+    }
+    generation++;
+  }
+  else
+  {
+    throw std::runtime_error("damaged memory snapshot");
+  }
+}
+
+bool Memory::canSaveChanges() const
+{
+  return tracked;
+}
+
+uint32_t Memory::getChangeCount() const
+{
+  return static_cast<uint32_t>(changes.size());
+}
+
+/*
+ * The generation changes, so the JIT takes the pointers of its variables
+ * again and marks them as changed.
+ */
+void Memory::markSaved()
+{
+  for (uint32_t page : changes) dirty[page] = 0;
+  changes.clear();
+  resized.clear();
+  tracked = true;
+  generation++;
+}
+
+bool Memory::isSnapshot(const char* data, size_t size)
+{
+  return size >= sizeof(SnapshotHeader) && memcmp(data,MEMORY_SNAPSHOT_MAGIC,sizeof(SnapshotHeader::magic)) == 0;
+}
+
+/*
+ * Chunks with a single value are stored in the slot of their address, all
+ * others are appended to the values.
+ */
 void Memory::restore(const nlohmann::json& j)
 {
-  mem.clear();
-  for (const nlohmann::json& tmp : j.at("mem"))
+  const nlohmann::json& jc = j.at("mem");
+  std::vector<Value> v(jc.size(),Value(0));
+  std::vector<Extent> e(jc.size());
+  uint32_t addr = 0;
+  for (const nlohmann::json& c : jc)
   {
-    mem.push_back(Chunk::fromJson(tmp));
+    const nlohmann::json& jv = c.at("values");
+    if (jv.size() == 1)
+    {
+      e[addr] = { addr, 1 };
+      v[addr] = Value::fromJson(jv[0]);
+    }
+    else
+    {
+      e[addr] = { static_cast<uint32_t>(v.size()), static_cast<uint32_t>(jv.size()) };
+      for (const nlohmann::json& tmp : jv) v.push_back(Value::fromJson(tmp));
+    }
+    addr++;
   }
+  assign(std::move(v),std::move(e));
 }
 
+std::vector<Memory::Extent>& Memory::writeExtents()
+{
+  if (extents.use_count() > 1) extents = std::make_shared<std::vector<Extent>>(*extents);
+  return *extents;
+}
+
+std::map<uint32_t,uint32_t>& Memory::writeArrays()
+{
+  if (arrays.use_count() > 1) arrays = std::make_shared<std::map<uint32_t,uint32_t>>(*arrays);
+  return *arrays;
+}
+
+/*
+ * Fills the values page by page, so a page is only looked up, copied and
+ * marked as changed once. The slots are divided into pages as well, and a
+ * run in the slots also ends with the last slot.
+ */
+void Memory::fill(uint32_t index, uint32_t n, const Value& v)
+{
+  while (n > 0)
+  {
+    uint32_t k = std::min<uint32_t>(n,MEMORY_PAGE_SIZE - index % MEMORY_PAGE_SIZE);
+    if (index < slotCount) k = std::min(k,slotCount - index);
+    Value* p = writePage(index);
+    std::fill(p,p+k,v);
+    index += k;
+    n -= k;
+  }
+}
+
+void Memory::grow(uint32_t n)
+{
+  count += n;
+  while (pages.size() * MEMORY_PAGE_SIZE < count)
+  {
+    bool slotsOnly = (pages.size() + 1) * MEMORY_PAGE_SIZE <= slotCount;
+    pages.push_back(slotsOnly ? nullptr : std::make_shared<Page>());
+  }
+  dirty.resize(pages.size(),0);
+}
+
+/*
+ * The moved arrays are moved to the front in the order of their ranges, so
+ * every value moves towards the slots and none is overwritten before it is
+ * moved. The pages written are marked as changed, hence saveChanges() saves
+ * the moved arrays; the pages at the end are kept for the next arrays.
+ */
+void Memory::compact()
+{
+  std::vector<Extent>& e = writeExtents();
+  std::vector<std::pair<uint32_t,uint32_t>> moved;
+  for (uint32_t addr=0;addr<e.size();addr++)
+    if (e[addr].start >= e.size()) moved.push_back({ e[addr].start, addr });
+  std::sort(moved.begin(),moved.end());
+  uint32_t index = static_cast<uint32_t>(e.size());
+  for (const std::pair<uint32_t,uint32_t>& m : moved)
+  {
+    Extent& x = e[m.second];
+    if (x.start != index)
+    {
+      for (uint32_t i=0;i<x.size;i++)
+      {
+        Value tmp = std::move(write(x.start+i));
+        write(index+i) = std::move(tmp);
+      }
+      x.start = index;
+    }
+    index += x.size;
+  }
+  fill(index,count-index,Value());
+  count = index;
+  garbage = 0;
+  indexArrays();
+  generation++;
+}
+
+/*
+ * The first value of every address goes to the slots, the rest to the
+ * pages.
+ */
+void Memory::assign(std::vector<Value>&& v, std::vector<Extent>&& e)
+{
+  slotCount = static_cast<uint32_t>(e.size());
+  slotStorage = std::make_shared<std::vector<Value>>(std::make_move_iterator(v.begin()),std::make_move_iterator(v.begin()+slotCount));
+  slotValues = slotStorage->data();
+  pages.clear();
+  count = 0;
+  garbage = 0;
+  grow(static_cast<uint32_t>(v.size()));
+  for (uint32_t i=slotCount;i<v.size();i++) write(i) = std::move(v[i]);
+  extents = std::make_shared<std::vector<Extent>>(std::move(e));
+  indexArrays();
+  dirty.assign(pages.size(),0);
+  changes.clear();
+  resized.clear();
+  tracked = false;
+  generation++;
+}
+
+/*
+ * Copies the strings into the current heap. The slots and the pages holding
+ * strings are copied on the way, so the memory no longer refers to the heap
+ * of the checkpoint, which may go away first.
+ */
+void Memory::detach()
+{
+  for (uint32_t index=0;index<count;index++)
+  {
+    const Value& v = read(index);
+    if (v.isString())
+    {
+      Value s(v.getChars(),v.getLength());
+      write(index) = std::move(s);
+    }
+  }
+}
+
+/* indexes the moved arrays after their ranges were set */
+void Memory::indexArrays()
+{
+  std::shared_ptr<std::map<uint32_t,uint32_t>> a = std::make_shared<std::map<uint32_t,uint32_t>>();
+  const std::vector<Extent>& e = *extents;
+  for (uint32_t addr=0;addr<e.size();addr++)
+    if (e[addr].start >= e.size() && e[addr].size > 0) (*a)[e[addr].start] = addr;
+  arrays = a;
+}
+
+
+
+
+
+Memory::Checkpoint::Checkpoint():
+  slotStorage(std::make_shared<std::vector<Value>>()),
+  extents(std::make_shared<std::vector<Extent>>()),
+  arrays(std::make_shared<std::map<uint32_t,uint32_t>>()),
+  count(0),
+  garbage(0),
+  heap(nullptr),
+  thread(std::this_thread::get_id())
+{
+}
+
+/* the value at the index or nullptr behind the values */
+const Value* Memory::Checkpoint::find(uint32_t index) const
+{
+  if (index >= count) return nullptr;
+  if (index < slotStorage->size()) return &(*slotStorage)[index];
+  return &pages[index / MEMORY_PAGE_SIZE]->values[index % MEMORY_PAGE_SIZE];
+}
@@ -24,8 +24,18 @@
 #define MEMORY_H
 
 #include "value.h"
+#include <map>
+#include <memory>
+#include <ostream>
+#include <thread>
 #include <vector>
 
+/* magic number and version of the binary memory snapshot */
+#define MEMORY_SNAPSHOT_MAGIC "EAMONMEM"
+#define MEMORY_SNAPSHOT_VERSION 1
+/* number of values in a page of the memory */
+#define MEMORY_PAGE_SIZE 64
+
 
 class Symbol;
 
@@ -64,26 +74,34 @@ public:
 };
 
 /**
- * @brief A chunk of memory contains one or more values.
+ * @brief The Memory class holds the values of the global variables.
+ *
+ * The values form a single array. The first part of the array has one slot
+ * per address. The number of slots is fixed by the executable, so they are
+ * kept in one flat vector and the value of a scalar variable is read with a
+ * single indexed load. An array variable is a range of the array: it
+ * starts in the slot of its address and moves to the end of the array when
+ * it outgrows its range. Only the values behind the slots are split into
+ * pages. The ranges of all variables are kept in a table indexed by the
+ * address. Once the ranges left behind by the moved arrays take more
+ * values than the moved arrays themselves, the moved arrays are compacted.
+ *
+ * The slots, the pages and the table are reference counted and shared with
+ * the checkpoints of the memory. Shared slots are copied as a whole and a
+ * shared page on its own on the first write, so taking a checkpoint or
+ * restoring it only copies the list of pages, and the memory then pays for
+ * what it writes.
  *
- * In general, a chunk of memory maps to a variable in the higher level
- * language.
+ * Every page written since the last save is marked as changed, so
+ * saveChanges() writes only the parts of the variables on these pages. The
+ * slots are divided into pages of the same size for this, and the moved
+ * arrays are kept in an index by their start to find them from a page.
  */
-class Chunk
-{
-public:
-  Chunk();
-
-  nlohmann::json toJson() const;
-
-  static Chunk fromJson(const nlohmann::json& j);
-
-  std::vector<Value> values;
-};
-
 class Memory
 {
 public:
+  class Checkpoint;
+
   Memory();
 
   void reset(uint32_t size);
@@ -96,6 +114,39 @@ public:
 
   const Value& getValue(uint32_t addr, int32_t offset) const;
 
+  /**
+   * @brief Gets the value of a scalar variable.
+   *
+   * Unlike getValue(), this does not look at the range of the variable, so
+   * it must not be used for an array variable. The value is neither copied
+   * nor marked as changed. If the slots are shared with a checkpoint, the
+   * reference becomes stale when they are copied on the next write, which
+   * changes the generation.
+   * @param addr the address of the variable
+   * @return the value
+   */
+  const Value& getScalarValue(uint32_t addr) const;
+
+  /**
+   * @brief Gets a pointer to the value of a scalar variable for writing.
+   *
+   * Like getScalarValue(), this must not be used for an array variable. The
+   * slots are copied if they are shared with a checkpoint.
+   *
+   * The pointer stays valid until the memory is reset, restored, resized,
+   * checkpointed or saved, which changes the generation. The page of the
+   * value is marked as changed when the pointer is taken.
+   * @param addr the address of the variable
+   * @return pointer to the value
+   */
+  Value* getScalar(uint32_t addr);
+
+  /**
+   * @brief Gets the generation of the memory layout.
+   * @return a number which changes whenever pointers to values become invalid
+   */
+  uint32_t getGeneration() const;
+
   void store(int32_t v, uint32_t addr, int32_t offset);
 
   void store(double v, uint32_t addr, int32_t offset);
@@ -104,22 +155,291 @@ public:
 
   void store(const Value& v, uint32_t addr, int32_t offset);
 
+  void store(Value&& v, uint32_t addr, int32_t offset);
+
   void clr(const Value& zero, uint32_t addr);
 
   void dec(uint32_t addr);
 
   void inc(uint32_t addr);
 
+  /**
+   * @brief Appends a string to a string variable in place.
+   * @param v the string to append
+   * @param addr the address of the variable
+   */
+  void append(const Value& v, uint32_t addr);
+
   void resize(uint32_t addr, uint32_t size);
 
+  /**
+   * @brief Gets the number of values of a variable.
+   * @param addr the address of the variable
+   * @return the number of values
+   */
+  uint32_t getSize(uint32_t addr) const;
+
+  /**
+   * @brief Takes a checkpoint of the memory.
+   *
+   * The checkpoint shares the slots and all pages with the memory, so it
+   * takes time in the number of pages only. The generation changes, since
+   * the slots and the pages must be copied before they are written again.
+   * @return the checkpoint
+   */
+  Checkpoint checkpoint();
+
+  /**
+   * @brief Restores a checkpoint.
+   *
+   * The memory shares the slots and the pages of the checkpoint. Restoring
+   * a checkpoint of another memory forks that memory. If the checkpoint was
+   * taken with another current string heap, its strings are copied into
+   * the current heap, so the memories share no strings.
+   * @param c the checkpoint
+   * @throws runtime_error if the checkpoint was taken on another thread
+   */
+  void restore(const Checkpoint& c);
+
+  /**
+   * @brief Finds the variables which differ between two checkpoints.
+   *
+   * Pages shared by both checkpoints are skipped, so the time depends on the
+   * number of slots and of pages written in between.
+   * @param a the first checkpoint
+   * @param b the second checkpoint
+   * @return the sorted addresses of the differing variables
+   */
+  static std::vector<uint32_t> diff(const Checkpoint& a, const Checkpoint& b);
+
+  /**
+   * @brief Exports the memory as JSON for debugging.
+   *
+   * Every address is saved as a chunk holding the list of its values. This
+   * was the format of BSAVE before the binary snapshot.
+   * @return the memory as JSON
+   */
   nlohmann::json save() const;
 
+  /**
+   * @brief Restores the memory exported by save().
+   * @param j the memory as JSON
+   */
   void restore(const nlohmann::json& j);
 
+  /**
+   * @brief Writes a binary snapshot of the memory.
+   *
+   * The snapshot consists of a header with magic number and version and of
+   * typed sections: the ranges of the variables, a fixed size record per
+   * value and the characters of the strings. Every section carries a
+   * checksum. The records are aligned to 8 bytes, so a snapshot read into
+   * memory is restored without parsing.
+   * @param os the stream to write to
+   */
+  void saveSnapshot(std::ostream& os) const;
+
+  /**
+   * @brief Restores a snapshot written by saveSnapshot().
+   * @param data the snapshot
+   * @param size size of the snapshot in bytes
+   * @throws runtime_error if the snapshot is damaged or of another version
+   */
+  void restoreSnapshot(const char* data, size_t size);
+
+  /**
+   * @brief Checks if data starts with the magic number of a snapshot.
+   * @param data the data
+   * @param size size of the data in bytes
+   * @return true if the data is a snapshot
+   */
+  static bool isSnapshot(const char* data, size_t size);
+
+  /**
+   * @brief Checks if the changes since the last save are known.
+   *
+   * This is false after the memory was reset or restored from a checkpoint
+   * and before the first markSaved().
+   * @return true if saveChanges() may be used
+   */
+  bool canSaveChanges() const;
+
+  /**
+   * @brief Gets the number of pages changed since the last save.
+   * @return number of changed pages
+   */
+  uint32_t getChangeCount() const;
+
+  /**
+   * @brief Writes a snapshot of the values changed since the last save.
+   *
+   * The snapshot has the format of saveSnapshot() with a table of the
+   * changed parts of the variables instead of the ranges, so its size and
+   * the time to write it depend on the changes only. restoreSnapshot()
+   * applies it to the state of the last save. The memory is marked as saved
+   * afterwards.
+   * @param os the stream to write to
+   */
+  void saveChanges(std::ostream& os);
+
+  /**
+   * @brief Marks the current state as saved and starts tracking changes.
+   */
+  void markSaved();
+
+private:
+  /* range of the values of a variable */
+  struct Extent
+  {
+    uint32_t start;
+    uint32_t size;
+  };
+
+  struct Page
+  {
+    Value values[MEMORY_PAGE_SIZE];
+  };
+
+  const Value& read(uint32_t index) const;
+  Value& write(uint32_t index);
+  Value* writePage(uint32_t index);
+  void fill(uint32_t index, uint32_t n, const Value& v);
+  Value& at(uint32_t addr, int32_t offset);
+  std::vector<Extent>& writeExtents();
+  std::map<uint32_t,uint32_t>& writeArrays();
+  void grow(uint32_t n);
+  void compact();
+  void assign(std::vector<Value>&& v, std::vector<Extent>&& e);
+  void detach();
+  void indexArrays();
+
+  std::shared_ptr<std::vector<Value>> slotStorage;  /* one value per address */
+  Value* slotValues;                                /* the values of slots */
+  uint32_t slotCount;                               /* the number of slots */
+  std::vector<std::shared_ptr<Page>> pages;         /* indexed like all values; null where they hold slots only */
+  std::shared_ptr<std::vector<Extent>> extents;
+  std::shared_ptr<std::map<uint32_t,uint32_t>> arrays;  /* start of the non-empty moved arrays -> address */
+  uint32_t count;  /* number of values: one slot per address followed by the moved arrays */
+  uint32_t garbage;  /* values behind the slots which belong to no variable */
+  uint32_t generation;
+  std::vector<uint8_t> dirty;     /* per page: written since the last save */
+  std::vector<uint32_t> changes;  /* the pages marked in dirty */
+  std::vector<uint32_t> resized;  /* addresses resized since the last save */
+  bool tracked;                   /* the changes refer to a saved state */
+};
+
+/**
+ * @brief A state of the memory, which shares the pages with the memory.
+ *
+ * Like the memory, a checkpoint refers to the strings of the string heap,
+ * whose reference counts are not atomic, and to the pinned string
+ * constants of the executable. Hence it is restored only on the thread it
+ * was taken on, which Memory::restore() checks, and only while the
+ * executable is loaded.
+ */
+class Memory::Checkpoint
+{
+public:
+  Checkpoint();
+
 private:
-  std::vector<Chunk> mem;
+  friend class Memory;
+
+  const Value* find(uint32_t index) const;
+
+  std::shared_ptr<std::vector<Value>> slotStorage;
+  std::vector<std::shared_ptr<Page>> pages;
+  std::shared_ptr<std::vector<Extent>> extents;
+  std::shared_ptr<std::map<uint32_t,uint32_t>> arrays;
+  uint32_t count;
+  uint32_t garbage;
+  StringHeap* heap;       /* current heap when the checkpoint was taken */
+  std::thread::id thread; /* thread which took the checkpoint */
 };
 
+inline const Value& Memory::read(uint32_t index) const
+{
+  if (index < slotCount) return slotValues[index];
+  return pages[index / MEMORY_PAGE_SIZE]->values[index % MEMORY_PAGE_SIZE];
+}
+
+inline Value& Memory::write(uint32_t index)
+{
+  return *writePage(index);
+}
+
+/*
+ * Only the page of the index is marked as changed, so the values from index
+ * to the end of that page, but not beyond the last slot for a slot, may be
+ * written through the pointer.
+ */
+inline Value* Memory::writePage(uint32_t index)
+{
+  uint32_t page = index / MEMORY_PAGE_SIZE;
+  if (!dirty[page])
+  {
+    dirty[page] = 1;
+    changes.push_back(page);
+  }
+  if (index < slotCount)
+  {
+    if (slotStorage.use_count() > 1)
+    {
+      slotStorage = std::make_shared<std::vector<Value>>(*slotStorage); /* copy on write */
+      slotValues = slotStorage->data();
+      generation++; /* pointers into the shared slots are stale */
+    }
+    return slotValues + index;
+  }
+  std::shared_ptr<Page>& p = pages[page];
+  if (p.use_count() > 1)
+  {
+    p = std::make_shared<Page>(*p); /* copy on write */
+    generation++; /* pointers into the shared page are stale */
+  }
+  return &p->values[index % MEMORY_PAGE_SIZE];
+}
+
+inline Value& Memory::at(uint32_t addr, int32_t offset)
+{
+  return write((*extents)[addr].start + offset);
+}
+
+inline const Value& Memory::getValue(uint32_t addr, int32_t offset) const
+{
+  return read((*extents)[addr].start + offset);
+}
+
+inline const Value& Memory::getScalarValue(uint32_t addr) const
+{
+  return slotValues[addr];
+}
+
+inline Value* Memory::getScalar(uint32_t addr)
+{
+  return writePage(addr);
+}
+
+inline void Memory::store(int32_t v, uint32_t addr, int32_t offset)
+{
+  at(addr,offset).set(v);
+}
+
+inline void Memory::store(double v, uint32_t addr, int32_t offset)
+{
+  at(addr,offset).set(v);
+}
+
+inline void Memory::store(const Value& v, uint32_t addr, int32_t offset)
+{
+  at(addr,offset) = v;
+}
+
+inline void Memory::store(Value&& v, uint32_t addr, int32_t offset)
+{
+  at(addr,offset) = std::move(v);
+}
+
 
 
 
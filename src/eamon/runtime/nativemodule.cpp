@@ -0,0 +1,204 @@
+/********************************************************************************
+ *                                                                              *
+ * EamonInterpreter - native module                                             *
+ *                                                                              *
+ * modified: 2026-10-16                                                         *
+ *                                                                              *
+ ********************************************************************************
+ * Copyright (C) Harald Braeuning                                               *
+ ********************************************************************************
+ * This file is part of EamonInterpreter.                                       *
+ * EamonInterpreter is free software: you can redistribute it and/or modify it  *
+ * under the terms of the GNU General Public License as published by the Free   *
+ * Software Foundation, either version 3 of the License, or (at your option)    *
+ * any later version.                                                           *
+ * EamonInterpreter is distributed in the hope that it will be useful, but      *
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY   *
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for  *
+ * more details.                                                                *
+ * You should have received a copy of the GNU General Public License along with *
+ * EamonInterpreter. If not, see <https://www.gnu.org/licenses/>.               *
+ ********************************************************************************/
+
+
+#include "nativemodule.h"
+#include "transpiler.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+#if defined(__unix__) || defined(__APPLE__)
+#define NATIVE_MODULES
+#include <dlfcn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+
+
+bool NativeModule::Build::isFinished() const
+{
+  return finished;
+}
+
+std::shared_ptr<NativeModule> NativeModule::Build::getModule() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return module;
+}
+
+void NativeModule::Build::cancel()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  notify = nullptr;
+}
+
+
+
+NativeModule::NativeModule():
+  handle(nullptr),
+  runFunction(nullptr)
+{
+}
+
+NativeModule::~NativeModule()
+{
+#ifdef NATIVE_MODULES
+  if (handle != nullptr) dlclose(handle);
+#endif
+}
+
+bool NativeModule::isAvailable()
+{
+#ifdef NATIVE_MODULES
+  return true;
+#else
+  return false;
+#endif
+}
+
+/*
+ * FNV-1a over the complete executable image and the ABI version.
+ */
+std::string NativeModule::getHash(Executable* x)
+{
+  char* buffer;
+  uint32_t size;
+  x->save(&buffer,&size);
+  uint64_t h = 14695981039346656037ULL;
+  for (uint32_t i=0;i<size;i++)
+  {
+    h ^= static_cast<uint8_t>(buffer[i]);
+    h *= 1099511628211ULL;
+  }
+  free(buffer);
+  h ^= NATIVE_MODULE_ABI;
+  h *= 1099511628211ULL;
+  std::ostringstream s;
+  s << std::hex << std::setw(16) << std::setfill('0') << h;
+  return s.str();
+}
+
+std::shared_ptr<NativeModule> NativeModule::load(const std::string& filename, const std::string& hash)
+{
+#ifdef NATIVE_MODULES
+  void* handle = dlopen(filename.c_str(),RTLD_NOW|RTLD_LOCAL);
+  if (handle == nullptr) return nullptr;
+  std::shared_ptr<NativeModule> module(new NativeModule());
+  module->handle = handle;
+  typedef int32_t (*AbiFunction)();
+  typedef const char* (*HashFunction)();
+  AbiFunction abi = reinterpret_cast<AbiFunction>(dlsym(handle,"eamon_module_abi"));
+  HashFunction moduleHash = reinterpret_cast<HashFunction>(dlsym(handle,"eamon_module_hash"));
+  module->runFunction = reinterpret_cast<RunFunction>(dlsym(handle,"eamon_module_run"));
+  if (abi == nullptr || moduleHash == nullptr || module->runFunction == nullptr) return nullptr;
+  if (abi() != NATIVE_MODULE_ABI || hash != moduleHash()) return nullptr;
+  return module;
+#else
+  (void)filename;
+  (void)hash;
+  return nullptr;
+#endif
+}
+
+std::shared_ptr<NativeModule> NativeModule::find(Executable* x, const std::string& directory)
+{
+  std::string hash = getHash(x);
+  return load(directory + "/" + hash + ".so",hash);
+}
+
+std::shared_ptr<NativeModule::Build> NativeModule::build(Executable* x, const std::string& directory, std::function<void()> finished)
+{
+#ifdef NATIVE_MODULES
+  static std::atomic<uint32_t> counter(0);
+  std::string hash = getHash(x);
+  std::string base = directory + "/" + hash;
+  /* build under names of its own, so that a failed or concurrent build never leaves a broken module */
+  std::string unique = base + "." + std::to_string(getpid()) + "." + std::to_string(counter++);
+  std::string source = unique + ".cpp";
+  std::ofstream os(source);
+  if (!os.is_open()) return nullptr;
+  Transpiler transpiler(os);
+  transpiler.transpile(x,hash);
+  os.close();
+  std::shared_ptr<Build> b = std::make_shared<Build>();
+  b->notify = finished;
+  std::thread([b,base,unique,source,hash]() {
+    std::string tmp = unique + ".so";
+    std::shared_ptr<NativeModule> module;
+    bool ok = compile(source,tmp);
+    std::remove(source.c_str());
+    if (ok && std::rename(tmp.c_str(),(base + ".so").c_str()) == 0)
+      module = load(base + ".so",hash);
+    else
+      std::remove(tmp.c_str());
+    std::lock_guard<std::mutex> lock(b->mutex);
+    b->module = module;
+    b->finished = true;
+    if (b->notify) b->notify();
+  }).detach();
+  return b;
+#else
+  (void)x;
+  (void)directory;
+  (void)finished;
+  return nullptr;
+#endif
+}
+
+/*
+ * The compiler is started directly, without a shell, so the paths need no
+ * quoting.
+ */
+bool NativeModule::compile(const std::string& source, const std::string& target)
+{
+#ifdef NATIVE_MODULES
+  const char* argv[] = { "g++", "-std=c++17", "-O1", "-shared", "-fPIC", "-o", target.c_str(), source.c_str(), nullptr };
+  pid_t pid = fork();
+  if (pid < 0) return false;
+  if (pid == 0)
+  {
+    execvp(argv[0],const_cast<char* const*>(argv));
+    _exit(127);
+  }
+  int status;
+  while (waitpid(pid,&status,0) < 0)
+  {
+    if (errno != EINTR) return false;
+  }
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+#else
+  (void)source;
+  (void)target;
+  return false;
+#endif
+}
+
+int32_t NativeModule::run(void* vm, const Function* api, int32_t start) const
+{
+  return runFunction(vm,api,start);
+}
@@ -0,0 +1,184 @@
+/********************************************************************************
+ *                                                                              *
+ * EamonInterpreter - native module                                             *
+ *                                                                              *
+ * modified: 2026-10-16                                                         *
+ *                                                                              *
+ ********************************************************************************
+ * Copyright (C) Harald Braeuning                                               *
+ ********************************************************************************
+ * This file is part of EamonInterpreter.                                       *
+ * EamonInterpreter is free software: you can redistribute it and/or modify it  *
+ * under the terms of the GNU General Public License as published by the Free   *
+ * Software Foundation, either version 3 of the License, or (at your option)    *
+ * any later version.                                                           *
+ * EamonInterpreter is distributed in the hope that it will be useful, but      *
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY   *
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for  *
+ * more details.                                                                *
+ * You should have received a copy of the GNU General Public License along with *
+ * EamonInterpreter. If not, see <https://www.gnu.org/licenses/>.               *
+ ********************************************************************************/
+
+
+#ifndef NATIVEMODULE_H
+#define NATIVEMODULE_H
+
+#include "executable.h"
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+/* version of the interface between the virtual machine and a native module */
+#define NATIVE_MODULE_ABI 2
+
+
+
+/**
+ * @brief The NativeModule class is a program compiled ahead of time into a
+ * shared library.
+ *
+ * The Transpiler translates the code of an executable into C++, which is
+ * compiled with the system compiler. The module runs the control flow of the
+ * program natively and calls back into the virtual machine through a table
+ * of functions for everything else. Every module carries the hash of the
+ * executable it was created from and is only used for that executable.
+ */
+class NativeModule
+{
+public:
+  /**
+   * @brief A function of the virtual machine called by the module.
+   * @param vm the virtual machine
+   * @param index index of the decoded instruction or an integer argument
+   * @return depends on the function
+   */
+  typedef int32_t (*Function)(void* vm, int32_t index);
+
+  /**
+   * @brief The slots of the function table passed to the module.
+   */
+  enum Api {
+    Execute,     /**< executes any instruction; returns the index of the next instruction or -1 */
+    Push,        /**< OP_PUSH */
+    Recall,      /**< OP_RCL */
+    Store,       /**< OP_STO */
+    Arithmetic,  /**< generic and type specialized arithmetic */
+    Compare,     /**< generic and type specialized comparison */
+    Line,        /**< ASM_LINE */
+    PushInt,     /**< pushes the argument */
+    PopInt,      /**< pops an integer */
+    IllegalJump, /**< throws for a jump to an unknown instruction */
+    Safepoint,   /**< returns 1 if a pause was requested */
+    ApiSize
+  };
+
+  /**
+   * @brief A build of a module running in the background.
+   */
+  class Build
+  {
+  public:
+    /**
+     * @brief Get whether the build is done.
+     * @return true if the build succeeded or failed
+     */
+    bool isFinished() const;
+
+    /**
+     * @brief Gets the module built.
+     * @return the module or nullptr if the build is not finished or failed
+     */
+    std::shared_ptr<NativeModule> getModule() const;
+
+    /**
+     * @brief Drops the notification, e.g. if its receiver goes away.
+     *
+     * The build itself runs to the end, so that the module is cached.
+     */
+    void cancel();
+
+  private:
+    friend class NativeModule;
+
+    mutable std::mutex mutex;
+    std::atomic<bool> finished{false};
+    std::shared_ptr<NativeModule> module;
+    std::function<void()> notify;
+  };
+
+  ~NativeModule();
+
+  /**
+   * @brief Get whether native modules are supported on this platform.
+   * @return true if modules can be loaded
+   */
+  static bool isAvailable();
+
+  /**
+   * @brief Calculates the hash identifying an executable.
+   * @param x the executable
+   * @return the hash as hex string
+   */
+  static std::string getHash(Executable* x);
+
+  /**
+   * @brief Loads a module.
+   * @param filename path of the shared library
+   * @param hash the hash of the executable the module must belong to
+   * @return the module or nullptr if it cannot be loaded or is stale
+   */
+  static std::shared_ptr<NativeModule> load(const std::string& filename, const std::string& hash);
+
+  /**
+   * @brief Gets the module of an executable from a directory.
+   *
+   * The module is named after the hash of the executable.
+   * @param x the executable
+   * @param directory the module directory
+   * @return the module or nullptr if the directory does not contain it
+   */
+  static std::shared_ptr<NativeModule> find(Executable* x, const std::string& directory);
+
+  /**
+   * @brief Builds the module of an executable in a directory.
+   *
+   * The executable is transpiled right away; the system g++ compiles the
+   * source in a thread of its own. When done, the module is stored in the
+   * directory, so that find() gets it next time, and finished is called from
+   * the thread of the build. A build cut short by the end of the process
+   * leaves its temporary files in the directory.
+   * @param x the executable
+   * @param directory the module directory
+   * @param finished called when the build succeeded or failed
+   * @return the build or nullptr if the source cannot be written
+   */
+  static std::shared_ptr<Build> build(Executable* x, const std::string& directory, std::function<void()> finished);
+
+  /**
+   * @brief Runs the program.
+   * @param vm the virtual machine
+   * @param api the function table, indexed by Api
+   * @param start index of the decoded instruction to start with
+   * @return index of the decoded instruction to continue with or -1 if the
+   * program terminated
+   */
+  int32_t run(void* vm, const Function* api, int32_t start) const;
+
+private:
+  typedef int32_t (*RunFunction)(void* vm, const Function* api, int32_t start);
+
+  NativeModule();
+
+  static bool compile(const std::string& source, const std::string& target);
+
+  void* handle;
+  RunFunction runFunction;
+};
+
+
+
+#endif // NATIVEMODULE_H
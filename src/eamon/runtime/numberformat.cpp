@@ -0,0 +1,218 @@
+/********************************************************************************
+ *                                                                              *
+ * EamonInterpreter - number format                                             *
+ *                                                                              *
+ * modified: 2026-10-16                                                         *
+ *                                                                              *
+ ********************************************************************************
+ * Copyright (C) Harald Braeuning                                               *
+ ********************************************************************************
+ * This file is part of EamonInterpreter.                                       *
+ * EamonInterpreter is free software: you can redistribute it and/or modify it  *
+ * under the terms of the GNU General Public License as published by the Free   *
+ * Software Foundation, either version 3 of the License, or (at your option)    *
+ * any later version.                                                           *
+ * EamonInterpreter is distributed in the hope that it will be useful, but      *
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY   *
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for  *
+ * more details.                                                                *
+ * You should have received a copy of the GNU General Public License along with *
+ * EamonInterpreter. If not, see <https://www.gnu.org/licenses/>.               *
+ ********************************************************************************/
+
+
+#include "numberformat.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+/* an entry of the cache of formatted integers; empty if length is 0 */
+struct CachedInteger
+{
+  int32_t value;
+  uint32_t length;
+  char text[12];
+};
+
+static thread_local CachedInteger integerCache[NUMBERFORMAT_CACHE_SIZE];
+
+static inline bool isDigit(char c)
+{
+  return c >= '0' && c <= '9';
+}
+
+static inline bool isNumberChar(char c)
+{
+  return isDigit(c) || c == '.' || c == 'E' || c == 'e' || c == '+' || c == '-';
+}
+
+
+
+uint32_t NumberFormat::format(int32_t v, char* buffer)
+{
+  CachedInteger& c = integerCache[static_cast<uint32_t>(v) & (NUMBERFORMAT_CACHE_SIZE-1)];
+  if (c.length == 0 || c.value != v)
+  {
+    c.value = v;
+    c.length = static_cast<uint32_t>(std::to_chars(c.text,c.text+sizeof(c.text),v).ptr-c.text);
+  }
+  memcpy(buffer,c.text,c.length);
+  return c.length;
+}
+
+uint32_t NumberFormat::format(double v, char* buffer)
+{
+  if (v == 0) /* also -0 */
+  {
+    buffer[0] = '0';
+    return 1;
+  }
+  if (!std::isfinite(v))
+  {
+    return static_cast<uint32_t>(std::to_chars(buffer,buffer+NUMBERFORMAT_BUFFER_SIZE,v).ptr-buffer);
+  }
+  if (std::fabs(v) < 1e9 && v == std::trunc(v))
+  {
+    return static_cast<uint32_t>(std::to_chars(buffer,buffer+NUMBERFORMAT_BUFFER_SIZE,static_cast<int64_t>(v)).ptr-buffer);
+  }
+  /* d.dddddddde+xx yields the rounded digits and the decimal exponent */
+  char tmp[NUMBERFORMAT_BUFFER_SIZE+8];
+  char* end = std::to_chars(tmp,tmp+sizeof(tmp),std::fabs(v),std::chars_format::scientific,NUMBERFORMAT_DIGITS-1).ptr;
+  char digits[NUMBERFORMAT_DIGITS];
+  int32_t n = 0;
+  const char* p = tmp;
+  while (*p != 'e')
+  {
+    if (*p != '.') digits[n++] = *p;
+    p++;
+  }
+  p++;
+  bool negativeExponent = *p++ == '-';
+  int32_t exponent = 0;
+  std::from_chars(p,end,exponent);
+  if (negativeExponent) exponent = -exponent;
+  while (n > 1 && digits[n-1] == '0') n--;
+
+  char* out = buffer;
+  if (v < 0) *out++ = '-';
+  if (exponent >= -2 && exponent < NUMBERFORMAT_DIGITS)
+  {
+    if (exponent < 0)
+    {
+      *out++ = '.';
+      for (int32_t i=exponent+1;i<0;i++) *out++ = '0';
+      memcpy(out,digits,n);
+      out += n;
+    }
+    else
+    {
+      for (int32_t i=0;i<=exponent;i++) *out++ = i < n ? digits[i] : '0';
+      if (n > exponent+1)
+      {
+        *out++ = '.';
+        memcpy(out,digits+exponent+1,n-exponent-1);
+        out += n - exponent - 1;
+      }
+    }
+  }
+  else
+  {
+    *out++ = digits[0];
+    if (n > 1)
+    {
+      *out++ = '.';
+      memcpy(out,digits+1,n-1);
+      out += n - 1;
+    }
+    *out++ = 'E';
+    *out++ = exponent < 0 ? '-' : '+';
+    if (std::abs(exponent) < 10) *out++ = '0';
+    out = std::to_chars(out,buffer+NUMBERFORMAT_BUFFER_SIZE,std::abs(exponent)).ptr;
+  }
+  return static_cast<uint32_t>(out-buffer);
+}
+
+void NumberFormat::append(std::string& s, int32_t v)
+{
+  char buffer[NUMBERFORMAT_BUFFER_SIZE];
+  s.append(buffer,format(v,buffer));
+}
+
+void NumberFormat::append(std::string& s, double v)
+{
+  char buffer[NUMBERFORMAT_BUFFER_SIZE];
+  s.append(buffer,format(v,buffer));
+}
+
+std::string NumberFormat::toString(int32_t v)
+{
+  char buffer[NUMBERFORMAT_BUFFER_SIZE];
+  return std::string(buffer,format(v,buffer));
+}
+
+std::string NumberFormat::toString(double v)
+{
+  char buffer[NUMBERFORMAT_BUFFER_SIZE];
+  return std::string(buffer,format(v,buffer));
+}
+
+double NumberFormat::scan(const char* s, uint32_t length)
+{
+  const char* end = s + length;
+  while (s < end && *s == ' ') s++;
+  bool negative = false;
+  if (s < end && (*s == '-' || *s == '+'))
+  {
+    negative = *s == '-';
+    s++;
+  }
+  /* Applesoft ignores blanks in a number; only then the number is copied */
+  const char* last = s;
+  bool blanks = false;
+  while (last < end && (isNumberChar(*last) || *last == ' '))
+  {
+    blanks |= *last == ' ';
+    last++;
+  }
+  char buffer[NUMBERFORMAT_SCAN_SIZE];
+  if (blanks)
+  {
+    uint32_t n = 0;
+    for (const char* p=s;p<last && n<sizeof(buffer);p++)
+    {
+      if (*p != ' ') buffer[n++] = *p;
+    }
+    s = buffer;
+    last = buffer + n;
+  }
+  /* from_chars would also accept inf and nan */
+  if (s == last || !(isDigit(*s) || (*s == '.' && s+1 < last && isDigit(s[1])))) return 0;
+  double v = 0;
+  auto r = std::from_chars(s,last,v);
+  if (r.ec == std::errc::result_out_of_range)
+  {
+    const char* e = std::find_if(s,r.ptr,[](char c){ return c == 'E' || c == 'e'; });
+    v = (e+1 < r.ptr && e[1] == '-') ? 0 : HUGE_VAL;
+  }
+  return negative ? -v : v;
+}
+
+double NumberFormat::scan(const std::string& s)
+{
+  return scan(s.data(),static_cast<uint32_t>(s.size()));
+}
+
+int32_t NumberFormat::scanInt(const char* s, uint32_t length)
+{
+  double v = scan(s,length);
+  if (v >= std::numeric_limits<int32_t>::max()) return std::numeric_limits<int32_t>::max();
+  if (v <= std::numeric_limits<int32_t>::min()) return std::numeric_limits<int32_t>::min();
+  return static_cast<int32_t>(v);
+}
+
+int32_t NumberFormat::scanInt(const std::string& s)
+{
+  return scanInt(s.data(),static_cast<uint32_t>(s.size()));
+}
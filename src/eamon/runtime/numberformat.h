@@ -0,0 +1,120 @@
+/********************************************************************************
+ *                                                                              *
+ * EamonInterpreter - number format                                             *
+ *                                                                              *
+ * modified: 2026-10-16                                                         *
+ *                                                                              *
+ ********************************************************************************
+ * Copyright (C) Harald Braeuning                                               *
+ ********************************************************************************
+ * This file is part of EamonInterpreter.                                       *
+ * EamonInterpreter is free software: you can redistribute it and/or modify it  *
+ * under the terms of the GNU General Public License as published by the Free   *
+ * Software Foundation, either version 3 of the License, or (at your option)    *
+ * any later version.                                                           *
+ * EamonInterpreter is distributed in the hope that it will be useful, but      *
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY   *
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for  *
+ * more details.                                                                *
+ * You should have received a copy of the GNU General Public License along with *
+ * EamonInterpreter. If not, see <https://www.gnu.org/licenses/>.               *
+ ********************************************************************************/
+
+
+#ifndef NUMBERFORMAT_H
+#define NUMBERFORMAT_H
+
+#include <stdint.h>
+#include <string>
+
+/* size of a buffer which holds any formatted number */
+#define NUMBERFORMAT_BUFFER_SIZE 24
+/* significant digits of a formatted floating point number */
+#define NUMBERFORMAT_DIGITS 9
+/* number of recently formatted integers kept per thread; a power of 2 */
+#define NUMBERFORMAT_CACHE_SIZE 256
+/* longest number with blanks which is scanned */
+#define NUMBERFORMAT_SCAN_SIZE 64
+
+
+
+/**
+ * @brief Formats and scans numbers like Applesoft BASIC does.
+ *
+ * Floating point numbers are rounded to 9 significant digits and trailing
+ * zeros are dropped. Numbers from 0.01 up to 999999999 are written as fixed
+ * point numbers without a leading zero (.5, -.25), all others with an
+ * exponent of at least two digits (1E+09, 1.5E-03).
+ *
+ * The formatter writes into a buffer supplied by the caller and never
+ * allocates memory. Integers are mostly small values like counters and
+ * indices, so the texts of recently formatted integers are cached.
+ *
+ * The scanner reads the longest leading part of a text which is a number,
+ * like VAL does. Leading blanks and blanks within the number are ignored.
+ * A text without a number yields 0, so scanning never throws. Neither
+ * formatting nor scanning depends on the locale.
+ */
+class NumberFormat
+{
+public:
+
+  /**
+   * @brief Formats an integer.
+   * @param v the value
+   * @param buffer buffer of at least NUMBERFORMAT_BUFFER_SIZE characters
+   * @return number of characters written; the text is not zero terminated
+   */
+  static uint32_t format(int32_t v, char* buffer);
+
+  /**
+   * @brief Formats a floating point number.
+   * @param v the value
+   * @param buffer buffer of at least NUMBERFORMAT_BUFFER_SIZE characters
+   * @return number of characters written; the text is not zero terminated
+   */
+  static uint32_t format(double v, char* buffer);
+
+  /**
+   * @brief Appends a formatted integer to a string.
+   * @param s the string
+   * @param v the value
+   */
+  static void append(std::string& s, int32_t v);
+
+  /**
+   * @brief Appends a formatted floating point number to a string.
+   * @param s the string
+   * @param v the value
+   */
+  static void append(std::string& s, double v);
+
+  static std::string toString(int32_t v);
+
+  static std::string toString(double v);
+
+  /**
+   * @brief Scans a number at the beginning of a text.
+   * @param s the text; may be nullptr if length is 0
+   * @param length number of characters of the text
+   * @return the number or 0 if the text does not start with a number
+   */
+  static double scan(const char* s, uint32_t length);
+
+  static double scan(const std::string& s);
+
+  /**
+   * @brief Scans a number and truncates it to an integer.
+   *
+   * Numbers out of the range of an int32 are clamped.
+   * @param s the text; may be nullptr if length is 0
+   * @param length number of characters of the text
+   * @return the integer or 0 if the text does not start with a number
+   */
+  static int32_t scanInt(const char* s, uint32_t length);
+
+  static int32_t scanInt(const std::string& s);
+
+};
+
+#endif // NUMBERFORMAT_H
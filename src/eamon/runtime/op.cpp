@@ -124,6 +124,16 @@ const std::vector<Value>& COp::getParameterArray() const
   return a;
 }
 
+void COp::addOperand(int32_t v)
+{
+  operands.push_back(v);
+}
+
+const std::vector<int32_t>& COp::getOperands() const
+{
+  return operands;
+}
+
 
 /** Return true if op codes are equal */
 int COp::operator==(int32_t n)
@@ -54,6 +54,12 @@
 #define OP_DUP        8
 /* swap the two values on top of the stack */
 #define OP_SWAP       9
+/* store value from stack in 2-D array variable by the two indices below it;
+ * operands: address of the first dimension, stride (0: read the dimension) */
+#define OP_STOI2     10
+/* recall value from 2-D array variable by the two indices on top of the stack
+ * and push it; operands like OP_STOI2 */
+#define OP_RCLI2     11
 #define OP_ARIADD    16
 #define OP_ARISUB    17
 #define OP_ARIMUL    18
@@ -74,15 +80,41 @@
 #define OP_ARINOT    33
 #define OP_OR        34 /* logic or */
 #define OP_AND       35 /* logic and */
+/* Type specialized arithmetic emitted if the compiler knows the operand
+ * types. The VM falls back to the generic operation if the values on the
+ * stack do not have the expected types. */
+#define OP_ADDI      36 /* int32 + int32 */
+#define OP_SUBI      37 /* int32 - int32 */
+#define OP_MULI      38 /* int32 * int32 */
+#define OP_DIVI      39 /* int32 / int32 */
+#define OP_ADDD      40 /* numbers, at least one double */
+#define OP_SUBD      41
+#define OP_MULD      42
+#define OP_DIVD      43
+#define OP_CONCAT    44 /* string + string */
+#define OP_APPEND    45 /* append the string on the stack to a string variable in place */
 #define OP_JSR       48 /* push the next addess on the stack and jump to an address */
 #define OP_RET       49 /* pop the next address from the stack and jump to it */
 #define OP_JZ        50
 #define OP_JUMP      51
 #define OP_JNZ       52
 #define OP_CALL      55 /* library call */
+/* Type specialized comparison of two numbers (int32 or double) */
+#define OP_EQN       56
+#define OP_NEN       57
+#define OP_LEN       58
+#define OP_GEN       59
+#define OP_LTN       60
+#define OP_GTN       61
 #define OP_RSZ       64
 #define OP_CLR       65
 #define OP_ERRHDL    66
+/* Superinstructions: fused sequences of the most frequently executed op
+ * codes. They are created by the peephole pass of the assembler and take
+ * all their operands from global variables. */
+#define OP_NEXT      68 /* end of a FOR loop: label, variable, step, limit, sub ops */
+#define OP_ARISTO    69 /* c = a op b: destination, a, b, sub op */
+#define OP_CMPJZ     70 /* jump if not (a op k): label, a, int32 constant k, sub op */
 #define OP_END      127
 
 /* Meta codes */
@@ -143,6 +175,20 @@ class COp {
 
   const std::vector<Value>& getParameterArray() const;
 
+  /**
+   * @brief Adds an operand word which is written after the parameter.
+   *
+   * Used by the superinstructions which need more than one operand.
+   * @param v the operand
+   */
+  void addOperand(int32_t v);
+
+  /**
+   * @brief Gets the additional operand words.
+   * @return the operands in the order they were added
+   */
+  const std::vector<int32_t>& getOperands() const;
+
   /** Return true if op codes are equal */
   int operator==(int32_t n);
   /** Return true if op codes are not equal */
@@ -173,6 +219,7 @@ class COp {
   };
   std::string s;
   std::vector<Value> a;
+  std::vector<int32_t> operands;
 };
 
 /** @brief Code block
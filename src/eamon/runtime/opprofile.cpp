@@ -0,0 +1,105 @@
+/********************************************************************************
+ *                                                                              *
+ * EamonInterpreter - op code profile                                           *
+ *                                                                              *
+ * modified: 2026-10-16                                                         *
+ *                                                                              *
+ ********************************************************************************
+ * Copyright (C) Harald Braeuning                                               *
+ ********************************************************************************
+ * This file is part of EamonInterpreter.                                       *
+ * EamonInterpreter is free software: you can redistribute it and/or modify it  *
+ * under the terms of the GNU General Public License as published by the Free   *
+ * Software Foundation, either version 3 of the License, or (at your option)    *
+ * any later version.                                                           *
+ * EamonInterpreter is distributed in the hope that it will be useful, but      *
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY   *
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for  *
+ * more details.                                                                *
+ * You should have received a copy of the GNU General Public License along with *
+ * EamonInterpreter. If not, see <https://www.gnu.org/licenses/>.               *
+ ********************************************************************************/
+
+#include "opprofile.h"
+#include "disassembler.h"
+#include <algorithm>
+#include <iomanip>
+
+
+
+static const uint32_t numOps = 256;
+
+OpProfile::OpProfile():
+  pairs(numOps*numOps,0),
+  allocations(numOps,0),
+  total(0)
+{
+}
+
+void OpProfile::clear()
+{
+  std::fill(pairs.begin(),pairs.end(),0);
+  std::fill(allocations.begin(),allocations.end(),0);
+  total = 0;
+}
+
+void OpProfile::count(uint32_t previous, uint32_t op)
+{
+  pairs[(previous & 0xFF) * numOps + (op & 0xFF)]++;
+  total++;
+}
+
+uint64_t OpProfile::getCount(uint32_t previous, uint32_t op) const
+{
+  return pairs[(previous & 0xFF) * numOps + (op & 0xFF)];
+}
+
+uint64_t OpProfile::getTotal() const
+{
+  return total;
+}
+
+void OpProfile::countAllocations(uint32_t op, uint64_t n)
+{
+  allocations[op & 0xFF] += n;
+}
+
+uint64_t OpProfile::getAllocations(uint32_t op) const
+{
+  return allocations[op & 0xFF];
+}
+
+void OpProfile::save(std::ostream& os) const
+{
+  std::vector<uint32_t> order;
+  for (uint32_t i=0;i<pairs.size();i++)
+  {
+    if (pairs[i] > 0) order.push_back(i);
+  }
+  std::sort(order.begin(),order.end(),[this](uint32_t a, uint32_t b){ return pairs[a] > pairs[b]; });
+  os << "count;percent;first;second" << std::endl;
+  for (uint32_t i : order)
+  {
+    double percent = total > 0 ? 100.0 * pairs[i] / total : 0;
+    os << pairs[i] << ";" << std::fixed << std::setprecision(3) << percent << ";"
+       << Disassembler::getMnemonicName(i / numOps) << ";" << Disassembler::getMnemonicName(i % numOps) << std::endl;
+  }
+}
+
+void OpProfile::saveAllocations(std::ostream& os) const
+{
+  std::vector<uint64_t> executions(numOps,0);
+  for (uint32_t i=0;i<pairs.size();i++) executions[i % numOps] += pairs[i];
+  std::vector<uint32_t> order;
+  for (uint32_t op=0;op<numOps;op++)
+  {
+    if (executions[op] > 0) order.push_back(op);
+  }
+  std::stable_sort(order.begin(),order.end(),[this](uint32_t a, uint32_t b){ return allocations[a] > allocations[b]; });
+  os << "op;executions;allocations;per execution" << std::endl;
+  for (uint32_t op : order)
+  {
+    os << Disassembler::getMnemonicName(op) << ";" << executions[op] << ";" << allocations[op] << ";"
+       << std::fixed << std::setprecision(3) << static_cast<double>(allocations[op]) / executions[op] << std::endl;
+  }
+}
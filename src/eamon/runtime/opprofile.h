@@ -0,0 +1,111 @@
+/********************************************************************************
+ *                                                                              *
+ * EamonInterpreter - op code profile                                           *
+ *                                                                              *
+ * modified: 2026-10-16                                                         *
+ *                                                                              *
+ ********************************************************************************
+ * Copyright (C) Harald Braeuning                                               *
+ ********************************************************************************
+ * This file is part of EamonInterpreter.                                       *
+ * EamonInterpreter is free software: you can redistribute it and/or modify it  *
+ * under the terms of the GNU General Public License as published by the Free   *
+ * Software Foundation, either version 3 of the License, or (at your option)    *
+ * any later version.                                                           *
+ * EamonInterpreter is distributed in the hope that it will be useful, but      *
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY   *
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for  *
+ * more details.                                                                *
+ * You should have received a copy of the GNU General Public License along with *
+ * EamonInterpreter. If not, see <https://www.gnu.org/licenses/>.               *
+ ********************************************************************************/
+
+#ifndef OPPROFILE_H
+#define OPPROFILE_H
+
+#include <stdint.h>
+#include <ostream>
+#include <vector>
+
+
+
+/**
+ * @brief The OpProfile class collects a histogram of executed op code pairs.
+ *
+ * The virtual machine counts each op code together with the op code executed
+ * before it. The histogram shows which sequences are worth to be fused into
+ * superinstructions. In addition, the strings allocated in the string heap
+ * are counted per op code.
+ */
+class OpProfile
+{
+public:
+  OpProfile();
+
+  /**
+   * @brief Resets all counters.
+   */
+  void clear();
+
+  /**
+   * @brief Counts the execution of an op code following another one.
+   * @param previous mnemonic of the previously executed op code
+   * @param op mnemonic of the executed op code
+   */
+  void count(uint32_t previous, uint32_t op);
+
+  /**
+   * @brief Gets how often op was executed directly after previous.
+   * @param previous mnemonic of the first op code of the pair
+   * @param op mnemonic of the second op code of the pair
+   * @return the number of executions
+   */
+  uint64_t getCount(uint32_t previous, uint32_t op) const;
+
+  /**
+   * @brief Gets the total number of counted op codes.
+   * @return the number of executed op codes
+   */
+  uint64_t getTotal() const;
+
+  /**
+   * @brief Counts the strings allocated by the execution of an op code.
+   * @param op mnemonic of the executed op code
+   * @param n number of allocated strings
+   */
+  void countAllocations(uint32_t op, uint64_t n);
+
+  /**
+   * @brief Gets the number of strings allocated by an op code.
+   * @param op mnemonic of the op code
+   * @return the number of allocations
+   */
+  uint64_t getAllocations(uint32_t op) const;
+
+  /**
+   * @brief Writes the histogram, most frequent pair first.
+   *
+   * Each line holds the count, the share in percent and the two mnemonics
+   * separated by semicolons.
+   * @param os the output stream
+   */
+  void save(std::ostream& os) const;
+
+  /**
+   * @brief Writes the string allocations per op code, most allocations first.
+   *
+   * Each line holds the mnemonic, the number of executions, the number of
+   * allocations and the allocations per execution separated by semicolons.
+   * @param os the output stream
+   */
+  void saveAllocations(std::ostream& os) const;
+
+private:
+  std::vector<uint64_t> pairs;
+  std::vector<uint64_t> allocations;
+  uint64_t total;
+};
+
+
+
+#endif // OPPROFILE_H
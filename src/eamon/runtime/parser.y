@@ -108,15 +108,15 @@ number_assignment:
   SYMBOL EQU expr { compiler.store($1,@1,false,true); }
   | SYMBOL '(' expr ')' { compiler.createArrayOffset($1,1,@1); }
     EQU expr { compiler.store($1,@1,true,true); }
-  | SYMBOL '(' expr ',' expr ')' { compiler.createArrayOffset($1,2,@1); }
+  | SYMBOL '(' expr ',' expr ')' { compiler.createArrayIndices($1,@1); }
     EQU expr { compiler.store($1,@1,true,true); }
   ;
 
 string_assignment:
-    STRINGSYMBOL EQU stringexpr { compiler.store($1,@1,false,true); }
+    STRINGSYMBOL EQU { compiler.startStringAssignment(); } stringexpr { compiler.store($1,@1,false,true); }
     | STRINGSYMBOL '(' expr ')' { compiler.createArrayOffset($1,1,@1); }
       EQU stringexpr { compiler.store($1,@1,true,true); }
-    | STRINGSYMBOL '(' expr ',' expr ')' { compiler.createArrayOffset($1,2,@1); }
+    | STRINGSYMBOL '(' expr ',' expr ')' { compiler.createArrayIndices($1,@1); }
       EQU stringexpr { compiler.store($1,@1,true,true); }
   ;
 
@@ -241,19 +241,19 @@ stringfunction: CHR '(' expr ')' { compiler.callFunction("chr$",1,@1); }
 stringexpr: STRING { compiler.createPush($1); }
   | STRINGSYMBOL { compiler.recall($1,@1,false); }
   | stringarray
-  | stringexpr '+' stringexpr { compiler.createOperator("+",@1); }
+  | stringexpr '+' { compiler.markConcatOperand(); } stringexpr { compiler.createConcat(@1); }
   | stringfunction
   | '(' stringexpr ')'
   ;
 
 array:
   SYMBOL '(' expr ')' { compiler.createArrayOffset($1,1,@1); compiler.recall($1,@1,true); }
-  | SYMBOL '(' expr ',' expr ')' { compiler.createArrayOffset($1,2,@1); compiler.recall($1,@1,true); }
+  | SYMBOL '(' expr ',' expr ')' { compiler.createArrayIndices($1,@1); compiler.recall($1,@1,true); }
   ;
 
 stringarray:
   STRINGSYMBOL '(' expr ')' { compiler.createArrayOffset($1,1,@1); compiler.recall($1,@1,true); }
-  | STRINGSYMBOL '(' expr ',' expr ')' { compiler.createArrayOffset($1,2,@1); compiler.recall($1,@1,true); }
+  | STRINGSYMBOL '(' expr ',' expr ')' { compiler.createArrayIndices($1,@1); compiler.recall($1,@1,true); }
   ;
 
 dim:
@@ -0,0 +1,182 @@
+/********************************************************************************
+ *                                                                              *
+ * EamonInterpreter - peephole optimizer                                        *
+ *                                                                              *
+ * modified: 2026-10-16                                                         *
+ *                                                                              *
+ ********************************************************************************
+ * Copyright (C) Harald Braeuning                                               *
+ ********************************************************************************
+ * This file is part of EamonInterpreter.                                       *
+ * EamonInterpreter is free software: you can redistribute it and/or modify it  *
+ * under the terms of the GNU General Public License as published by the Free   *
+ * Software Foundation, either version 3 of the License, or (at your option)    *
+ * any later version.                                                           *
+ * EamonInterpreter is distributed in the hope that it will be useful, but      *
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY   *
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for  *
+ * more details.                                                                *
+ * You should have received a copy of the GNU General Public License along with *
+ * EamonInterpreter. If not, see <https://www.gnu.org/licenses/>.               *
+ ********************************************************************************/
+
+
+#include "peephole.h"
+#include "address.h"
+
+
+
+Code Peephole::optimize(const Code& code)
+{
+  Code out;
+  out.reserve(code.size());
+  size_t i = 0;
+  while (i < code.size())
+  {
+    size_t n = matchNext(code,i,out);
+    if (n == 0) n = matchAriSto(code,i,out);
+    if (n == 0) n = matchCmpJz(code,i,out);
+    if (n == 0)
+    {
+      out.push_back(code[i]);
+      n = 1;
+    }
+    i += n;
+  }
+  return out;
+}
+
+
+
+/*
+ * NEXT as created by Compiler::endFor:
+ *   rcl v, rcl step, add, dup, sto v, rcl limit, sub, rcl step, mul,
+ *   push 0.0, gt, jz label
+ */
+size_t Peephole::matchNext(const Code& code, size_t i, Code& out)
+{
+  const size_t n = 12;
+  if (!isUnlabeled(code,i,n)) return 0;
+  const COp* op = &code[i];
+  if (!isVariable(op[0],OP_RCL) || !isVariable(op[1],OP_RCL) || !isArithmetic(op[2].getMnemonic())) return 0;
+  if (op[3].getMnemonic() != OP_DUP || !isVariable(op[4],OP_STO)) return 0;
+  if (!isVariable(op[5],OP_RCL) || !isArithmetic(op[6].getMnemonic())) return 0;
+  if (!isVariable(op[7],OP_RCL) || !isArithmetic(op[8].getMnemonic())) return 0;
+  if (op[9].getMnemonic() != OP_PUSH || op[9].getType() != Type::doubleType || op[9].getParameterType() != Type::doubleType || op[9].getParameterDouble() != 0.0) return 0;
+  if (!isComparison(op[10].getMnemonic()) || op[11].getMnemonic() != OP_JZ) return 0;
+  int32_t var = op[0].getParameterInt32();
+  int32_t step = op[1].getParameterInt32();
+  if (op[4].getParameterInt32() != var || op[7].getParameterInt32() != step) return 0;
+  COp next(OP_NEXT,op[4].getType());
+  next.setLabel(op[0].getLabel());
+  next.setParameter(op[11].getParameterInt32());
+  next.addOperand(var);
+  next.addOperand(step);
+  next.addOperand(op[5].getParameterInt32());
+  next.addOperand(op[2].getMnemonic() | (op[6].getMnemonic() << 8) | (op[8].getMnemonic() << 16) | (op[10].getMnemonic() << 24));
+  out.push_back(next);
+  return n;
+}
+
+/*
+ * c = a op b:
+ *   rcl a, rcl b, op, sto c
+ */
+size_t Peephole::matchAriSto(const Code& code, size_t i, Code& out)
+{
+  const size_t n = 4;
+  if (!isUnlabeled(code,i,n)) return 0;
+  const COp* op = &code[i];
+  if (!isVariable(op[0],OP_RCL) || !isVariable(op[1],OP_RCL) || !isArithmetic(op[2].getMnemonic()) || !isVariable(op[3],OP_STO)) return 0;
+  COp aristo(OP_ARISTO,op[3].getType());
+  aristo.setLabel(op[0].getLabel());
+  aristo.setParameter(op[3].getParameterInt32());
+  aristo.addOperand(op[0].getParameterInt32());
+  aristo.addOperand(op[1].getParameterInt32());
+  aristo.addOperand(op[2].getMnemonic());
+  out.push_back(aristo);
+  return n;
+}
+
+/*
+ * IF a op k THEN:
+ *   rcl a, push int32 k, op, jz label
+ */
+size_t Peephole::matchCmpJz(const Code& code, size_t i, Code& out)
+{
+  const size_t n = 4;
+  if (!isUnlabeled(code,i,n)) return 0;
+  const COp* op = &code[i];
+  if (!isVariable(op[0],OP_RCL) || op[1].getMnemonic() != OP_PUSH || op[1].getType() != Type::int32Type || op[1].getParameterType() != Type::int32Type) return 0;
+  if (!isComparison(op[2].getMnemonic()) || op[3].getMnemonic() != OP_JZ) return 0;
+  COp cmpjz(OP_CMPJZ);
+  cmpjz.setLabel(op[0].getLabel());
+  cmpjz.setParameter(op[3].getParameterInt32());
+  cmpjz.addOperand(op[0].getParameterInt32());
+  cmpjz.addOperand(op[1].getParameterInt32());
+  cmpjz.addOperand(op[2].getMnemonic());
+  out.push_back(cmpjz);
+  return n;
+}
+
+
+
+bool Peephole::isVariable(const COp& op, int32_t mnemonic)
+{
+  return op.getMnemonic() == mnemonic && !op.getType().isArrayType()
+      && op.getParameterType() == Type::int32Type
+      && Address::isGlobalAddress(static_cast<uint32_t>(op.getParameterInt32()));
+}
+
+bool Peephole::isUnlabeled(const Code& code, size_t i, size_t n)
+{
+  if (i + n > code.size()) return false;
+  for (size_t k=i+1;k<i+n;k++)
+  {
+    if (code[k].getLabel() > 0) return false;
+  }
+  return true;
+}
+
+bool Peephole::isArithmetic(int32_t mnemonic)
+{
+  switch (mnemonic)
+  {
+    case OP_ARIADD:
+    case OP_ARISUB:
+    case OP_ARIMUL:
+    case OP_ARIDIV:
+    case OP_ADDI:
+    case OP_SUBI:
+    case OP_MULI:
+    case OP_DIVI:
+    case OP_ADDD:
+    case OP_SUBD:
+    case OP_MULD:
+    case OP_DIVD:
+    case OP_CONCAT:
+      return true;
+  }
+  return false;
+}
+
+bool Peephole::isComparison(int32_t mnemonic)
+{
+  switch (mnemonic)
+  {
+    case OP_ARIEQ:
+    case OP_ARINE:
+    case OP_ARILE:
+    case OP_ARIGE:
+    case OP_ARILT:
+    case OP_ARIGT:
+    case OP_EQN:
+    case OP_NEN:
+    case OP_LEN:
+    case OP_GEN:
+    case OP_LTN:
+    case OP_GTN:
+      return true;
+  }
+  return false;
+}
@@ -0,0 +1,70 @@
+/********************************************************************************
+ *                                                                              *
+ * EamonInterpreter - peephole optimizer                                        *
+ *                                                                              *
+ * modified: 2026-10-16                                                         *
+ *                                                                              *
+ ********************************************************************************
+ * Copyright (C) Harald Braeuning                                               *
+ ********************************************************************************
+ * This file is part of EamonInterpreter.                                       *
+ * EamonInterpreter is free software: you can redistribute it and/or modify it  *
+ * under the terms of the GNU General Public License as published by the Free   *
+ * Software Foundation, either version 3 of the License, or (at your option)    *
+ * any later version.                                                           *
+ * EamonInterpreter is distributed in the hope that it will be useful, but      *
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY   *
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for  *
+ * more details.                                                                *
+ * You should have received a copy of the GNU General Public License along with *
+ * EamonInterpreter. If not, see <https://www.gnu.org/licenses/>.               *
+ ********************************************************************************/
+
+
+#ifndef PEEPHOLE_H
+#define PEEPHOLE_H
+
+#include "op.h"
+
+
+
+/**
+ * @brief The Peephole class fuses frequent op code sequences into
+ * superinstructions.
+ *
+ * The sequences were selected from the op code pair histogram (see OpProfile)
+ * of typical adventures:
+ * - the end of a FOR loop (OP_NEXT)
+ * - a binary operation on two variables stored in a variable (OP_ARISTO)
+ * - a comparison of a variable with an integer constant followed by a
+ *   conditional jump (OP_CMPJZ)
+ *
+ * A sequence is only fused if all its operands are global scalar variables
+ * and none of its op codes but the first one is a jump target.
+ */
+class Peephole
+{
+public:
+
+  /**
+   * @brief Fuses the op code sequences of a code block.
+   * @param code the code block
+   * @return the optimized code block
+   */
+  static Code optimize(const Code& code);
+
+private:
+  Peephole();
+
+  static size_t matchNext(const Code& code, size_t i, Code& out);
+  static size_t matchAriSto(const Code& code, size_t i, Code& out);
+  static size_t matchCmpJz(const Code& code, size_t i, Code& out);
+  static bool isVariable(const COp& op, int32_t mnemonic);
+  static bool isUnlabeled(const Code& code, size_t i, size_t n);
+  static bool isArithmetic(int32_t mnemonic);
+  static bool isComparison(int32_t mnemonic);
+};
+
+
+
+#endif // PEEPHOLE_H
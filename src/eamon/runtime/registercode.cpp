@@ -0,0 +1,313 @@
+/********************************************************************************
+ *                                                                              *
+ * EamonInterpreter - register machine code                                     *
+ *                                                                              *
+ * modified: 2026-10-16                                                         *
+ *                                                                              *
+ ********************************************************************************
+ * Copyright (C) Harald Braeuning                                               *
+ ********************************************************************************
+ * This file is part of EamonInterpreter.                                       *
+ * EamonInterpreter is free software: you can redistribute it and/or modify it  *
+ * under the terms of the GNU General Public License as published by the Free   *
+ * Software Foundation, either version 3 of the License, or (at your option)    *
+ * any later version.                                                           *
+ * EamonInterpreter is distributed in the hope that it will be useful, but      *
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY   *
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for  *
+ * more details.                                                                *
+ * You should have received a copy of the GNU General Public License along with *
+ * EamonInterpreter. If not, see <https://www.gnu.org/licenses/>.               *
+ ********************************************************************************/
+
+
+#include "registercode.h"
+#include "op.h"
+#include <stdexcept>
+
+
+
+namespace {
+
+/*
+ * Translation state of a basic block: the values the stack code would have
+ * pushed but which are still held in variables, constants or registers.
+ */
+class Translator
+{
+public:
+  Translator(std::vector<RegisterInstruction>& code):
+    code(code),
+    nextRegister(0),
+    maxRegister(0)
+  {
+  }
+
+  void push(Operand o)
+  {
+    pending.push_back(o);
+  }
+
+  Operand pop()
+  {
+    if (pending.empty()) return Operand{Operand::Stack,0,nullptr};
+    Operand o = pending.back();
+    pending.pop_back();
+    return o;
+  }
+
+  bool hasPending(size_t n=1) const
+  {
+    return pending.size() >= n;
+  }
+
+  Operand& top(size_t n=0)
+  {
+    return pending[pending.size()-1-n];
+  }
+
+  Operand allocateRegister()
+  {
+    Operand o{Operand::Register,nextRegister++,nullptr};
+    if (nextRegister > maxRegister) maxRegister = nextRegister;
+    return o;
+  }
+
+  /* pushes all pending values on the stack */
+  void flush(const Instruction* source)
+  {
+    for (const Operand& o : pending)
+    {
+      RegisterInstruction& ri = emit(ROP_PUSH,source);
+      ri.a = o;
+    }
+    pending.clear();
+    nextRegister = 0;
+  }
+
+  /* moves pending values of a variable to a register before the variable is changed */
+  void protect(uint32_t addr, const Instruction* source)
+  {
+    Operand r{Operand::Stack,0,nullptr};
+    for (Operand& o : pending)
+    {
+      if (o.kind == Operand::Global && o.index == addr)
+      {
+        if (r.kind != Operand::Register)
+        {
+          r = allocateRegister();
+          RegisterInstruction& ri = emit(ROP_MOVE,source);
+          ri.dst = r.index;
+          ri.a = o;
+        }
+        o = r;
+      }
+    }
+  }
+
+  RegisterInstruction& emit(uint32_t op, const Instruction* source)
+  {
+    RegisterInstruction ri;
+    ri.op = op;
+    ri.subop = 0;
+    ri.type = Type::undefinedType;
+    ri.dst = 0;
+    ri.a = Operand{Operand::Stack,0,nullptr};
+    ri.b = Operand{Operand::Stack,0,nullptr};
+    ri.target = nullptr;
+    ri.source = source;
+    code.push_back(ri);
+    return code.back();
+  }
+
+  uint32_t getRegisterCount() const
+  {
+    return maxRegister;
+  }
+
+private:
+  std::vector<RegisterInstruction>& code;
+  std::vector<Operand> pending;
+  uint32_t nextRegister;
+  uint32_t maxRegister;
+};
+
+bool isArithmetic(uint32_t op)
+{
+  return (op >= OP_ARIADD && op <= OP_ARIMOD) || (op >= OP_ADDI && op <= OP_CONCAT);
+}
+
+bool isComparison(uint32_t op)
+{
+  return (op >= OP_ARIEQ && op <= OP_ARIGT) || (op >= OP_EQN && op <= OP_GTN);
+}
+
+}
+
+
+
+RegisterCode::RegisterCode():
+  registerCount(0)
+{
+}
+
+std::shared_ptr<const RegisterCode> RegisterCode::translate(std::shared_ptr<const DecodedCode> dc)
+{
+  std::shared_ptr<RegisterCode> rc(new RegisterCode());
+  rc->decoded = dc;
+  const int32_t size = dc->getSize();
+  /*
+   * Basic blocks start at the entry, at jump targets and behind subroutine
+   * calls. An OP_END stays on itself, hence it starts a block as well.
+   */
+  std::vector<bool> blockStart(static_cast<size_t>(size),false);
+  blockStart[0] = true;
+  blockStart[static_cast<size_t>(size-1)] = true;
+  for (int32_t i=0;i<size;i++)
+  {
+    const Instruction* in = dc->getInstruction(i);
+    if (in->target != nullptr) blockStart[static_cast<size_t>(dc->getIndex(in->target))] = true;
+    if (in->op == OP_JSR && i+1 < size) blockStart[static_cast<size_t>(i+1)] = true;
+    if (in->op == OP_END) blockStart[static_cast<size_t>(i)] = true;
+  }
+  rc->entries.assign(static_cast<size_t>(size),-1);
+  /* decoded jump targets, resolved once all instructions are translated */
+  std::vector<const Instruction*> targets;
+  Translator t(rc->code);
+  for (int32_t i=0;i<size;i++)
+  {
+    const Instruction* in = dc->getInstruction(i);
+    size_t first = rc->code.size();
+    if (blockStart[static_cast<size_t>(i)])
+    {
+      t.flush(in);
+      rc->entries[static_cast<size_t>(i)] = static_cast<int32_t>(rc->code.size());
+    }
+    switch (in->op)
+    {
+      case OP_NOP:
+        break;
+      case OP_PUSH:
+        if (in->value != nullptr)
+          t.push(Operand{Operand::Immediate,0,in->value});
+        else
+        {
+          t.flush(in);
+          t.emit(ROP_STACK,in);
+        }
+        break;
+      case OP_RCL:
+        if (in->constant == nullptr && !in->type.isArrayType())
+          t.push(Operand{Operand::Global,in->arg,nullptr});
+        else if (in->constant != nullptr && !in->constant->empty())
+          t.push(Operand{Operand::Immediate,0,&in->constant->front()});
+        else
+        {
+          t.flush(in);
+          t.emit(ROP_STACK,in);
+        }
+        break;
+      case OP_STO:
+        if (!in->type.isArrayType())
+        {
+          Operand a = t.pop();
+          t.protect(in->arg,in);
+          RegisterInstruction& ri = t.emit(ROP_STO,in);
+          ri.type = in->type;
+          ri.dst = in->arg;
+          ri.a = a;
+        }
+        else
+        {
+          t.flush(in);
+          t.emit(ROP_STACK,in);
+        }
+        break;
+      case OP_DUP:
+        if (t.hasPending())
+          t.push(t.top());
+        else
+          t.emit(ROP_STACK,in);
+        break;
+      case OP_SWAP:
+        if (t.hasPending(2))
+          std::swap(t.top(),t.top(1));
+        else
+        {
+          t.flush(in);
+          t.emit(ROP_STACK,in);
+        }
+        break;
+      case OP_POP:
+        if (t.hasPending())
+          t.pop();
+        else
+          t.emit(ROP_STACK,in);
+        break;
+      case OP_JZ:
+      case OP_JNZ:
+      {
+        Operand a = t.pop();
+        t.flush(in);
+        RegisterInstruction& ri = t.emit(in->op == OP_JZ ? ROP_JZ : ROP_JNZ,in);
+        ri.a = a;
+        break;
+      }
+      case OP_ERRHDL:
+      case ASM_LINE:
+        /* neither touch the stack nor the memory */
+        t.emit(ROP_STACK,in);
+        break;
+      default:
+        if (isArithmetic(in->op) || isComparison(in->op))
+        {
+          Operand b = t.pop();
+          Operand a = t.pop();
+          Operand r = t.allocateRegister();
+          RegisterInstruction& ri = t.emit(isArithmetic(in->op) ? ROP_ARI : ROP_CMP,in);
+          ri.subop = in->op;
+          ri.dst = r.index;
+          ri.a = a;
+          ri.b = b;
+          t.push(r);
+        }
+        else
+        {
+          t.flush(in);
+          t.emit(ROP_STACK,in);
+        }
+        break;
+    }
+    for (size_t k=first;k<rc->code.size();k++)
+      targets.push_back(rc->code[k].op == ROP_JZ || rc->code[k].op == ROP_JNZ ? in->target : nullptr);
+  }
+  for (size_t k=0;k<rc->code.size();k++)
+  {
+    if (targets[k] != nullptr) rc->code[k].target = rc->getInstruction(targets[k]);
+  }
+  rc->registerCount = t.getRegisterCount();
+  return rc;
+}
+
+const RegisterInstruction* RegisterCode::getInstruction(const Instruction* i) const
+{
+  int32_t index = decoded->getIndex(i);
+  if (index < 0 || static_cast<size_t>(index) >= entries.size() || entries[static_cast<size_t>(index)] < 0)
+    throw std::runtime_error("Illegal jump target");
+  return &code[static_cast<size_t>(entries[static_cast<size_t>(index)])];
+}
+
+const RegisterInstruction* RegisterCode::getStart() const
+{
+  return code.data();
+}
+
+int32_t RegisterCode::getSize() const
+{
+  return static_cast<int32_t>(code.size());
+}
+
+uint32_t RegisterCode::getRegisterCount() const
+{
+  return registerCount;
+}
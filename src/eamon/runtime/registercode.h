@@ -0,0 +1,146 @@
+/********************************************************************************
+ *                                                                              *
+ * EamonInterpreter - register machine code                                     *
+ *                                                                              *
+ * modified: 2026-10-16                                                         *
+ *                                                                              *
+ ********************************************************************************
+ * Copyright (C) Harald Braeuning                                               *
+ ********************************************************************************
+ * This file is part of EamonInterpreter.                                       *
+ * EamonInterpreter is free software: you can redistribute it and/or modify it  *
+ * under the terms of the GNU General Public License as published by the Free   *
+ * Software Foundation, either version 3 of the License, or (at your option)    *
+ * any later version.                                                           *
+ * EamonInterpreter is distributed in the hope that it will be useful, but      *
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY   *
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for  *
+ * more details.                                                                *
+ * You should have received a copy of the GNU General Public License along with *
+ * EamonInterpreter. If not, see <https://www.gnu.org/licenses/>.               *
+ ********************************************************************************/
+
+
+#ifndef REGISTERCODE_H
+#define REGISTERCODE_H
+
+#include "decodedcode.h"
+#include "type.h"
+#include "value.h"
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+
+
+/*
+ * Op codes of the register machine
+ */
+/* execute the decoded stack instruction */
+#define ROP_STACK     0
+/* push operand a on the stack */
+#define ROP_PUSH      1
+/* copy operand a to register dst */
+#define ROP_MOVE      2
+/* register dst = a subop b (arithmetic) */
+#define ROP_ARI       3
+/* register dst = a subop b (comparison, 1 or 0) */
+#define ROP_CMP       4
+/* store operand a in the global variable dst */
+#define ROP_STO       5
+/* jump if operand a is zero */
+#define ROP_JZ        6
+/* jump if operand a is not zero */
+#define ROP_JNZ       7
+
+/**
+ * @brief Operand of a register machine instruction.
+ */
+struct Operand
+{
+  enum Kind : uint8_t {
+    Stack,     /**< popped from the stack */
+    Global,    /**< global variable */
+    Immediate, /**< constant value */
+    Register   /**< register */
+  };
+  Kind kind;
+  uint32_t index;     /**< global memory address or register number */
+  const Value* value; /**< the immediate value */
+};
+
+/**
+ * @brief A three address instruction of the register machine.
+ */
+struct RegisterInstruction
+{
+  uint32_t op;                       /**< ROP_* */
+  uint32_t subop;                    /**< mnemonic of the arithmetic or comparison op code */
+  Type type;                         /**< type of the variable to store */
+  uint32_t dst;                      /**< destination register or global memory address */
+  Operand a;                         /**< first operand */
+  Operand b;                         /**< second operand */
+  const RegisterInstruction* target; /**< jump target */
+  const Instruction* source;         /**< decoded instruction the instruction was created from */
+};
+
+/**
+ * @brief The RegisterCode class holds the code of an executable translated
+ * for the register machine.
+ *
+ * The translation follows the decoded stack code and keeps track of the values
+ * the stack code would push. Variables and constants are used directly as
+ * operands and every arithmetic or comparison result goes to a register. The
+ * stack is only materialized where the stack code needs it: before library
+ * calls, array access, subroutine calls and at the start of each basic
+ * block. All these instructions are executed by the stack machine handlers.
+ */
+class RegisterCode
+{
+public:
+  /**
+   * @brief Translates decoded code.
+   * @param dc the decoded code
+   * @return the register machine code
+   */
+  static std::shared_ptr<const RegisterCode> translate(std::shared_ptr<const DecodedCode> dc);
+
+  /**
+   * @brief Returns the register machine instruction a jump to a decoded
+   * instruction continues with.
+   * @param i the decoded instruction
+   * @return the register machine instruction
+   * @throws runtime_error if the decoded instruction does not start a basic block
+   */
+  const RegisterInstruction* getInstruction(const Instruction* i) const;
+
+  /**
+   * @brief Returns the first instruction.
+   * @return pointer to the first instruction
+   */
+  const RegisterInstruction* getStart() const;
+
+  /**
+   * @brief Returns the number of instructions.
+   * @return number of instructions
+   */
+  int32_t getSize() const;
+
+  /**
+   * @brief Returns the number of registers used by the code.
+   * @return the number of registers
+   */
+  uint32_t getRegisterCount() const;
+
+private:
+  RegisterCode();
+
+  std::shared_ptr<const DecodedCode> decoded;
+  std::vector<RegisterInstruction> code;
+  std::vector<int32_t> entries; /* index of the instruction for each decoded basic block start, -1 otherwise */
+  uint32_t registerCount;
+};
+
+
+
+#endif // REGISTERCODE_H
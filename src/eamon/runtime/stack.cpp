@@ -27,38 +27,31 @@
 
 const int32_t initial_stacksize = 1000;
 
-Stack::Stack()
+Stack::Stack():
+  stack(initial_stacksize),
+  sp(0)
 {
-  stack.reserve(initial_stacksize);
 }
 
+/* the values are dropped, so they do not keep their strings alive */
 void Stack::clear()
 {
-  stack.clear();
+  while (sp > 0) stack[--sp] = Value();
 }
 
-void Stack::push(const Value& v)
+void Stack::reserve(uint32_t n)
 {
-  stack.push_back(v);
+  if (stack.size() < n) stack.resize(n);
 }
 
-Value Stack::pop()
+void Stack::grow()
 {
-  if (stack.empty()) throw std::out_of_range("Stack underflow!");
-  Value v = stack.back();
-  stack.pop_back();
-  return v;
+  stack.resize(2*stack.size());
 }
 
-void Stack::swap()
+void Stack::underflow()
 {
-  if (stack.size() < 2) throw std::out_of_range("Stack underflow!");
-  Value t1 = stack.back();
-  stack.pop_back();
-  Value t2 = stack.back();
-  stack.pop_back();
-  stack.push_back(t1);
-  stack.push_back(t2);
+  throw std::out_of_range("Stack underflow!");
 }
 
 
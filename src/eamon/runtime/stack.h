@@ -26,11 +26,24 @@
 #include "value.h"
 #include <stdint.h>
 #include <string>
+#include <utility>
 #include <vector>
 
 
 
 
+/**
+ * @brief The Stack class implements the value stack of the virtual machine.
+ *
+ * The stack keeps its entries in a preallocated array. The checked operations
+ * grow the array and throw on underflow. The unchecked operations, selected
+ * by the template parameter, do neither: they may only be used when the
+ * Verifier proved the code to stay within 0 and the reserved depth.
+ *
+ * Values are moved off the stack, and the operations of the virtual machine
+ * work on the top entries in place, so a value is not copied on its way
+ * through the stack.
+ */
 class Stack
 {
 public:
@@ -38,26 +51,133 @@ public:
 
   void clear();
 
-  void push(const Value& v);
+  /**
+   * @brief Returns the number of values on the stack.
+   * @return number of values
+   */
+  uint32_t size() const;
+
+  /**
+   * @brief Makes sure the given number of values fits on the stack without
+   * growing it.
+   * @param n number of values
+   */
+  void reserve(uint32_t n);
+
+  template<bool checked=true> void push(const Value& v);
+
+  template<bool checked=true> void push(Value&& v);
 
   /**
    * @brief Pops a value from the stack.
    * @return value
    * @throws out_of_range if stack is empty
    */
-  Value pop();
+  template<bool checked=true> Value pop();
+
+  /**
+   * @brief Returns the top entry, which may be modified in place.
+   * @return reference to the top value; valid until the next push
+   * @throws out_of_range if stack is empty
+   */
+  template<bool checked=true> Value& top();
+
+  /**
+   * @brief Returns an entry below the top.
+   * @param n number of entries above the value; peek(0) is the top
+   * @return reference to the value; valid until the next push
+   * @throws out_of_range if there are not more than n entries
+   */
+  template<bool checked=true> Value& peek(uint32_t n);
+
+  /**
+   * @brief Pushes a copy of the top entry.
+   * @throws out_of_range if stack is empty
+   */
+  template<bool checked=true> void dup();
+
+  /**
+   * @brief Pops the top entry and combines it with the new top in place.
+   *
+   * The operation is called as op(lhs,rhs) with lhs being the entry below
+   * the top and has to store the result in lhs.
+   * @param op the binary operation
+   * @throws out_of_range if there are less than two entries
+   */
+  template<bool checked=true, typename Op> void reduce(Op op);
 
   /**
    * @brief Swaps the two top entries in the numeric stack.
+   * @throws out_of_range if there are less than two entries
    */
-  void swap();
+  template<bool checked=true> void swap();
 
 private:
-  std::vector<Value> stack;
+  void grow();
+  [[noreturn]] static void underflow();
+
+  std::vector<Value> stack; /* entries up to the capacity; only the first sp are in use */
+  uint32_t sp;
 };
 
 
 
+inline uint32_t Stack::size() const
+{
+  return sp;
+}
+
+template<bool checked> inline void Stack::push(const Value& v)
+{
+  if (checked && sp == stack.size()) grow();
+  stack[sp++] = v;
+}
+
+template<bool checked> inline void Stack::push(Value&& v)
+{
+  if (checked && sp == stack.size()) grow();
+  stack[sp++] = std::move(v);
+}
+
+template<bool checked> inline Value Stack::pop()
+{
+  if (checked && sp == 0) underflow();
+  return std::move(stack[--sp]);
+}
+
+template<bool checked> inline Value& Stack::top()
+{
+  if (checked && sp == 0) underflow();
+  return stack[sp-1];
+}
+
+template<bool checked> inline Value& Stack::peek(uint32_t n)
+{
+  if (checked && sp <= n) underflow();
+  return stack[sp-1-n];
+}
+
+template<bool checked> inline void Stack::dup()
+{
+  if (checked && sp == 0) underflow();
+  if (checked && sp == stack.size()) grow(); /* the top must not be referenced across grow() */
+  stack[sp] = stack[sp-1];
+  sp++;
+}
+
+template<bool checked, typename Op> inline void Stack::reduce(Op op)
+{
+  if (checked && sp < 2) underflow();
+  Value rhs = std::move(stack[--sp]);
+  op(stack[sp-1],static_cast<const Value&>(rhs));
+}
+
+template<bool checked> inline void Stack::swap()
+{
+  if (checked && sp < 2) underflow();
+  std::swap(stack[sp-1],stack[sp-2]);
+}
+
 
 
 #endif // STACK_H
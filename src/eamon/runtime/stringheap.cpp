@@ -0,0 +1,348 @@
+/********************************************************************************
+ *                                                                              *
+ * EamonInterpreter - string heap                                               *
+ *                                                                              *
+ * modified: 2026-10-16                                                         *
+ *                                                                              *
+ ********************************************************************************
+ * Copyright (C) Harald Braeuning                                               *
+ ********************************************************************************
+ * This file is part of EamonInterpreter.                                       *
+ * EamonInterpreter is free software: you can redistribute it and/or modify it  *
+ * under the terms of the GNU General Public License as published by the Free   *
+ * Software Foundation, either version 3 of the License, or (at your option)    *
+ * any later version.                                                           *
+ * EamonInterpreter is distributed in the hope that it will be useful, but      *
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY   *
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for  *
+ * more details.                                                                *
+ * You should have received a copy of the GNU General Public License along with *
+ * EamonInterpreter. If not, see <https://www.gnu.org/licenses/>.               *
+ ********************************************************************************/
+
+
+#include "stringheap.h"
+#include <algorithm>
+#include <cstring>
+
+/* the empty string is static, so it never has to be allocated */
+static StringData emptyString = { STRINGHEAP_PINNED, 0, 0, "", nullptr, nullptr, 0 };
+
+thread_local StringHeap* StringHeap::current = nullptr;
+
+
+
+StringHeap::Scope::Scope(StringHeap* heap):
+  previous(current)
+{
+  current = heap;
+}
+
+StringHeap::Scope::~Scope()
+{
+  current = previous;
+}
+
+
+
+StringHeap::StringHeap(uint32_t size):
+  space(new char[size]),
+  size(size),
+  top(0),
+  sliceLimit(STRINGHEAP_SLICE_LIMIT)
+{
+}
+
+/*
+ * Strings still referenced (e.g. by a value returned to the user interface)
+ * get a block of their own, so they survive the heap. The slices are copied
+ * first, while the characters of their parents are still in the space.
+ */
+StringHeap::~StringHeap()
+{
+  for (StringData* d : slices)
+  {
+    StringData* parent = d->parent;
+    if (d->refs == 0)
+    {
+      delete d;
+    }
+    else
+    {
+      char* text = new char[d->length + 1];
+      memcpy(text,d->text,d->length);
+      text[d->length] = 0;
+      d->text = text;
+      d->heap = nullptr;
+      d->parent = nullptr;
+      d->offset = 0;
+    }
+    release(parent);
+  }
+  for (StringData* d : strings)
+  {
+    if (d->refs == 0)
+    {
+      delete d;
+    }
+    else
+    {
+      char* text = new char[d->length + 1];
+      memcpy(text,d->text,d->length + 1);
+      d->text = text;
+      d->heap = nullptr;
+    }
+  }
+  for (StringData* d : spare) delete d;
+}
+
+void StringHeap::collect()
+{
+  auto start = std::chrono::steady_clock::now();
+  /* dead slices release their parents, which may become garbage as well */
+  size_t n = 0;
+  for (StringData* d : slices)
+  {
+    if (d->refs == 0)
+    {
+      release(d->parent);
+      spare.push_back(d);
+    }
+    else
+    {
+      slices[n++] = d;
+    }
+  }
+  slices.resize(n);
+  uint32_t used = 0;
+  n = 0;
+  for (StringData* d : strings)
+  {
+    if (d->refs == 0)
+    {
+      spare.push_back(d);
+    }
+    else
+    {
+      char* text = space.get() + used;
+      if (text != d->text) memmove(text,d->text,d->length + 1);
+      d->text = text;
+      d->capacity = d->length; /* the room to grow is reclaimed as well */
+      used += d->length + 1;
+      strings[n++] = d;
+    }
+  }
+  strings.resize(n);
+  for (StringData* d : slices) d->text = d->parent->text + d->offset;
+  statistics.reclaimedBytes += top - used;
+  top = used;
+  auto pause = std::chrono::steady_clock::now() - start;
+  statistics.collections++;
+  statistics.totalPause += pause;
+  statistics.maxPause = std::max(statistics.maxPause,std::chrono::duration_cast<std::chrono::nanoseconds>(pause));
+}
+
+uint32_t StringHeap::getSize() const
+{
+  return size;
+}
+
+uint32_t StringHeap::getFree() const
+{
+  return size - top;
+}
+
+const StringHeap::Statistics& StringHeap::getStatistics() const
+{
+  return statistics;
+}
+
+StringHeap* StringHeap::getCurrent()
+{
+  return current;
+}
+
+StringData* StringHeap::allocate(const char* s, uint32_t length)
+{
+  if (length == 0) return getEmpty();
+  char* text;
+  StringData* d = allocate(length,text);
+  memcpy(text,s,length);
+  return d;
+}
+
+StringData* StringHeap::getEmpty()
+{
+  return &emptyString;
+}
+
+StringData* StringHeap::allocate(uint32_t length, char*& text)
+{
+  if (current != nullptr) return current->reserve(length,text,length);
+  StringData* d = new StringData;
+  text = new char[length + 1];
+  text[length] = 0;
+  d->refs = 1;
+  d->length = length;
+  d->capacity = length;
+  d->text = text;
+  d->heap = nullptr;
+  d->parent = nullptr;
+  d->offset = 0;
+  return d;
+}
+
+char* StringHeap::extend(StringData*& d, uint32_t length)
+{
+  if (d->refs == 1 && d->heap != nullptr && d->heap == current && d->parent == nullptr) return current->append(d,length);
+  char* text;
+  StringData* e = allocate(d->length + length,text);
+  memcpy(text,d->chars(),d->length);
+  release(d);
+  d = e;
+  return text + e->length - length;
+}
+
+/*
+ * A slice always refers to a string with characters of its own, so the
+ * chain of parents is never longer than one.
+ */
+StringData* StringHeap::slice(StringData* d, uint32_t start, uint32_t length)
+{
+  if (length == 0) return getEmpty();
+  if (start == 0 && length == d->length)
+  {
+    retain(d);
+    return d;
+  }
+  StringHeap* owner = d->parent != nullptr ? d->parent->heap : d->heap;
+  if (current == nullptr || (owner != nullptr && owner != current))
+  {
+    char* text;
+    StringData* s = allocate(length,text);
+    memcpy(text,d->chars() + start,length);
+    return s;
+  }
+  if (d->parent != nullptr)
+  {
+    start += d->offset;
+    d = d->parent;
+  }
+  if (current->slices.size() >= current->sliceLimit)
+  {
+    /* slices take no space, so they trigger a collection by their number */
+    current->collect();
+    if (current->slices.size() > current->sliceLimit / 2) current->sliceLimit *= 2;
+  }
+  retain(d);
+  StringData* s = current->header();
+  s->refs = 1;
+  s->length = length;
+  s->capacity = length;
+  s->text = d->text + start;
+  s->heap = current;
+  s->parent = d;
+  s->offset = start;
+  current->slices.push_back(s);
+  current->statistics.slices++;
+  return s;
+}
+
+void StringHeap::materialize(StringData*& d)
+{
+  if (d->parent == nullptr) return;
+  char* text;
+  StringData* e = allocate(d->length,text);
+  memcpy(text,d->chars(),d->length);
+  release(d);
+  d = e;
+}
+
+void StringHeap::pin(StringData* d)
+{
+  d->refs = STRINGHEAP_PINNED;
+}
+
+void StringHeap::unpin(StringData* d)
+{
+  d->refs = 1;
+}
+
+void StringHeap::free(StringData* d)
+{
+  delete [] d->text;
+  delete d;
+}
+
+StringData* StringHeap::reserve(uint32_t length, char*& text, uint32_t capacity)
+{
+  uint32_t n = capacity + 1;
+  if (n > size - top)
+  {
+    collect();
+    if (n > size - top || top > size / 2) grow(top + n);
+  }
+  StringData* d = header();
+  text = space.get() + top;
+  text[length] = 0;
+  top += n;
+  d->refs = 1;
+  d->length = length;
+  d->capacity = capacity;
+  d->text = text;
+  d->heap = this;
+  d->parent = nullptr;
+  d->offset = 0;
+  strings.push_back(d);
+  statistics.allocations++;
+  statistics.allocatedBytes += n;
+  return d;
+}
+
+char* StringHeap::append(StringData*& d, uint32_t length)
+{
+  uint32_t n = d->length + length;
+  if (n > d->capacity && d->text + d->capacity + 1 == space.get() + top && n - d->capacity <= size - top)
+  {
+    /* the last string grows into the free space */
+    top += n - d->capacity;
+    statistics.allocatedBytes += n - d->capacity;
+    d->capacity = n;
+  }
+  if (n <= d->capacity)
+  {
+    char* text = const_cast<char*>(d->text) + d->length;
+    text[length] = 0;
+    d->length = n;
+    statistics.appends++;
+    return text;
+  }
+  /* the old characters become garbage; the string is the only reference */
+  char* text;
+  StringData* e = reserve(n,text,2 * n);
+  memcpy(text,d->text,d->length);
+  d->refs = 0;
+  d = e;
+  return text + n - length;
+}
+
+StringData* StringHeap::header()
+{
+  if (spare.empty()) return new StringData;
+  StringData* d = spare.back();
+  spare.pop_back();
+  return d;
+}
+
+/* only called right after a collection, so the strings are contiguous */
+void StringHeap::grow(uint32_t minimum)
+{
+  uint32_t s = std::max(size,1u);
+  while (s < 2 * minimum) s *= 2;
+  std::unique_ptr<char[]> m(new char[s]);
+  memcpy(m.get(),space.get(),top);
+  for (StringData* d : strings) d->text = m.get() + (d->text - space.get());
+  for (StringData* d : slices) d->text = d->parent->text + d->offset;
+  space = std::move(m);
+  size = s;
+}
@@ -0,0 +1,290 @@
+/********************************************************************************
+ *                                                                              *
+ * EamonInterpreter - string heap                                               *
+ *                                                                              *
+ * modified: 2026-10-16                                                         *
+ *                                                                              *
+ ********************************************************************************
+ * Copyright (C) Harald Braeuning                                               *
+ ********************************************************************************
+ * This file is part of EamonInterpreter.                                       *
+ * EamonInterpreter is free software: you can redistribute it and/or modify it  *
+ * under the terms of the GNU General Public License as published by the Free   *
+ * Software Foundation, either version 3 of the License, or (at your option)    *
+ * any later version.                                                           *
+ * EamonInterpreter is distributed in the hope that it will be useful, but      *
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY   *
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for  *
+ * more details.                                                                *
+ * You should have received a copy of the GNU General Public License along with *
+ * EamonInterpreter. If not, see <https://www.gnu.org/licenses/>.               *
+ ********************************************************************************/
+
+
+#ifndef STRINGHEAP_H
+#define STRINGHEAP_H
+
+#include <stdint.h>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+/* reference count of strings which are never released */
+#define STRINGHEAP_PINNED 0xFFFFFFFFu
+/* initial size of the string space of a heap in bytes */
+#define STRINGHEAP_INITIAL_SIZE 32768
+/* initial number of slices which triggers a collection */
+#define STRINGHEAP_SLICE_LIMIT 1024
+
+class StringHeap;
+
+
+
+/**
+ * @brief Header of an immutable string referenced by values.
+ *
+ * Values share the header and only copy the pointer. The characters are
+ * terminated by a zero byte; they live either in the string space of a heap,
+ * where the compaction may move them, or in a block of their own. A string
+ * of a heap which has a single reference may be extended in place up to its
+ * capacity (see StringHeap::extend()). A slice (see StringHeap::slice())
+ * has no characters of its own but refers to a part of its parent, so its
+ * characters are not terminated. The reference count is not atomic: a
+ * string is only used by one thread, except for pinned strings like the
+ * constants of an executable, which are never counted.
+ */
+struct StringData
+{
+  uint32_t refs;              /**< number of referencing values or STRINGHEAP_PINNED */
+  uint32_t length;            /**< number of characters without the terminating zero */
+  uint32_t capacity;          /**< number of characters which fit into the space of the string */
+  const char* text;           /**< the characters */
+  StringHeap* heap;           /**< heap owning the characters or nullptr */
+  StringData* parent;         /**< string holding the characters of a slice or nullptr */
+  uint32_t offset;            /**< position of the characters of a slice in its parent */
+
+  /**
+   * @brief Returns the characters of the string.
+   *
+   * The pointer is only valid until the next string is allocated. The
+   * characters of a slice are not terminated.
+   * @return pointer to the characters
+   */
+  const char* chars() const;
+};
+
+/**
+ * @brief The StringHeap class holds the string space of a virtual machine.
+ *
+ * Similar to the string space of Applesoft, strings are allocated by bumping
+ * a pointer. A string whose last reference is released becomes garbage,
+ * which is reclaimed when the space is exhausted: the collection slides the
+ * live strings down to the start of the space, so the free space is always
+ * contiguous. If more than half of the space is still used afterwards, the
+ * space is doubled.
+ *
+ * The static functions allocate in the heap made current by a Scope on the
+ * calling thread; without a current heap, every string gets a block of its
+ * own. A heap is used by a single thread only.
+ */
+class StringHeap
+{
+public:
+  /**
+   * @brief Counters for monitoring the heap.
+   */
+  struct Statistics
+  {
+    uint64_t allocations = 0;                 /**< number of strings allocated in the string space */
+    uint64_t allocatedBytes = 0;              /**< bytes allocated in the string space */
+    uint64_t appends = 0;                     /**< number of strings extended in place */
+    uint64_t slices = 0;                      /**< number of substrings sharing the characters of their parent */
+    uint64_t collections = 0;                 /**< number of garbage collections */
+    uint64_t reclaimedBytes = 0;              /**< bytes reclaimed by the collections */
+    std::chrono::nanoseconds totalPause{0};   /**< time spent in the collections */
+    std::chrono::nanoseconds maxPause{0};     /**< longest collection */
+  };
+
+  /**
+   * @brief Makes a heap the current heap of the thread for the lifetime of
+   * the scope.
+   */
+  class Scope
+  {
+  public:
+    /**
+     * @param heap the heap or nullptr to allocate separate blocks
+     */
+    Scope(StringHeap* heap);
+    ~Scope();
+
+  private:
+    StringHeap* previous;
+  };
+
+  StringHeap(uint32_t size=STRINGHEAP_INITIAL_SIZE);
+  StringHeap(const StringHeap&) = delete;
+  StringHeap& operator=(const StringHeap&) = delete;
+  ~StringHeap();
+
+  /**
+   * @brief Reclaims the garbage and compacts the string space.
+   */
+  void collect();
+
+  /**
+   * @brief Returns the size of the string space.
+   * @return size in bytes
+   */
+  uint32_t getSize() const;
+
+  /**
+   * @brief Returns the free space above the allocated strings.
+   *
+   * After collect() this is the space available without growing.
+   * @return free space in bytes
+   */
+  uint32_t getFree() const;
+
+  const Statistics& getStatistics() const;
+
+  /**
+   * @brief Returns the current heap of the calling thread.
+   * @return the heap or nullptr
+   */
+  static StringHeap* getCurrent();
+
+  /**
+   * @brief Allocates a string.
+   * @param s the characters
+   * @param length the number of characters
+   * @return the string with a reference count of one
+   */
+  static StringData* allocate(const char* s, uint32_t length);
+
+  /**
+   * @brief Allocates a string to be filled by the caller.
+   *
+   * The allocation may move the characters of other strings, so they must
+   * be fetched afterwards.
+   * @param length the number of characters
+   * @param text returns the characters to fill in
+   * @return the string with a reference count of one
+   */
+  static StringData* allocate(uint32_t length, char*& text);
+
+  /**
+   * @brief Makes room for characters at the end of a string.
+   *
+   * If the string has a single reference and belongs to the current heap, it
+   * is extended in place: either within its capacity or, if it is the last
+   * string of the space, by bumping the top of the space. Otherwise the
+   * string is copied to a new string with twice the needed capacity, so
+   * appending to a string repeatedly takes amortized linear time. A copy of a
+   * shared string takes over the reference of the caller.
+   *
+   * The allocation may move the characters of other strings, so they must be
+   * fetched afterwards.
+   * @param d the string; replaced by the new string if it is copied
+   * @param length the number of characters to append
+   * @return the space for the characters to fill in
+   */
+  static char* extend(StringData*& d, uint32_t length);
+
+  /**
+   * @brief Returns a part of a string.
+   *
+   * In a current heap, the part is a slice: a header referring to the
+   * characters of the string, which it keeps alive, so no characters are
+   * copied. The compaction moves the characters of a slice together with
+   * its parent. Without a current heap the characters are copied.
+   *
+   * The slice of a pinned string must be collected before the owner of the
+   * string goes away.
+   * @param d the string
+   * @param start position of the first character
+   * @param length number of characters; start + length must not exceed the
+   * length of the string
+   * @return the part with a reference count of one
+   */
+  static StringData* slice(StringData* d, uint32_t start, uint32_t length);
+
+  /**
+   * @brief Gives a slice characters of its own.
+   *
+   * A string which should live long is materialized, so it does not keep a
+   * possibly much longer parent alive. Other strings are not changed.
+   * @param d the string; replaced by the copy if it is a slice
+   */
+  static void materialize(StringData*& d);
+
+  /**
+   * @brief Returns the pinned empty string.
+   * @return the empty string
+   */
+  static StringData* getEmpty();
+
+  /**
+   * @brief Adds a reference to a string.
+   * @param d the string
+   */
+  static void retain(StringData* d);
+
+  /**
+   * @brief Removes a reference from a string.
+   *
+   * A string of its own is freed with the last reference; the space of a
+   * string in a heap is reclaimed by the next collection.
+   * @param d the string
+   */
+  static void release(StringData* d);
+
+  /**
+   * @brief Pins a string which has a single reference.
+   * @param d the string
+   */
+  static void pin(StringData* d);
+
+  /**
+   * @brief Reverts pin(); the string has a single reference again.
+   * @param d the string
+   */
+  static void unpin(StringData* d);
+
+private:
+  static void free(StringData* d);
+  StringData* reserve(uint32_t length, char*& text, uint32_t capacity);
+  StringData* header();
+  char* append(StringData*& d, uint32_t length);
+  void grow(uint32_t minimum);
+
+  std::unique_ptr<char[]> space;
+  uint32_t size;
+  uint32_t top;                     /* start of the free space */
+  std::vector<StringData*> strings; /* headers in the order of their characters */
+  std::vector<StringData*> slices;  /* headers of the slices */
+  size_t sliceLimit;                /* collect when the number of slices reaches the limit */
+  std::vector<StringData*> spare;   /* headers for reuse */
+  Statistics statistics;
+
+  static thread_local StringHeap* current;
+};
+
+inline const char* StringData::chars() const
+{
+  return text;
+}
+
+inline void StringHeap::retain(StringData* d)
+{
+  if (d->refs != STRINGHEAP_PINNED) d->refs++;
+}
+
+inline void StringHeap::release(StringData* d)
+{
+  if (d->refs != STRINGHEAP_PINNED && --d->refs == 0 && d->heap == nullptr) free(d);
+}
+
+
+
+#endif // STRINGHEAP_H
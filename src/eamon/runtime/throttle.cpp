@@ -0,0 +1,73 @@
+/********************************************************************************
+ *                                                                              *
+ * EamonInterpreter - instruction throttle                                      *
+ *                                                                              *
+ * modified: 2026-10-16                                                         *
+ *                                                                              *
+ ********************************************************************************
+ * Copyright (C) Harald Braeuning                                               *
+ ********************************************************************************
+ * This file is part of EamonInterpreter.                                       *
+ * EamonInterpreter is free software: you can redistribute it and/or modify it  *
+ * under the terms of the GNU General Public License as published by the Free   *
+ * Software Foundation, either version 3 of the License, or (at your option)    *
+ * any later version.                                                           *
+ * EamonInterpreter is distributed in the hope that it will be useful, but      *
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY   *
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for  *
+ * more details.                                                                *
+ * You should have received a copy of the GNU General Public License along with *
+ * EamonInterpreter. If not, see <https://www.gnu.org/licenses/>.               *
+ ********************************************************************************/
+
+
+#include "throttle.h"
+#include <algorithm>
+#include <thread>
+
+
+
+Throttle::Throttle():
+  rate(0),
+  sliceSize(1),
+  executed(0)
+{
+}
+
+void Throttle::setRate(uint32_t ips)
+{
+  rate = ips;
+  sliceSize = std::max(rate / THROTTLE_SLICES_PER_SECOND,1u);
+}
+
+uint32_t Throttle::getRate() const
+{
+  return rate;
+}
+
+bool Throttle::isActive() const
+{
+  return rate > 0;
+}
+
+uint32_t Throttle::getSliceSize() const
+{
+  return sliceSize;
+}
+
+void Throttle::start()
+{
+  origin = std::chrono::steady_clock::now();
+  executed = 0;
+}
+
+void Throttle::endSlice()
+{
+  executed += sliceSize;
+  auto due = origin + std::chrono::nanoseconds(executed / rate * 1000000000 + executed % rate * 1000000000 / rate);
+  auto now = std::chrono::steady_clock::now();
+  if (now - due > std::chrono::milliseconds(THROTTLE_MAX_LAG_MS))
+    start();
+  else if (due > now)
+    std::this_thread::sleep_until(due);
+}
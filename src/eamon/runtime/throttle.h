@@ -0,0 +1,94 @@
+/********************************************************************************
+ *                                                                              *
+ * EamonInterpreter - instruction throttle                                      *
+ *                                                                              *
+ * modified: 2026-10-16                                                         *
+ *                                                                              *
+ ********************************************************************************
+ * Copyright (C) Harald Braeuning                                               *
+ ********************************************************************************
+ * This file is part of EamonInterpreter.                                       *
+ * EamonInterpreter is free software: you can redistribute it and/or modify it  *
+ * under the terms of the GNU General Public License as published by the Free   *
+ * Software Foundation, either version 3 of the License, or (at your option)    *
+ * any later version.                                                           *
+ * EamonInterpreter is distributed in the hope that it will be useful, but      *
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY   *
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for  *
+ * more details.                                                                *
+ * You should have received a copy of the GNU General Public License along with *
+ * EamonInterpreter. If not, see <https://www.gnu.org/licenses/>.               *
+ ********************************************************************************/
+
+
+#ifndef THROTTLE_H
+#define THROTTLE_H
+
+#include <stdint.h>
+#include <chrono>
+
+/* approximate speed of Applesoft BASIC on a 1 MHz Apple II in op codes per second */
+#define THROTTLE_APPLE2_RATE 5000
+/* number of time slices per second */
+#define THROTTLE_SLICES_PER_SECOND 100
+/* a delay longer than this (e.g. waiting for input) is not caught up */
+#define THROTTLE_MAX_LAG_MS 100
+
+
+
+/**
+ * @brief The Throttle class limits the number of executed instructions per
+ * second.
+ *
+ * The virtual machine executes the instructions in slices and calls
+ * endSlice() after each slice. The throttle sleeps until the time at which
+ * the slice is due. The time is measured from the start, so the error of a
+ * single sleep does not accumulate.
+ */
+class Throttle
+{
+public:
+  Throttle();
+
+  /**
+   * @brief Sets the target speed.
+   * @param ips instructions per second or 0 for unlimited speed
+   */
+  void setRate(uint32_t ips);
+
+  uint32_t getRate() const;
+
+  /**
+   * @brief Checks if the speed is limited.
+   * @return true if a rate is set
+   */
+  bool isActive() const;
+
+  /**
+   * @brief Gets the number of instructions to execute before endSlice()
+   * must be called.
+   * @return the number of instructions per slice
+   */
+  uint32_t getSliceSize() const;
+
+  /**
+   * @brief Starts pacing at the current time.
+   */
+  void start();
+
+  /**
+   * @brief Accounts for a slice of executed instructions and sleeps until it
+   * is due.
+   */
+  void endSlice();
+
+private:
+  uint32_t rate;
+  uint32_t sliceSize;
+  std::chrono::steady_clock::time_point origin;
+  uint64_t executed;
+};
+
+
+
+#endif // THROTTLE_H
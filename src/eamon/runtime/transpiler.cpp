@@ -0,0 +1,207 @@
+/********************************************************************************
+ *                                                                              *
+ * EamonInterpreter - BASIC to C++ transpiler                                   *
+ *                                                                              *
+ * modified: 2026-10-16                                                         *
+ *                                                                              *
+ ********************************************************************************
+ * Copyright (C) Harald Braeuning                                               *
+ ********************************************************************************
+ * This file is part of EamonInterpreter.                                       *
+ * EamonInterpreter is free software: you can redistribute it and/or modify it  *
+ * under the terms of the GNU General Public License as published by the Free   *
+ * Software Foundation, either version 3 of the License, or (at your option)    *
+ * any later version.                                                           *
+ * EamonInterpreter is distributed in the hope that it will be useful, but      *
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY   *
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for  *
+ * more details.                                                                *
+ * You should have received a copy of the GNU General Public License along with *
+ * EamonInterpreter. If not, see <https://www.gnu.org/licenses/>.               *
+ ********************************************************************************/
+
+
+#include "transpiler.h"
+#include "disassembler.h"
+#include "nativemodule.h"
+#include "op.h"
+#include <iostream>
+#include <set>
+
+
+
+Transpiler::Transpiler():
+  os(&std::cout)
+{
+}
+
+Transpiler::Transpiler(std::ostream& os):
+  os(&os)
+{
+}
+
+void Transpiler::setOutputStream(std::ostream &s)
+{
+  os = &s;
+}
+
+void Transpiler::transpile(Executable* x, const std::string& hash)
+{
+  std::shared_ptr<const DecodedCode> code = x->getDecodedCode();
+  const int32_t size = code->getSize();
+  /* instructions the module jumps to or resumes with */
+  std::vector<bool> entries = getEntries(*code);
+  *os << "/* Native module generated by EamonInterpreter - do not edit */" << std::endl;
+  *os << "#include <stdint.h>" << std::endl << std::endl;
+  *os << "typedef int32_t (*Function)(void* vm, int32_t index);" << std::endl << std::endl;
+  *os << "extern \"C\" int32_t eamon_module_abi() { return " << NATIVE_MODULE_ABI << "; }" << std::endl << std::endl;
+  *os << "extern \"C\" const char* eamon_module_hash() { return \"" << hash << "\"; }" << std::endl << std::endl;
+  *os << "extern \"C\" int32_t eamon_module_run(void* vm, const Function* api, int32_t start)" << std::endl;
+  *os << "{" << std::endl;
+  *os << "  int32_t n = start;" << std::endl;
+  *os << "  goto dispatch;" << std::endl;
+  std::set<uint32_t> lines;
+  for (int32_t i=0;i<size;i++)
+  {
+    const Instruction* in = code->getInstruction(i);
+    if (in->op == ASM_LINE && lines.insert(in->arg).second) *os << "/* line " << in->arg << " */" << std::endl;
+    if (entries[static_cast<size_t>(i)]) *os << "L" << i << ":" << std::endl;
+    writeInstruction(*code,i);
+  }
+  *os << "dispatch:" << std::endl;
+  *os << "  switch (n)" << std::endl;
+  *os << "  {" << std::endl;
+  *os << "    case -1: return -1;" << std::endl;
+  for (int32_t i=0;i<size;i++)
+  {
+    if (entries[static_cast<size_t>(i)]) *os << "    case " << i << ": goto L" << i << ";" << std::endl;
+  }
+  *os << "  }" << std::endl;
+  *os << "  return api[" << NativeModule::IllegalJump << "](vm,n);" << std::endl;
+  *os << "}" << std::endl;
+}
+
+
+
+std::vector<bool> Transpiler::getEntries(const DecodedCode& code)
+{
+  const int32_t size = code.getSize();
+  std::vector<bool> entries(static_cast<size_t>(size),false);
+  entries[0] = true;
+  for (int32_t i=0;i<size;i++)
+  {
+    const Instruction* in = code.getInstruction(i);
+    if (in->target != nullptr) entries[static_cast<size_t>(code.getIndex(in->target))] = true;
+    if ((in->op == OP_JSR || in->op == OP_CALL) && i+1 < size) entries[static_cast<size_t>(i+1)] = true;
+    if (in->op == OP_END) entries[static_cast<size_t>(i)] = true;
+  }
+  return entries;
+}
+
+void Transpiler::writeInstruction(const DecodedCode& code, int32_t index)
+{
+  const Instruction* in = code.getInstruction(index);
+  std::string name = Disassembler::getMnemonicName(in->op);
+  /* the module returns to the virtual machine at safepoints if a pause was requested */
+  std::string safepoint = "api[" + std::to_string(NativeModule::Safepoint) + "](vm,0)";
+  std::string target = "{ n = -2; goto dispatch; }";
+  if (in->target != nullptr)
+  {
+    std::string t = std::to_string(code.getIndex(in->target));
+    if (in->safepoint)
+      target = "{ if (" + safepoint + ") return " + t + "; goto L" + t + "; }";
+    else
+      target = "goto L" + t + ";";
+  }
+  switch (in->op)
+  {
+    case OP_NOP:
+      break;
+    case OP_PUSH:
+      writeCall(NativeModule::Push,index,name);
+      break;
+    case OP_RCL:
+      writeCall(NativeModule::Recall,index,name);
+      break;
+    case OP_STO:
+      writeCall(NativeModule::Store,index,name);
+      break;
+    case OP_ARIADD:
+    case OP_ARISUB:
+    case OP_ARIMUL:
+    case OP_ARIDIV:
+    case OP_ARIMOD:
+    case OP_ADDI:
+    case OP_SUBI:
+    case OP_MULI:
+    case OP_DIVI:
+    case OP_ADDD:
+    case OP_SUBD:
+    case OP_MULD:
+    case OP_DIVD:
+    case OP_CONCAT:
+      writeCall(NativeModule::Arithmetic,index,name);
+      break;
+    case OP_ARIEQ:
+    case OP_ARINE:
+    case OP_ARIGE:
+    case OP_ARILE:
+    case OP_ARIGT:
+    case OP_ARILT:
+    case OP_EQN:
+    case OP_NEN:
+    case OP_GEN:
+    case OP_LEN:
+    case OP_GTN:
+    case OP_LTN:
+      writeCall(NativeModule::Compare,index,name);
+      break;
+    case ASM_LINE:
+      writeCall(NativeModule::Line,index,name + " " + std::to_string(in->arg));
+      break;
+    case OP_JUMP:
+      *os << "  " << target << std::endl;
+      break;
+    case OP_JZ:
+      *os << "  if (api[" << NativeModule::PopInt << "](vm,0) == 0) " << target << std::endl;
+      break;
+    case OP_JNZ:
+      *os << "  if (api[" << NativeModule::PopInt << "](vm,0) != 0) " << target << std::endl;
+      break;
+    case OP_JSR:
+      writeCall(NativeModule::PushInt,index+1,"return address");
+      *os << "  " << target << std::endl;
+      break;
+    case OP_RET:
+      *os << "  n = api[" << NativeModule::PopInt << "](vm,0);" << std::endl;
+      *os << "  if (" << safepoint << ") return n;" << std::endl;
+      *os << "  goto dispatch;" << std::endl;
+      break;
+    case OP_END:
+      *os << "  return api[" << NativeModule::Execute << "](vm," << index << "); /* " << name << " */" << std::endl;
+      break;
+    case OP_CALL:
+      /* may terminate the program */
+      *os << "  n = api[" << NativeModule::Execute << "](vm," << index << "); /* " << name << " */" << std::endl;
+      *os << "  if (n != " << index+1 << ") goto dispatch;" << std::endl;
+      *os << "  if (" << safepoint << ") return " << index+1 << ";" << std::endl;
+      break;
+    case OP_NEXT:
+    case OP_CMPJZ:
+      /* may jump */
+      *os << "  n = api[" << NativeModule::Execute << "](vm," << index << "); /* " << name << " */" << std::endl;
+      if (in->safepoint)
+        *os << "  if (n != " << index+1 << ") { if (" << safepoint << ") return n; goto dispatch; }" << std::endl;
+      else
+        *os << "  if (n != " << index+1 << ") goto dispatch;" << std::endl;
+      break;
+    default:
+      writeCall(NativeModule::Execute,index,name);
+      break;
+  }
+}
+
+void Transpiler::writeCall(int32_t slot, int32_t arg, const std::string& comment)
+{
+  *os << "  api[" << slot << "](vm," << arg << "); /* " << comment << " */" << std::endl;
+}
@@ -0,0 +1,79 @@
+/********************************************************************************
+ *                                                                              *
+ * EamonInterpreter - BASIC to C++ transpiler                                   *
+ *                                                                              *
+ * modified: 2026-10-16                                                         *
+ *                                                                              *
+ ********************************************************************************
+ * Copyright (C) Harald Braeuning                                               *
+ ********************************************************************************
+ * This file is part of EamonInterpreter.                                       *
+ * EamonInterpreter is free software: you can redistribute it and/or modify it  *
+ * under the terms of the GNU General Public License as published by the Free   *
+ * Software Foundation, either version 3 of the License, or (at your option)    *
+ * any later version.                                                           *
+ * EamonInterpreter is distributed in the hope that it will be useful, but      *
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY   *
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for  *
+ * more details.                                                                *
+ * You should have received a copy of the GNU General Public License along with *
+ * EamonInterpreter. If not, see <https://www.gnu.org/licenses/>.               *
+ ********************************************************************************/
+
+
+#ifndef TRANSPILER_H
+#define TRANSPILER_H
+
+#include "executable.h"
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+
+/**
+ * @brief The Transpiler class translates the code of an executable into the
+ * C++ source of a native module.
+ *
+ * Each decoded instruction becomes a call through the function table of the
+ * NativeModule. Only the instructions jumped to or resumed with get a label;
+ * a comment marks the start of each BASIC line. Jumps, subroutine calls and
+ * returns are translated into gotos, so the module needs no dispatch loop.
+ * The entry function continues at any instruction the virtual machine may
+ * resume with through a switch.
+ */
+class Transpiler
+{
+public:
+  Transpiler();
+  Transpiler(std::ostream& s);
+
+  void setOutputStream(std::ostream& s);
+
+  /**
+   * @brief Writes the source of the module.
+   * @param x the executable
+   * @param hash the hash of the executable
+   */
+  void transpile(Executable* x, const std::string& hash);
+
+  /**
+   * @brief Finds the instructions a module can be entered at.
+   *
+   * These are the first instruction, the targets of jumps, the instructions
+   * following a subroutine or library call and OP_END.
+   * @param code the decoded code
+   * @return a flag for each instruction
+   */
+  static std::vector<bool> getEntries(const DecodedCode& code);
+
+private:
+  void writeInstruction(const DecodedCode& code, int32_t index);
+  void writeCall(int32_t slot, int32_t arg, const std::string& comment);
+
+  std::ostream* os;
+};
+
+
+
+#endif // TRANSPILER_H
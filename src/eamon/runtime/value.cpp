@@ -21,9 +21,10 @@
  ********************************************************************************/
 
 #include "value.h"
+#include "numberformat.h"
 #include <cmath>
-#include <sstream>
 #include <algorithm>
+#include <cstring>
 #include <stdexcept>
 
 
@@ -31,28 +32,33 @@
 Value::Value()
 {
   type = INVALID;
-  i = 0;
-  d = 0;
-  s = "";
+  shortLength = 0;
+  bits = 0;
 }
 
 Value::Value(int32_t v)
 {
   type = INT32;
+  shortLength = 0;
+  bits = 0;
   i = v;
 }
 
 Value::Value(double v)
 {
   type = DOUBLE;
+  shortLength = 0;
   d = v;
 }
 
 Value::Value(const std::string& v)
 {
-  type = STRING;
-  i = 0;
-  s = v;
+  assignString(v.data(),static_cast<uint32_t>(v.size()));
+}
+
+Value::Value(const char* s, uint32_t length)
+{
+  assignString(s,length);
 }
 
 bool Value::isValid() const
@@ -62,7 +68,7 @@ bool Value::isValid() const
 
 bool Value::isNumeric() const
 {
-  return type != STRING;
+  return type < STRING;
 }
 
 int32_t Value::getInt() const
@@ -74,7 +80,10 @@ int32_t Value::getInt() const
     case DOUBLE:
       return static_cast<int32_t>(round(d));
     case STRING:
-      return !s.empty() ? std::stoi(s) : 0;
+    case SHORTSTRING:
+      return NumberFormat::scanInt(getChars(),getLength());
+    case INVALID:
+      break;
   }
   return 0;
 }
@@ -88,45 +97,49 @@ double Value::getDouble() const
     case DOUBLE:
       return d;
     case STRING:
-      return !s.empty() ? std::stoi(s) : 0;
+    case SHORTSTRING:
+      return NumberFormat::scan(getChars(),getLength());
+    case INVALID:
+      break;
   }
   return 0;
 }
 
 std::string Value::getString() const
 {
-  std::ostringstream os;
   switch (type)
   {
     case INT32:
-      os << i;
-      return os.str();
+      return NumberFormat::toString(i);
     case DOUBLE:
-      os << d;
-      return os.str();
+      return NumberFormat::toString(d);
     case STRING:
-      return s;
+    case SHORTSTRING:
+      return std::string(getChars(),getLength());
+    case INVALID:
       break;
   }
-  return s;
+  return "";
 }
 
 void Value::set(int32_t v)
 {
+  if (type == STRING) StringHeap::release(str);
   type = INT32;
   i = v;
 }
 
 void Value::set(double v)
 {
+  if (type == STRING) StringHeap::release(str);
   type = DOUBLE;
   d = v;
 }
 
 void Value::set(const std::string& v)
 {
-  type = STRING;
-  s = v;
+  if (type == STRING) StringHeap::release(str);
+  assignString(v.data(),static_cast<uint32_t>(v.size()));
 }
 
 void Value::negate()
@@ -140,8 +153,11 @@ void Value::negate()
       d *= -1;
       break;
     case STRING:
+    case SHORTSTRING:
       throw std::runtime_error("illegal string operation");
       break;
+    case INVALID:
+      break;
   }
 }
 
@@ -156,8 +172,11 @@ void Value::dec()
       d--;
       break;
     case STRING:
+    case SHORTSTRING:
       throw std::runtime_error("illegal string operation");
       break;
+    case INVALID:
+      break;
   }
 }
 
@@ -172,8 +191,11 @@ void Value::inc()
       d++;
       break;
     case STRING:
+    case SHORTSTRING:
       throw std::runtime_error("illegal string operation");
       break;
+    case INVALID:
+      break;
   }
 }
 
@@ -188,22 +210,101 @@ void Value::opnot()
       throw std::runtime_error("logical not not ddefined for double values");
       break;
     case STRING:
+    case SHORTSTRING:
       throw std::runtime_error("illegal string operation");
       break;
+    case INVALID:
+      break;
   }
 }
 
+/*
+ * The characters to append are fetched after extending the string, which
+ * may move them.
+ */
+void Value::append(const Value& v)
+{
+  if (type != STRING || !v.isString())
+  {
+    concat(v);
+    return;
+  }
+  uint32_t length = v.getLength();
+  if (length == 0) return;
+  char* text = StringHeap::extend(str,length);
+  memcpy(text,v.getChars(),length);
+}
+
+void Value::stringify()
+{
+  char buffer[NUMBERFORMAT_BUFFER_SIZE];
+  if (type == INT32)
+    assignString(buffer,NumberFormat::format(i,buffer));
+  else if (type == DOUBLE)
+    assignString(buffer,NumberFormat::format(d,buffer));
+  else if (type == INVALID)
+    assignString("",0);
+}
+
+void Value::substring(uint32_t start, uint32_t length)
+{
+  stringify();
+  uint32_t n = getLength();
+  if (start >= n)
+  {
+    clear();
+    return;
+  }
+  length = std::min(length,n - start);
+  if (length == n) return;
+  if (type == SHORTSTRING)
+  {
+    memmove(shortText,shortText + start,length);
+    memset(shortText + length,0,VALUE_SHORT_STRING_LENGTH + 1 - length);
+    shortLength = length;
+  }
+  else if (length <= VALUE_SHORT_STRING_LENGTH)
+  {
+    StringData* d = str;
+    assignString(d->chars() + start,length);
+    StringHeap::release(d);
+  }
+  else
+  {
+    setString(StringHeap::slice(str,start,length));
+  }
+}
+
+void Value::materialize()
+{
+  if (type == STRING) StringHeap::materialize(str);
+}
+
 void Value::clear()
 {
-  i = 0;
-  d = 0;
-  s = "";
+  if (type == STRING)
+  {
+    StringHeap::release(str);
+    type = SHORTSTRING;
+  }
+  shortLength = 0;
+  bits = 0;
+}
+
+void Value::pin()
+{
+  if (type == STRING) StringHeap::pin(str);
+}
+
+void Value::unpin()
+{
+  if (type == STRING) StringHeap::unpin(str);
 }
 
 nlohmann::json Value::toJson() const
 {
   nlohmann::json j;
-  j["type"] = static_cast<int>(type);
+  j["type"] = static_cast<int>(type == SHORTSTRING ? STRING : type);
   switch (type)
   {
     case INT32:
@@ -213,7 +314,10 @@ nlohmann::json Value::toJson() const
       j["d"] = d;
       break;
     case STRING:
-      j["s"] = s;
+    case SHORTSTRING:
+      j["s"] = getString();
+      break;
+    case INVALID:
       break;
   }
   return j;
@@ -231,7 +335,10 @@ Value& Value::operator+=(const Value &v)
       d = getDouble() + v.getDouble();
       break;
     case STRING:
-      set(getString()+v.getString());
+    case SHORTSTRING:
+      concat(v);
+      return *this;
+    case INVALID:
       break;
   }
   type = r;
@@ -250,8 +357,11 @@ Value& Value::operator-=(const Value &v)
       d = getDouble() - v.getDouble();
       break;
     case STRING:
+    case SHORTSTRING:
       throw std::runtime_error("illegal string operation");
       break;
+    case INVALID:
+      break;
   }
   type = r;
   return *this;
@@ -269,8 +379,11 @@ Value& Value::operator*=(const Value &v)
       d = getDouble() * v.getDouble();
       break;
     case STRING:
+    case SHORTSTRING:
       throw std::runtime_error("illegal string operation");
       break;
+    case INVALID:
+      break;
   }
   type = r;
   return *this;
@@ -288,8 +401,11 @@ Value& Value::operator/=(const Value &v)
       d = getDouble() / v.getDouble();
       break;
     case STRING:
+    case SHORTSTRING:
       throw std::runtime_error("illegal string operation");
       break;
+    case INVALID:
+      break;
   }
   type = r;
   return *this;
@@ -307,8 +423,11 @@ Value& Value::operator%=(const Value &v)
       throw std::runtime_error("illegal modulo not defined for double values");
       break;
     case STRING:
+    case SHORTSTRING:
       throw std::runtime_error("illegal string operation");
       break;
+    case INVALID:
+      break;
   }
   type = r;
   return *this;
@@ -326,8 +445,11 @@ Value& Value::operator|=(const Value &v)
       throw std::runtime_error("bitwise or not defined for double values");
       break;
     case STRING:
+    case SHORTSTRING:
       throw std::runtime_error("illegal string operation");
       break;
+    case INVALID:
+      break;
   }
   type = r;
   return *this;
@@ -345,8 +467,11 @@ Value& Value::operator&=(const Value &v)
       throw std::runtime_error("bitwise and not defined for double values");
       break;
     case STRING:
+    case SHORTSTRING:
       throw std::runtime_error("illegal string operation");
       break;
+    case INVALID:
+      break;
   }
   type = r;
   return *this;
@@ -357,12 +482,108 @@ Value& Value::operator&=(const Value &v)
 
 Value::ValueType Value::getResultType(ValueType t)
 {
-  if (type == ValueType::INVALID) return t;
-  if (t == ValueType::INVALID) return type;
-  int32_t r = std::max(static_cast<int32_t>(type),static_cast<int32_t>(t));
+  ValueType self = type == SHORTSTRING ? STRING : type;
+  if (t == SHORTSTRING) t = STRING;
+  if (self == ValueType::INVALID) return t;
+  if (t == ValueType::INVALID) return self;
+  int32_t r = std::max(static_cast<int32_t>(self),static_cast<int32_t>(t));
   return static_cast<ValueType>(r);
 }
 
+void Value::setString(StringData* v)
+{
+  if (type == STRING) StringHeap::release(str);
+  type = STRING;
+  shortLength = 0;
+  str = v;
+}
+
+const char* Value::getText(char* buffer, uint32_t& length) const
+{
+  switch (type)
+  {
+    case INT32:
+      length = NumberFormat::format(i,buffer);
+      return buffer;
+    case DOUBLE:
+      length = NumberFormat::format(d,buffer);
+      return buffer;
+    case STRING:
+    case SHORTSTRING:
+      length = getLength();
+      return getChars();
+    case INVALID:
+      break;
+  }
+  length = 0;
+  return "";
+}
+
+int Value::compareText(const Value& lhs, const Value& rhs)
+{
+  char buffer1[NUMBERFORMAT_BUFFER_SIZE];
+  char buffer2[NUMBERFORMAT_BUFFER_SIZE];
+  uint32_t l1;
+  uint32_t l2;
+  const char* s1 = lhs.getText(buffer1,l1);
+  const char* s2 = rhs.getText(buffer2,l2);
+  int c = memcmp(s1,s2,std::min(l1,l2));
+  if (c != 0) return c;
+  return l1 < l2 ? -1 : l1 > l2 ? 1 : 0;
+}
+
+void Value::assignString(const char* s, uint32_t length)
+{
+  if (length <= VALUE_SHORT_STRING_LENGTH)
+  {
+    type = SHORTSTRING;
+    shortLength = length;
+    bits = 0;
+    memcpy(shortText,s,length);
+  }
+  else
+  {
+    type = STRING;
+    shortLength = 0;
+    str = StringHeap::allocate(s,length);
+  }
+}
+
+/*
+ * The characters are fetched after the allocation, which may move them.
+ */
+void Value::concat(const Value& v)
+{
+  if (!isString() || !v.isString())
+  {
+    set(getString()+v.getString());
+    return;
+  }
+  uint32_t l1 = getLength();
+  uint32_t l2 = v.getLength();
+  /* strings are immutable, so appending to an empty string shares the other */
+  if (l2 == 0) return;
+  if (l1 == 0)
+  {
+    *this = v;
+    return;
+  }
+  if (l1 + l2 <= VALUE_SHORT_STRING_LENGTH)
+  {
+    char s[VALUE_SHORT_STRING_LENGTH];
+    memcpy(s,getChars(),l1);
+    memcpy(s+l1,v.getChars(),l2);
+    if (type == STRING) StringHeap::release(str);
+    assignString(s,l1+l2);
+    return;
+  }
+  char* text;
+  StringData* d = StringHeap::allocate(l1+l2,text);
+  memcpy(text,getChars(),l1);
+  memcpy(text+l1,v.getChars(),l2);
+  setString(d);
+}
+
 
 std::vector<Value> Value::values(const std::vector<int32_t>& list)
 {
@@ -404,7 +625,10 @@ Value Value::fromJson(const nlohmann::json &j)
     case DOUBLE:
       return Value(j.at("d").get<double>());
     case STRING:
+    case SHORTSTRING:
       return Value(j.at("s").get<std::string>());
+    case INVALID:
+      break;
   }
   return Value();
 }
@@ -24,15 +24,31 @@
 #define VALUE_H
 
 #include "../nlohmann/json.h"
+#include "stringheap.h"
 #include "type.h"
 #include <stdint.h>
+#include <cstring>
+#include <functional>
 #include <string>
 #include <vector>
 #include <memory>
 #include <stdexcept>
 
+/* longest string stored in the value itself */
+#define VALUE_SHORT_STRING_LENGTH 7
 
 
+
+/**
+ * @brief A value in the virtual machine.
+ *
+ * A value is a 16 byte tagged union of the type and an int32, a double or a
+ * string. Strings up to VALUE_SHORT_STRING_LENGTH characters are stored in
+ * the value itself; longer strings are immutable blocks in the StringHeap,
+ * which copies of the value share by counting a reference. A substring may
+ * be a slice of another string, which is materialized when it is stored in
+ * a variable.
+ */
 class Value
 {
 public:
@@ -40,11 +56,53 @@ public:
   Value(int32_t v);
   Value(double v);
   Value(const std::string& v);
+  Value(const char* s, uint32_t length);
+  Value(const Value& v);
+  Value(Value&& v) noexcept;
+  ~Value();
+
+  Value& operator=(const Value& v);
+
+  Value& operator=(Value&& v) noexcept;
 
   bool isValid() const;
 
   bool isNumeric() const;
 
+  /**
+   * @brief Checks if this is an int32 value.
+   * @return true if this is an int32 value
+   */
+  bool isInt() const;
+
+  /**
+   * @brief Checks if this is a double value.
+   * @return true if this is a double value
+   */
+  bool isDouble() const;
+
+  /**
+   * @brief Checks if this is a string value.
+   * @return true if this is a string value
+   */
+  bool isString() const;
+
+  /**
+   * @brief Returns the characters of a string value without copying them.
+   *
+   * The pointer is valid until the value changes or the next string is
+   * allocated, which may compact the string heap. The characters of a slice
+   * are not terminated, so always use getLength().
+   * @return the characters or nullptr if this is no string
+   */
+  const char* getChars() const;
+
+  /**
+   * @brief Returns the number of characters of a string value.
+   * @return the length or 0 if this is no string
+   */
+  uint32_t getLength() const;
+
   int32_t getInt() const;
 
   double getDouble() const;
@@ -65,8 +123,58 @@ public:
 
   void opnot();
 
+  /**
+   * @brief Appends the text of a value to this string.
+   *
+   * Unlike operator+=, a string which is not shared is extended in place
+   * with room to grow, so appending repeatedly does not copy the whole
+   * string each time.
+   * @param v the value to append
+   */
+  void append(const Value& v);
+
+  /**
+   * @brief Replaces a number by its text as Applesoft prints it.
+   *
+   * Strings are not changed, an invalid value becomes the empty string.
+   */
+  void stringify();
+
+  /**
+   * @brief Replaces the value by a part of its text.
+   *
+   * A number is converted like by stringify() first. A part longer than
+   * VALUE_SHORT_STRING_LENGTH characters shares the characters of the
+   * string (see StringHeap::slice()), so nothing is copied.
+   * @param start position of the first character
+   * @param length maximum number of characters
+   */
+  void substring(uint32_t start, uint32_t length);
+
+  /**
+   * @brief Gives a slice characters of its own.
+   *
+   * Called before a string is stored for long, so it does not keep its
+   * parent alive.
+   */
+  void materialize();
+
   void clear();
 
+  /**
+   * @brief Pins the string of this value.
+   *
+   * Copies of a pinned string do not count references, so the string can be
+   * shared by threads. The owner must unpin() it before the value is
+   * destroyed and must outlive all copies.
+   */
+  void pin();
+
+  /**
+   * @brief Reverts pin(), so the value owns its string again.
+   */
+  void unpin();
+
   nlohmann::json toJson() const;
 
   Value& operator+=(const Value& v);
@@ -93,8 +201,36 @@ public:
 
   static Value fromJson(const nlohmann::json& j);
 
+  /**
+   * @brief Compares two values.
+   *
+   * Two int32 values are compared as integers, other numbers as doubles.
+   * If one of the values is a string, the texts are compared byte wise; a
+   * number is formatted into a local buffer for this, so comparing never
+   * allocates.
+   * @param lhs the left value
+   * @param rhs the right value
+   * @param cmp the comparison, e.g. std::less<>()
+   * @return the result of the comparison
+   */
+  template<typename Cmp> static bool compare(const Value& lhs, const Value& rhs, Cmp cmp);
+
+  /**
+   * @brief Checks two values for equality.
+   *
+   * Strings of different length are unequal without looking at their
+   * characters.
+   * @param lhs the left value
+   * @param rhs the right value
+   * @return true if the values are equal
+   */
+  static bool equals(const Value& lhs, const Value& rhs);
+
 private:
-  enum ValueType { INVALID, INT32, DOUBLE, STRING };
+  friend class Jit; /* generates native code working on the value layout */
+
+  /* STRING refers to the string heap, SHORTSTRING is stored in the value */
+  enum ValueType { INVALID, INT32, DOUBLE, STRING, SHORTSTRING };
 
   /*
    * Get the resulting type of an operation between this value's type
@@ -102,14 +238,145 @@ private:
    */
   ValueType getResultType(ValueType t);
 
+  /*
+   * Replaces this value by a string taking over the reference
+   */
+  void setString(StringData* v);
+
+  /*
+   * Stores a string in this value, which must not hold a string of the heap
+   */
+  void assignString(const char* s, uint32_t length);
+
+  void concat(const Value& v);
+
+  /*
+   * The numeric value of a number; 0 for an invalid value
+   */
+  double toNumber() const;
+
+  /*
+   * Returns the text of the value; a number is formatted into the buffer of
+   * NUMBERFORMAT_BUFFER_SIZE characters and an invalid value is empty
+   */
+  const char* getText(char* buffer, uint32_t& length) const;
+
+  /*
+   * Three way comparison of the texts of two values
+   */
+  static int compareText(const Value& lhs, const Value& rhs);
+
   ValueType type;
+  uint32_t shortLength; /* length of a SHORTSTRING */
   union {
     int32_t i;
     double d;
+    StringData* str;
+    char shortText[VALUE_SHORT_STRING_LENGTH+1];
+    uint64_t bits; /* copies the payload of any type */
   };
-  std::string s;
 };
 
+static_assert(sizeof(Value) == 16,"a value must fit into 16 bytes");
+
+inline Value::Value(const Value& v):
+  type(v.type),
+  shortLength(v.shortLength),
+  bits(v.bits)
+{
+  if (type == STRING) StringHeap::retain(str);
+}
+
+inline Value::Value(Value&& v) noexcept:
+  type(v.type),
+  shortLength(v.shortLength),
+  bits(v.bits)
+{
+  if (type == STRING) v.type = INVALID;
+}
+
+inline Value::~Value()
+{
+  if (type == STRING) StringHeap::release(str);
+}
+
+inline Value& Value::operator=(const Value& v)
+{
+  if (v.type == STRING) StringHeap::retain(v.str);
+  if (type == STRING) StringHeap::release(str);
+  type = v.type;
+  shortLength = v.shortLength;
+  bits = v.bits;
+  return *this;
+}
+
+inline Value& Value::operator=(Value&& v) noexcept
+{
+  if (this != &v)
+  {
+    if (type == STRING) StringHeap::release(str);
+    type = v.type;
+    shortLength = v.shortLength;
+    bits = v.bits;
+    if (type == STRING) v.type = INVALID;
+  }
+  return *this;
+}
+
+inline bool Value::isInt() const
+{
+  return type == INT32;
+}
+
+inline bool Value::isDouble() const
+{
+  return type == DOUBLE;
+}
+
+inline bool Value::isString() const
+{
+  return type >= STRING;
+}
+
+inline const char* Value::getChars() const
+{
+  if (type == SHORTSTRING) return shortText;
+  if (type == STRING) return str->chars();
+  return nullptr;
+}
+
+inline uint32_t Value::getLength() const
+{
+  if (type == SHORTSTRING) return shortLength;
+  if (type == STRING) return str->length;
+  return 0;
+}
+
+inline double Value::toNumber() const
+{
+  return type == DOUBLE ? d : type == INT32 ? i : 0;
+}
+
+template<typename Cmp> inline bool Value::compare(const Value& lhs, const Value& rhs, Cmp cmp)
+{
+  if (lhs.type == INT32 && rhs.type == INT32) return cmp(lhs.i,rhs.i);
+  if (lhs.type < STRING && rhs.type < STRING) return cmp(lhs.toNumber(),rhs.toNumber());
+  return cmp(compareText(lhs,rhs),0);
+}
+
+inline bool Value::equals(const Value& lhs, const Value& rhs)
+{
+  if (lhs.type == INT32 && rhs.type == INT32) return lhs.i == rhs.i;
+  if (lhs.type < STRING && rhs.type < STRING) return lhs.toNumber() == rhs.toNumber();
+  /* short strings are padded with zeros */
+  if (lhs.type == SHORTSTRING && rhs.type == SHORTSTRING) return lhs.shortLength == rhs.shortLength && lhs.bits == rhs.bits;
+  if (lhs.type == STRING && rhs.type == STRING)
+  {
+    return lhs.str->length == rhs.str->length && (lhs.str == rhs.str || memcmp(lhs.str->chars(),rhs.str->chars(),lhs.str->length) == 0);
+  }
+  return compareText(lhs,rhs) == 0;
+}
+
 inline Value operator+(Value lhs, const Value& rhs)
 {
   lhs += rhs;
@@ -154,38 +421,32 @@ inline Value operator&(Value lhs, const Value& rhs)
 
 inline bool operator<(const Value& lhs, const Value& rhs)
 {
-  if (lhs.isNumeric() && rhs.isNumeric()) return lhs.getDouble() < rhs.getDouble();
-  return lhs.getString() < rhs.getString();
+  return Value::compare(lhs,rhs,std::less<>());
 }
 
 inline bool operator<=(const Value& lhs, const Value& rhs)
 {
-  if (lhs.isNumeric() && rhs.isNumeric()) return lhs.getDouble() <= rhs.getDouble();
-  return lhs.getString() <= rhs.getString();
+  return Value::compare(lhs,rhs,std::less_equal<>());
 }
 
 inline bool operator==(const Value& lhs, const Value& rhs)
 {
-  if (lhs.isNumeric() && rhs.isNumeric()) return lhs.getDouble() == rhs.getDouble();
-  return lhs.getString() == rhs.getString();
+  return Value::equals(lhs,rhs);
 }
 
 inline bool operator!=(const Value& lhs, const Value& rhs)
 {
-  if (lhs.isNumeric() && rhs.isNumeric()) return lhs.getDouble() != rhs.getDouble();
-  return lhs.getString() != rhs.getString();
+  return !Value::equals(lhs,rhs);
 }
 
 inline bool operator>(const Value& lhs, const Value& rhs)
 {
-  if (lhs.isNumeric() && rhs.isNumeric()) return lhs.getDouble() > rhs.getDouble();
-  return lhs.getString() > rhs.getString();
+  return Value::compare(lhs,rhs,std::greater<>());
 }
 
 inline bool operator>=(const Value& lhs, const Value& rhs)
 {
-  if (lhs.isNumeric() && rhs.isNumeric()) return lhs.getDouble() >= rhs.getDouble();
-  return lhs.getString() >= rhs.getString();
+  return Value::compare(lhs,rhs,std::greater_equal<>());
 }
 
 inline bool operator&&(const Value& lhs, const Value& rhs)
@@ -0,0 +1,293 @@
+/********************************************************************************
+ *                                                                              *
+ * EamonInterpreter - stack verifier                                            *
+ *                                                                              *
+ * modified: 2026-10-16                                                         *
+ *                                                                              *
+ ********************************************************************************
+ * Copyright (C) Harald Braeuning                                               *
+ ********************************************************************************
+ * This file is part of EamonInterpreter.                                       *
+ * EamonInterpreter is free software: you can redistribute it and/or modify it  *
+ * under the terms of the GNU General Public License as published by the Free   *
+ * Software Foundation, either version 3 of the License, or (at your option)    *
+ * any later version.                                                           *
+ * EamonInterpreter is distributed in the hope that it will be useful, but      *
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY   *
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for  *
+ * more details.                                                                *
+ * You should have received a copy of the GNU General Public License along with *
+ * EamonInterpreter. If not, see <https://www.gnu.org/licenses/>.               *
+ ********************************************************************************/
+
+#include "verifier.h"
+#include "library.h"
+#include "op.h"
+#include <algorithm>
+
+
+
+/* entry of a stack shape holding a value; other entries are return addresses */
+static const int32_t VALUE = -1;
+
+Verifier::Verifier(const DecodedCode& code):
+  code(code),
+  entered(static_cast<size_t>(code.getSize()),false),
+  shapes(static_cast<size_t>(code.getSize())),
+  states(0),
+  maxDepth(0)
+{
+  entered[static_cast<size_t>(code.getIndex(code.getStart()))] = true;
+  for (int32_t i=0;i<code.getSize();i++)
+  {
+    const Instruction* in = code.getInstruction(i);
+    if (in->target != nullptr) entered[static_cast<size_t>(code.getIndex(in->target))] = true;
+    if (in->op == OP_JSR) entered[static_cast<size_t>(i+1)] = true; /* return address */
+  }
+}
+
+std::shared_ptr<const Verifier::Verdict> Verifier::verify(const DecodedCode& code)
+{
+  std::shared_ptr<Verdict> v = std::make_shared<Verdict>();
+  Verifier verifier(code);
+  v->verified = verifier.run();
+  v->maxDepth = v->verified ? verifier.maxDepth : 0;
+  v->reason = verifier.reason;
+  return v;
+}
+
+bool Verifier::run()
+{
+  if (!reach(code.getIndex(code.getStart()),std::vector<int32_t>())) return false;
+  while (!work.empty())
+  {
+    State state = std::move(work.back());
+    work.pop_back();
+    const int32_t i = state.index;
+    std::vector<int32_t>& stack = state.stack;
+    const Instruction& in = *code.getInstruction(i);
+    if (in.op == OP_JSR)
+    {
+      stack.push_back(i+1);
+      maxDepth = std::max(maxDepth,static_cast<uint32_t>(stack.size()));
+      if (in.target != nullptr && !reach(code.getIndex(in.target),stack)) return false;
+      continue;
+    }
+    if (in.op == OP_RET)
+    {
+      if (stack.empty()) continue; /* RETURN without GOSUB */
+      int32_t ret = stack.back();
+      if (ret == VALUE) return fail(i,"return to an unknown address");
+      stack.pop_back();
+      if (!reach(ret,stack)) return false;
+      continue;
+    }
+    if (in.op == OP_DUP || in.op == OP_SWAP)
+    {
+      /* keep track of the return addresses moved by user defined functions */
+      size_t n = in.op == OP_DUP ? 1 : 2;
+      if (stack.size() < n) return fail(i,"stack underflow");
+      if (in.op == OP_DUP)
+        stack.push_back(stack.back());
+      else
+        std::swap(stack[stack.size()-1],stack[stack.size()-2]);
+    }
+    else
+    {
+      int32_t pop;
+      int32_t push;
+      if (!getEffect(i,pop,push)) return false;
+      if (stack.size() < static_cast<size_t>(pop)) return fail(i,"stack underflow");
+      stack.resize(stack.size()-static_cast<size_t>(pop));
+      stack.insert(stack.end(),static_cast<size_t>(push),VALUE);
+    }
+    switch (in.op)
+    {
+      case OP_END:
+        break;
+      case OP_JUMP:
+        if (in.target != nullptr && !reach(code.getIndex(in.target),stack)) return false;
+        break;
+      case OP_JZ:
+      case OP_JNZ:
+      case OP_NEXT:
+      case OP_CMPJZ:
+        if (in.target != nullptr && !reach(code.getIndex(in.target),stack)) return false;
+        if (!reach(i+1,stack)) return false;
+        break;
+      default:
+        if (!reach(i+1,stack)) return false;
+        break;
+    }
+  }
+  return true;
+}
+
+bool Verifier::reach(int32_t index, const std::vector<int32_t>& stack)
+{
+  if (stack.size() > VERIFIER_MAX_DEPTH) return fail(index,"stack too deep");
+  std::set<std::vector<int32_t>>& seen = shapes[static_cast<size_t>(index)];
+  if (seen.find(stack) != seen.end()) return true;
+  for (const std::vector<int32_t>& shape : seen)
+  {
+    if (shape.size() < stack.size() && std::equal(shape.begin(),shape.end(),stack.begin()) && isRepeated(shape,stack))
+      return fail(index,"stack grows in a loop");
+  }
+  seen.insert(stack);
+  if (++states > VERIFIER_MAX_STATES) return fail(index,"too many states");
+  maxDepth = std::max(maxDepth,static_cast<uint32_t>(stack.size()));
+  work.push_back(State{index,stack});
+  return true;
+}
+
+/*
+ * The stack grew from shape to stack and all return addresses on top are
+ * already in shape: a subroutine was called again before it returned, e.g.
+ * because it left with GOTO. The same path grows the stack once more, so
+ * the exploration would only end at VERIFIER_MAX_DEPTH.
+ */
+bool Verifier::isRepeated(const std::vector<int32_t>& shape, const std::vector<int32_t>& stack)
+{
+  for (size_t i=shape.size();i<stack.size();i++)
+  {
+    if (stack[i] != VALUE && std::find(shape.begin(),shape.end(),stack[i]) == shape.end()) return false;
+  }
+  return true;
+}
+
+/*
+ * The effects mirror the handlers of the virtual machine. OP_JSR, OP_RET,
+ * OP_DUP and OP_SWAP are handled by run().
+ */
+bool Verifier::getEffect(int32_t index, int32_t& pop, int32_t& push)
+{
+  const Instruction& in = *code.getInstruction(index);
+  pop = 0;
+  push = 0;
+  switch (in.op)
+  {
+    case OP_NOP:
+    case OP_INC:
+    case OP_DEC:
+    case OP_CLR:
+    case OP_ERRHDL:
+    case OP_NEXT:
+    case OP_ARISTO:
+    case OP_CMPJZ:
+    case OP_JUMP:
+    case OP_END:
+    case ASM_LINE:
+      break;
+    case OP_PUSH:
+      if (in.constant != nullptr) return fail(index,"array on the stack");
+      if (in.value != nullptr) push = 1;
+      break;
+    case OP_POP:
+    case OP_RSZ:
+    case OP_APPEND:
+    case OP_JZ:
+    case OP_JNZ:
+      pop = 1;
+      break;
+    case OP_STO:
+    case OP_STOI:
+      if (in.type.isArrayType()) return fail(index,"array on the stack");
+      pop = in.op == OP_STOI ? 2 : 1;
+      break;
+    case OP_RCL:
+    case OP_RCLI:
+      if (in.constant == nullptr && in.type.isArrayType()) return fail(index,"array on the stack");
+      pop = in.op == OP_RCLI ? 1 : 0;
+      push = 1;
+      break;
+    case OP_STOI2:
+      pop = 3;
+      break;
+    case OP_RCLI2:
+      pop = 2;
+      push = 1;
+      break;
+    case OP_ARIADD:
+    case OP_ARISUB:
+    case OP_ARIMUL:
+    case OP_ARIDIV:
+    case OP_ARIMOD:
+    case OP_ADDI:
+    case OP_SUBI:
+    case OP_MULI:
+    case OP_DIVI:
+    case OP_ADDD:
+    case OP_SUBD:
+    case OP_MULD:
+    case OP_DIVD:
+    case OP_CONCAT:
+    case OP_ARIEQ:
+    case OP_ARINE:
+    case OP_ARIGE:
+    case OP_ARILE:
+    case OP_ARIGT:
+    case OP_ARILT:
+    case OP_EQN:
+    case OP_NEN:
+    case OP_GEN:
+    case OP_LEN:
+    case OP_GTN:
+    case OP_LTN:
+    case OP_ARIAND:
+    case OP_ARIOR:
+    case OP_AND:
+    case OP_OR:
+      pop = 2;
+      push = 1;
+      break;
+    case OP_NEG:
+    case OP_ARINOT:
+      pop = 1;
+      push = 1;
+      break;
+    case OP_CAST:
+      if (in.type == Type::int32Type || in.type == Type::doubleType || in.type == Type::stringType)
+      {
+        pop = 1;
+        push = 1;
+      }
+      break;
+    case OP_CALL:
+      return getCallEffect(index,pop,push);
+    default:
+      return fail(index,"unknown op code");
+  }
+  return true;
+}
+
+/*
+ * Functions with a variable number of arguments take the argument count from
+ * the stack. It is only known if the compiler pushed it as an immediate value
+ * in the instructions right before the call and no jump enters between them.
+ */
+bool Verifier::getCallEffect(int32_t index, int32_t& pop, int32_t& push)
+{
+  uint16_t id = static_cast<uint16_t>(code.getInstruction(index)->arg);
+  int32_t position = Library::getArgumentCountPosition(id);
+  int32_t narg = 0;
+  if (position > 0)
+  {
+    if (index < position) return fail(index,"unknown argument count");
+    for (int32_t i=index-position;i<index;i++)
+    {
+      const Instruction& p = *code.getInstruction(i);
+      if (p.op != OP_PUSH || p.value == nullptr || entered[static_cast<size_t>(i+1)]) return fail(index,"unknown argument count");
+    }
+    const Value* count = code.getInstruction(index-position)->value;
+    if (!count->isInt()) return fail(index,"unknown argument count");
+    narg = count->getInt();
+  }
+  if (!Library::getStackEffect(id,narg,pop,push)) return fail(index,"unknown library function");
+  return true;
+}
+
+bool Verifier::fail(int32_t index, const std::string& msg)
+{
+  reason = msg + " at " + std::to_string(code.getInstruction(index)->pc);
+  return false;
+}
@@ -0,0 +1,109 @@
+/********************************************************************************
+ *                                                                              *
+ * EamonInterpreter - stack verifier                                            *
+ *                                                                              *
+ * modified: 2026-10-16                                                         *
+ *                                                                              *
+ ********************************************************************************
+ * Copyright (C) Harald Braeuning                                               *
+ ********************************************************************************
+ * This file is part of EamonInterpreter.                                       *
+ * EamonInterpreter is free software: you can redistribute it and/or modify it  *
+ * under the terms of the GNU General Public License as published by the Free   *
+ * Software Foundation, either version 3 of the License, or (at your option)    *
+ * any later version.                                                           *
+ * EamonInterpreter is distributed in the hope that it will be useful, but      *
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY   *
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for  *
+ * more details.                                                                *
+ * You should have received a copy of the GNU General Public License along with *
+ * EamonInterpreter. If not, see <https://www.gnu.org/licenses/>.               *
+ ********************************************************************************/
+
+#ifndef VERIFIER_H
+#define VERIFIER_H
+
+#include "decodedcode.h"
+#include <stdint.h>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+
+
+/* maximum stack depth accepted by the verifier */
+#define VERIFIER_MAX_DEPTH 64
+/* maximum number of states the verifier explores before it gives up */
+#define VERIFIER_MAX_STATES 200000
+
+/**
+ * @brief The Verifier class proves the stack effects of decoded code.
+ *
+ * Starting at the entry with an empty stack, the verifier follows all paths
+ * through the code. For each instruction it records the shapes of the stack
+ * it is reached with: the depth and which entries are return addresses pushed
+ * by OP_JSR. OP_RET continues at the return address on top of the stack, so
+ * subroutines are followed for each chain of callers, and POP followed by a
+ * GOTO leaves a subroutine like on the Apple II. Code loops through the same
+ * shapes, hence the exploration ends.
+ *
+ * The code is verified if no path pops from an empty stack, OP_RET always
+ * finds a return address and the depth stays below VERIFIER_MAX_DEPTH.
+ * Recursion, arrays passed on the stack and library calls with an unknown
+ * argument count fail the verification, since their depth is only known at
+ * run time. OP_RET on an empty stack ends a path: the virtual machine always
+ * checks this pop and throws.
+ *
+ * The verdict holds for an execution which starts at the entry with an empty
+ * stack and is not interrupted by an error.
+ */
+class Verifier
+{
+public:
+  /**
+   * @brief The result of the verification.
+   */
+  struct Verdict
+  {
+    bool verified;      /**< the code never leaves the stack range */
+    uint32_t maxDepth;  /**< maximum number of values on the stack */
+    std::string reason; /**< why the verification failed */
+  };
+
+  /**
+   * @brief Verifies the stack effects of the decoded code.
+   * @param code the decoded code
+   * @return the verdict
+   */
+  static std::shared_ptr<const Verdict> verify(const DecodedCode& code);
+
+private:
+  explicit Verifier(const DecodedCode& code);
+
+  bool run();
+  bool reach(int32_t index, const std::vector<int32_t>& stack);
+  static bool isRepeated(const std::vector<int32_t>& shape, const std::vector<int32_t>& stack);
+  bool getEffect(int32_t index, int32_t& pop, int32_t& push);
+  bool getCallEffect(int32_t index, int32_t& pop, int32_t& push);
+  bool fail(int32_t index, const std::string& msg);
+
+  /* a pending instruction and the shape of the stack it is reached with */
+  struct State
+  {
+    int32_t index;
+    std::vector<int32_t> stack;
+  };
+
+  const DecodedCode& code;
+  std::vector<bool> entered; /* instructions reached other than from the preceding one */
+  std::vector<std::set<std::vector<int32_t>>> shapes; /* stack shapes seen at each instruction */
+  std::vector<State> work;
+  uint32_t states;
+  uint32_t maxDepth;
+  std::string reason;
+};
+
+
+
+#endif // VERIFIER_H
@@ -25,24 +25,39 @@
 #include "address.h"
 #include "inputstream.h"
 #include "outputstream.h"
+#include "transpiler.h"
 #include <string.h>
-#include <unistd.h>
 #include <sstream>
 #include <iostream>
 #include <algorithm>
+#include <iterator>
 
 
 
 VM::VM(std::shared_ptr<InputStream>& sin, std::shared_ptr<OutputStream>& sout):
   executable(nullptr),
+  uncheckedStack(false),
+  uncheckedStackEnabled(true),
+  ip(nullptr),
+  userPause(false),
   os(sout),
   is(sin),
-  errorHandler(0),
-  slowdown(0)
+  errorHandler(nullptr),
+  budget(0),
+  dispatchMode(isThreadedDispatchAvailable() ? ThreadedDispatch : SwitchDispatch),
+  backend(StackBackend),
+  rip(nullptr),
+  jitEnabled(false),
+  jitVerification(false)
 {
   library = std::make_unique<Library>(is,os);
 }
 
+VM::~VM()
+{
+  if (moduleBuild) moduleBuild->cancel();
+}
+
 void VM::clearStack()
 {
   stack.clear();
@@ -50,18 +65,43 @@ void VM::clearStack()
 
 void VM::load(std::shared_ptr<Executable> x)
 {
+  /* drop all values before the executable: they may share its pinned string
+   * constants; the collection reclaims the slices of the constants */
+  stack.clear();
+  registers.clear();
+  setupGlobal(0);
+  strings.collect();
   currentLine = 0;
   executable = x;
+  registerCode.reset();
+  rip = nullptr;
+  uncheckedStack = false;
+  nativeModule.reset();
+  if (moduleBuild) moduleBuild->cancel();
+  moduleBuild.reset();
+  moduleEntries.clear();
   if (executable)
   {
-    cptr = executable->getCode();
-    cptr++; /* skip OP_ENTRY */
-    uint32_t numSize = *cptr++;
-    setupGlobal(numSize);
+    program = executable->getDecodedCode();
+    stackVerdict = executable->getStackVerdict();
+    ip = program->getStart();
+    setupGlobal(program->getGlobalSize());
+    if (!nativeModuleDirectory.empty() && NativeModule::isAvailable())
+    {
+      nativeModule = NativeModule::find(executable.get(),nativeModuleDirectory);
+      if (!nativeModule)
+      {
+        /* interpret until the module is built; the end of the build stops the loop at the next safepoint */
+        moduleEntries = Transpiler::getEntries(*program);
+        moduleBuild = NativeModule::build(executable.get(),nativeModuleDirectory,[this]() { requestPause = true; });
+      }
+    }
   }
   else
   {
-    cptr = nullptr;
+    program.reset();
+    stackVerdict.reset();
+    ip = nullptr;
   }
 }
 
@@ -74,10 +114,12 @@ void VM::run()
 {
   if (isExecutableLoaded())
   {
-    errorHandler = 0;
-    cptr = executable->getCode();
-    cptr += 2;
+    errorHandler = nullptr;
+    ip = program->getStart();
+    rip = nullptr;
     stack.clear();
+    uncheckedStack = stackVerdict->verified && uncheckedStackEnabled;
+    if (uncheckedStack) stack.reserve(stackVerdict->maxDepth);
     loop();
   }
 }
@@ -90,22 +132,33 @@ void VM::run(std::shared_ptr<Executable> x)
 
 void VM::pause()
 {
+  userPause = true;
   requestPause = true;
 }
 
 bool VM::isPaused() const
 {
-  return (requestPause && cptr != nullptr && COp::getMnemonic(*cptr) != OP_END);
+  return (userPause && ip != nullptr && ip->op != OP_END);
 }
 
 void VM::resume()
 {
-  if (cptr != nullptr && COp::getMnemonic(*cptr) != OP_END)
+  if (ip != nullptr && ip->op != OP_END)
   {
     loop();
   }
 }
 
+/*
+ * The caller gets a string of its own, as the strings of the program are
+ * confined to the thread running it or pinned by the executable.
+ */
+static Value detach(const Value& v)
+{
+  StringHeap::Scope scope(nullptr);
+  return v.isString() ? Value(v.getString()) : v;
+}
+
 Value VM::getValue(Symbol::SymbolType type, const std::string& name, int32_t index)
 {
   if (!isExecutableLoaded()) return Value();
@@ -116,9 +169,9 @@ Value VM::getValue(Symbol::SymbolType type, const std::string& name, int32_t ind
   switch (type)
   {
     case Symbol::VARIABLE:
-      return mem.getValue(addr,index);
+      return detach(mem.getValue(addr,index));
     case Symbol::CONSTANT:
-      return executable->getConstant(addr,index);
+      return detach(executable->getConstant(addr,index));
     default:
       return Value();
   }
@@ -126,12 +179,121 @@ Value VM::getValue(Symbol::SymbolType type, const std::string& name, int32_t ind
 
 void VM::setSlowdown(uint32_t microseconds)
 {
-  slowdown = microseconds;
+  setInstructionRate(microseconds > 0 ? 1000000 / microseconds : 0);
 }
 
 uint32_t VM::getSlowdown() const
 {
-  return slowdown;
+  return throttle.isActive() ? 1000000 / throttle.getRate() : 0;
+}
+
+void VM::setInstructionRate(uint32_t ips)
+{
+  throttle.setRate(ips);
+}
+
+uint32_t VM::getInstructionRate() const
+{
+  return throttle.getRate();
+}
+
+void VM::setDispatchMode(DispatchMode mode)
+{
+  dispatchMode = mode;
+}
+
+VM::DispatchMode VM::getDispatchMode() const
+{
+  return dispatchMode;
+}
+
+void VM::setBackend(Backend b)
+{
+  backend = b;
+}
+
+VM::Backend VM::getBackend() const
+{
+  return backend;
+}
+
+void VM::setJitEnabled(bool flag)
+{
+  jitEnabled = flag;
+}
+
+bool VM::isJitEnabled() const
+{
+  return jitEnabled;
+}
+
+void VM::setJitVerification(bool flag)
+{
+  jitVerification = flag;
+}
+
+bool VM::isJitVerification() const
+{
+  return jitVerification;
+}
+
+bool VM::isJitAvailable()
+{
+  return Jit::isAvailable();
+}
+
+void VM::setNativeModuleDirectory(const std::string& dir)
+{
+  nativeModuleDirectory = dir;
+}
+
+const std::string& VM::getNativeModuleDirectory() const
+{
+  return nativeModuleDirectory;
+}
+
+bool VM::hasNativeModule() const
+{
+  return nativeModule != nullptr;
+}
+
+bool VM::isStackVerified() const
+{
+  return stackVerdict && stackVerdict->verified;
+}
+
+void VM::setUncheckedStackEnabled(bool flag)
+{
+  uncheckedStackEnabled = flag;
+}
+
+bool VM::isUncheckedStackEnabled() const
+{
+  return uncheckedStackEnabled;
+}
+
+bool VM::isThreadedDispatchAvailable()
+{
+#ifdef EAMON_THREADED_DISPATCH
+  return true;
+#else
+  return false;
+#endif
+}
+
+void VM::setProfile(std::shared_ptr<OpProfile> p)
+{
+  profile = p;
+}
+
+std::shared_ptr<OpProfile> VM::getProfile() const
+{
+  return profile;
+}
+
+const StringHeap& VM::getStringHeap() const
+{
+  return strings;
 }
 
 void VM::setDisk(const std::string &d)
@@ -155,6 +317,18 @@ const std::string& VM::getChainedFile()
 
 
 
+Memory::Checkpoint VM::checkpoint()
+{
+  StringHeap::Scope scope(&strings);
+  return mem.checkpoint();
+}
+
+void VM::restore(const Memory::Checkpoint& c)
+{
+  StringHeap::Scope scope(&strings);
+  mem.restore(c);
+}
+
 void VM::setupGlobal(uint32_t numSize)
 {
   mem.reset(numSize);
@@ -167,325 +341,1115 @@ uint32_t VM::getVariableAddress(const std::string& name)
   return 0xFFFFFFFF;
 }
 
-void VM::pushArray(uint32_t addr, Type /*type*/)
+void VM::pushArray(const std::vector<Value>& values)
 {
-  std::vector<Value> values = executable->getConstantArray(addr);
   for (const Value& v : values) stack.push(v);
   stack.push(static_cast<int32_t>(values.size()));
 }
 
 void VM::loop(int depth)
 {
+  StringHeap::Scope scope(&strings);
   try
   {
+    userPause = false;
     requestPause = false;
-    while (!requestPause && cptr != nullptr)
+    throttle.start();
+    budget = throttle.getSliceSize();
+    bool again = true;
+    while (again)
     {
-//      std::cout << static_cast<int64_t>(cptr-executable->getCode()) << " " << COp::getMnemonic(*cptr) << std::endl;
-      uint32_t op = *cptr++;
-      switch (COp::getMnemonic(op))
+      if (moduleBuild) enterModule();
+      if (nativeModule && !throttle.isActive() && !profile)
+        loopNative();
+      else if (backend == RegisterBackend)
+        loopRegister();
+      else if (uncheckedStack)
       {
-        case OP_PUSH:
-          opPush(op);
-          break;
-        case OP_POP:
-          opPop();
-          break;
-        case OP_STO:
-          opStore(op,false);
-          break;
-        case OP_RCL:
-          opRecall(op,false);
-          break;
-        case OP_STOI:
-          opStore(op,true);
-          break;
-        case OP_RCLI:
-          opRecall(op,true);
-          break;
-        case OP_DUP:
-          opDup();
-          break;
-        case OP_SWAP:
-          opSwap();
-          break;
-        case OP_ARIADD:
-        case OP_ARISUB:
-        case OP_ARIMUL:
-        case OP_ARIDIV:
-        case OP_ARIMOD:
-          opAri(op);
-          break;
-        case OP_CAST:
-          opCast(op);
-          break;
-        case OP_NEG:
-          opNeg(op);
-          break;
-        case OP_INC:
-          opInc();
-          break;
-        case OP_DEC:
-          opDec();
-          break;
-        case OP_ARIEQ:
-        case OP_ARINE:
-        case OP_ARIGE:
-        case OP_ARILE:
-        case OP_ARIGT:
-        case OP_ARILT:
-          opCmp(op);
-          break;
-        case OP_ARIAND:
-        case OP_ARIOR:
-          opBit(op);
-          break;
-        case OP_ARINOT:
-          opNot(op);
-          break;
-        case OP_AND:
-        case OP_OR:
-          opLogic(op);
-          break;
-        case OP_JSR:
-          stack.push(static_cast<int32_t>(cptr-executable->getCode()+1)); /* push address of next op */
-          cptr = executable->getCode() + *cptr;     /* jump to address */
-          break;
-        case OP_RET:
-          cptr = executable->getCode() + stack.pop().getInt(); /* get return address from stack */
-          break;
-        case OP_JZ:
-          if (stack.pop().getInt() == 0)
-            cptr = executable->getCode() + *cptr;
-          else
-            cptr++;
-          break;
-        case OP_JNZ:
-          if (stack.pop().getInt() != 0)
-            cptr = executable->getCode() + *cptr;
-          else
-            cptr++;
-          break;
-        case OP_JUMP:
-          cptr = executable->getCode() + *cptr;
-          break;
-        case OP_CALL:
-          opCall();
-          break;
-        case OP_CLR:
-          opClr(op);
-          break;
-        case OP_RSZ:
-          opRsz(op);
-          break;
-        case OP_ERRHDL:
-          errorHandler = *cptr++;
-          break;
-        case OP_END:
-          requestPause = true;
-          break;
-        case ASM_LINE:
-          currentLine = *cptr++;
-          break;
+        if (dispatchMode == ThreadedDispatch && !profile)
+          loopThreaded<false>();
+        else
+          loopSwitch<false>();
       }
-      if (slowdown > 0) usleep(slowdown);
+      else if (dispatchMode == ThreadedDispatch && !profile)
+        loopThreaded();
+      else
+        loopSwitch();
+      /* stopped for the module rather than by pause() */
+      again = !userPause && moduleBuild && moduleBuild->isFinished() && ip != nullptr && ip->op != OP_END;
     }
   }
+  catch (JitMismatch&)
+  {
+    throw;
+  }
   catch (std::exception& ex)
   {
-    if (errorHandler != 0 && depth < 1)
+    if (backend == RegisterBackend && rip != nullptr) ip = rip->source;
+    if (errorHandler != nullptr && depth < 1)
     {
-       cptr = executable->getCode() + errorHandler;
+       ip = errorHandler;
+       rip = nullptr;
+       uncheckedStack = false; /* the failed statement left its operands on the stack */
        loop(depth+1);
     }
     else
     {
+      uint32_t pc = ip != nullptr ? ip->pc : 0;
       std::ostringstream os;
       if (currentLine > 0)
-        os << "Runtime exception in line " << currentLine << " (@" << (cptr-executable->getCode()) << ")";
+        os << "Runtime exception in line " << currentLine << " (@" << pc << ")";
       else
-        os << "Runtime exception at " << (cptr-executable->getCode());
+        os << "Runtime exception at " << pc;
       os << ": " << ex.what();
       throw std::runtime_error(os.str());
     }
   }
 }
 
-void VM::opPush(uint32_t op)
+/*
+ * Switches to the native module once its build is finished. The module can
+ * only be entered at some instructions; elsewhere the loop is stopped again
+ * at the next safepoint.
+ */
+void VM::enterModule()
 {
-  Type type = COp::getType(op);
-  if (type == Type::int32Type)
+  if (!moduleBuild->isFinished()) return;
+  nativeModule = moduleBuild->getModule();
+  if (!nativeModule)
   {
-    int32_t v = static_cast<int32_t>(*cptr++);
-    stack.push(v);
+    moduleBuild.reset();
+    moduleEntries.clear();
+    requestPause = false;
   }
-  else if (type == Type::doubleType)
+  else if (ip != nullptr && ip->op != OP_END && moduleEntries[static_cast<size_t>(program->getIndex(ip))])
   {
-    double v = *(reinterpret_cast<const double*>(cptr));
-    cptr += 2;
-    stack.push(v);
+    rip = nullptr;
+    moduleBuild.reset();
+    moduleEntries.clear();
+    requestPause = false;
   }
-  else if (type == Type::stringType)
+  else
   {
-    stack.push(executable->getConstant(Address::getAddress(*cptr++)).getString());
+    nativeModule.reset();
+    requestPause = true;
   }
-  else if (type.isArrayType())
+}
+
+/*
+ * The throttle is only consulted once per slice of instructions.
+ */
+inline void VM::countInstruction()
+{
+  if (--budget == 0)
   {
-    pushArray(Address::getAddress(*cptr++),type);
+    throttle.endSlice();
+    budget = throttle.getSliceSize();
   }
 }
 
-void VM::opPop()
+template<bool checked> void VM::loopSwitch()
 {
-  stack.pop();
+  const bool throttled = throttle.isActive();
+  uint32_t previous = OP_ENTRY;
+  while (ip != nullptr)
+  {
+    const Instruction& in = *ip++;
+    uint64_t allocations = 0;
+    if (profile)
+    {
+      profile->count(previous,in.op);
+      previous = in.op;
+      allocations = strings.getStatistics().allocations;
+    }
+    execute<checked>(in);
+    if (profile) profile->countAllocations(in.op,strings.getStatistics().allocations-allocations);
+    if (throttled) countInstruction();
+    if (in.safepoint && requestPause.load(std::memory_order_relaxed)) break;
+  }
 }
 
-void VM::opAri(uint32_t op)
+template<bool checked> void VM::execute(const Instruction& in)
 {
-  Value v2 = stack.pop();
-  Value v1 = stack.pop();
-  switch (COp::getMnemonic(op))
+  switch (in.op)
   {
-    case OP_ARIADD:
-      stack.push(v1 + v2);
+    case OP_PUSH:
+      opPush<checked>(in);
       break;
-    case OP_ARISUB:
-      stack.push(v1 - v2);
+    case OP_POP:
+      opPop<checked>();
       break;
-    case OP_ARIMUL:
-      stack.push(v1 * v2);
+    case OP_STO:
+      opStore<checked>(in,false);
       break;
-    case OP_ARIDIV:
-      stack.push(v1 / v2);
+    case OP_RCL:
+      opRecall<checked>(in,false);
+      break;
+    case OP_STOI:
+      opStore<checked>(in,true);
+      break;
+    case OP_RCLI:
+      opRecall<checked>(in,true);
+      break;
+    case OP_STOI2:
+      opStore2<checked>(in);
       break;
+    case OP_RCLI2:
+      opRecall2<checked>(in);
+      break;
+    case OP_DUP:
+      opDup<checked>();
+      break;
+    case OP_SWAP:
+      opSwap<checked>();
+      break;
+    case OP_ARIADD:
+    case OP_ARISUB:
+    case OP_ARIMUL:
+    case OP_ARIDIV:
     case OP_ARIMOD:
-      stack.push(v1 % v2);
+      opAri<checked>(in);
+      break;
+    case OP_ADDI:
+    case OP_SUBI:
+    case OP_MULI:
+    case OP_DIVI:
+    case OP_ADDD:
+    case OP_SUBD:
+    case OP_MULD:
+    case OP_DIVD:
+    case OP_CONCAT:
+      opAriTyped<checked>(in);
+      break;
+    case OP_CAST:
+      opCast<checked>(in);
+      break;
+    case OP_NEG:
+      opNeg<checked>(in);
+      break;
+    case OP_INC:
+      opInc(in);
+      break;
+    case OP_APPEND:
+      opAppend<checked>(in);
+      break;
+    case OP_DEC:
+      opDec(in);
+      break;
+    case OP_ARIEQ:
+    case OP_ARINE:
+    case OP_ARIGE:
+    case OP_ARILE:
+    case OP_ARIGT:
+    case OP_ARILT:
+      opCmp<checked>(in);
+      break;
+    case OP_EQN:
+    case OP_NEN:
+    case OP_GEN:
+    case OP_LEN:
+    case OP_GTN:
+    case OP_LTN:
+      opCmpNumeric<checked>(in);
+      break;
+    case OP_ARIAND:
+    case OP_ARIOR:
+      opBit<checked>(in);
+      break;
+    case OP_ARINOT:
+      opNot<checked>(in);
+      break;
+    case OP_AND:
+    case OP_OR:
+      opLogic<checked>(in);
+      break;
+    case OP_JSR:
+      opJsr<checked>(in);
+      break;
+    case OP_RET:
+      opRet();
+      break;
+    case OP_JZ:
+      opJz<checked>(in);
+      break;
+    case OP_JNZ:
+      opJnz<checked>(in);
+      break;
+    case OP_JUMP:
+      opJump(in);
+      break;
+    case OP_CALL:
+      opCall(in);
+      break;
+    case OP_CLR:
+      opClr(in);
+      break;
+    case OP_RSZ:
+      opRsz<checked>(in);
+      break;
+    case OP_ERRHDL:
+      opErrHdl(in);
+      break;
+    case OP_NEXT:
+      opNext(in);
+      break;
+    case OP_ARISTO:
+      opAriSto(in);
+      break;
+    case OP_CMPJZ:
+      opCmpJz(in);
+      break;
+    case OP_END:
+      ip--; /* stay on the end op */
+      requestPause = true;
+      break;
+    case ASM_LINE:
+      opLine(in);
       break;
   }
 }
 
-void VM::opCmp(uint32_t op)
+/*
+ * Direct threaded dispatch: every handler jumps straight to the handler of
+ * the next op code through a table of label addresses (a GCC extension)
+ * instead of returning to a central switch. This saves the bounds check of
+ * the switch and gives the branch predictor one indirect jump per handler.
+ */
+template<bool checked> void VM::loopThreaded()
+{
+#ifdef EAMON_THREADED_DISPATCH
+  const bool throttled = throttle.isActive();
+  void* dispatch[256];
+  std::fill(std::begin(dispatch),std::end(dispatch),&&l_nop);
+  dispatch[OP_PUSH] = &&l_push;
+  dispatch[OP_POP] = &&l_pop;
+  dispatch[OP_STO] = &&l_sto;
+  dispatch[OP_STOI] = &&l_stoi;
+  dispatch[OP_RCL] = &&l_rcl;
+  dispatch[OP_RCLI] = &&l_rcli;
+  dispatch[OP_STOI2] = &&l_stoi2;
+  dispatch[OP_RCLI2] = &&l_rcli2;
+  dispatch[OP_DUP] = &&l_dup;
+  dispatch[OP_SWAP] = &&l_swap;
+  dispatch[OP_ARIADD] = &&l_ari;
+  dispatch[OP_ARISUB] = &&l_ari;
+  dispatch[OP_ARIMUL] = &&l_ari;
+  dispatch[OP_ARIDIV] = &&l_ari;
+  dispatch[OP_ARIMOD] = &&l_ari;
+  dispatch[OP_ADDI] = &&l_arit;
+  dispatch[OP_SUBI] = &&l_arit;
+  dispatch[OP_MULI] = &&l_arit;
+  dispatch[OP_DIVI] = &&l_arit;
+  dispatch[OP_ADDD] = &&l_arit;
+  dispatch[OP_SUBD] = &&l_arit;
+  dispatch[OP_MULD] = &&l_arit;
+  dispatch[OP_DIVD] = &&l_arit;
+  dispatch[OP_CONCAT] = &&l_arit;
+  dispatch[OP_CAST] = &&l_cast;
+  dispatch[OP_NEG] = &&l_neg;
+  dispatch[OP_INC] = &&l_inc;
+  dispatch[OP_APPEND] = &&l_append;
+  dispatch[OP_DEC] = &&l_dec;
+  dispatch[OP_ARIEQ] = &&l_cmp;
+  dispatch[OP_ARINE] = &&l_cmp;
+  dispatch[OP_ARILE] = &&l_cmp;
+  dispatch[OP_ARIGE] = &&l_cmp;
+  dispatch[OP_ARILT] = &&l_cmp;
+  dispatch[OP_ARIGT] = &&l_cmp;
+  dispatch[OP_EQN] = &&l_cmpn;
+  dispatch[OP_NEN] = &&l_cmpn;
+  dispatch[OP_LEN] = &&l_cmpn;
+  dispatch[OP_GEN] = &&l_cmpn;
+  dispatch[OP_LTN] = &&l_cmpn;
+  dispatch[OP_GTN] = &&l_cmpn;
+  dispatch[OP_ARIAND] = &&l_bit;
+  dispatch[OP_ARIOR] = &&l_bit;
+  dispatch[OP_ARINOT] = &&l_not;
+  dispatch[OP_OR] = &&l_logic;
+  dispatch[OP_AND] = &&l_logic;
+  dispatch[OP_JSR] = &&l_jsr;
+  dispatch[OP_RET] = &&l_ret;
+  dispatch[OP_JZ] = &&l_jz;
+  dispatch[OP_JUMP] = &&l_jump;
+  dispatch[OP_JNZ] = &&l_jnz;
+  dispatch[OP_CALL] = &&l_call;
+  dispatch[OP_RSZ] = &&l_rsz;
+  dispatch[OP_CLR] = &&l_clr;
+  dispatch[OP_ERRHDL] = &&l_errhdl;
+  dispatch[OP_NEXT] = &&l_next;
+  dispatch[OP_ARISTO] = &&l_aristo;
+  dispatch[OP_CMPJZ] = &&l_cmpjz;
+  dispatch[OP_END] = &&l_end;
+  dispatch[ASM_LINE] = &&l_line;
+
+  const Instruction* in;
+#define DISPATCH() \
+  do { \
+    if (throttled) countInstruction(); \
+    in = ip++; \
+    goto *dispatch[in->op]; \
+  } while (0)
+#define SAFEPOINT() \
+  do { \
+    if (in->safepoint && requestPause.load(std::memory_order_relaxed)) return; \
+  } while (0)
+
+  if (ip == nullptr) return;
+  in = ip++;
+  goto *dispatch[in->op];
+
+l_push:
+  opPush<checked>(*in);
+  DISPATCH();
+l_pop:
+  opPop<checked>();
+  DISPATCH();
+l_sto:
+  opStore<checked>(*in,false);
+  DISPATCH();
+l_stoi:
+  opStore<checked>(*in,true);
+  DISPATCH();
+l_rcl:
+  opRecall<checked>(*in,false);
+  DISPATCH();
+l_rcli:
+  opRecall<checked>(*in,true);
+  DISPATCH();
+l_stoi2:
+  opStore2<checked>(*in);
+  DISPATCH();
+l_rcli2:
+  opRecall2<checked>(*in);
+  DISPATCH();
+l_dup:
+  opDup<checked>();
+  DISPATCH();
+l_swap:
+  opSwap<checked>();
+  DISPATCH();
+l_ari:
+  opAri<checked>(*in);
+  DISPATCH();
+l_arit:
+  opAriTyped<checked>(*in);
+  DISPATCH();
+l_cast:
+  opCast<checked>(*in);
+  DISPATCH();
+l_neg:
+  opNeg<checked>(*in);
+  DISPATCH();
+l_inc:
+  opInc(*in);
+  DISPATCH();
+l_append:
+  opAppend<checked>(*in);
+  DISPATCH();
+l_dec:
+  opDec(*in);
+  DISPATCH();
+l_cmp:
+  opCmp<checked>(*in);
+  DISPATCH();
+l_cmpn:
+  opCmpNumeric<checked>(*in);
+  DISPATCH();
+l_bit:
+  opBit<checked>(*in);
+  DISPATCH();
+l_not:
+  opNot<checked>(*in);
+  DISPATCH();
+l_logic:
+  opLogic<checked>(*in);
+  DISPATCH();
+l_jsr:
+  opJsr<checked>(*in);
+  SAFEPOINT();
+  DISPATCH();
+l_ret:
+  opRet();
+  SAFEPOINT();
+  DISPATCH();
+l_jz:
+  opJz<checked>(*in);
+  SAFEPOINT();
+  DISPATCH();
+l_jnz:
+  opJnz<checked>(*in);
+  SAFEPOINT();
+  DISPATCH();
+l_jump:
+  opJump(*in);
+  SAFEPOINT();
+  DISPATCH();
+l_call:
+  opCall(*in);
+  if (ip == nullptr) return;
+  SAFEPOINT();
+  DISPATCH();
+l_rsz:
+  opRsz<checked>(*in);
+  DISPATCH();
+l_clr:
+  opClr(*in);
+  DISPATCH();
+l_errhdl:
+  opErrHdl(*in);
+  DISPATCH();
+l_next:
+  opNext(*in);
+  SAFEPOINT();
+  DISPATCH();
+l_aristo:
+  opAriSto(*in);
+  DISPATCH();
+l_cmpjz:
+  opCmpJz(*in);
+  SAFEPOINT();
+  DISPATCH();
+l_line:
+  opLine(*in);
+  DISPATCH();
+l_nop:
+  DISPATCH();
+l_end:
+  ip--; /* stay on the end op */
+  requestPause = true;
+#undef SAFEPOINT
+#undef DISPATCH
+#else
+  loopSwitch<checked>();
+#endif
+}
+
+/*
+ * Register machine: operands are taken directly from the variables, the
+ * constants and the registers. All instructions which still need the stack
+ * are executed by the handlers of the stack machine. If such a handler
+ * changes the instruction pointer, execution continues at the corresponding
+ * register machine instruction.
+ */
+void VM::loopRegister()
 {
-  Value v2 = stack.pop();
-  Value v1 = stack.pop();
-  switch (COp::getMnemonic(op))
+  if (!registerCode)
   {
-    case OP_ARIEQ:
-      stack.push(v1 == v2 ? 1 : 0);
+    registerCode = executable->getRegisterCode();
+    registers.assign(registerCode->getRegisterCount(),Value());
+    if (jitEnabled && isJitAvailable())
+    {
+      if (!jit) jit = std::make_unique<Jit>();
+      jit->reset(registerCode,&mem,&registers,&currentLine);
+    }
+    else
+    {
+      jit.reset();
+    }
+  }
+  if (rip == nullptr)
+  {
+    if (ip == nullptr) return;
+    rip = registerCode->getInstruction(ip);
+  }
+  const bool throttled = throttle.isActive();
+  Value ta;
+  Value tb;
+  while (true)
+  {
+    const RegisterInstruction* in = rip++;
+    if (!executeRegister(*in,ta,tb)) return;
+    if (in->source->safepoint && requestPause.load(std::memory_order_relaxed)) break;
+    if (throttled)
+      countInstruction();
+    else if (jit && rip != in + 1)
+      runJit();
+  }
+  ip = rip->source;
+}
+
+/*
+ * Returns false if the program ended. ta and tb hold the operands converted
+ * by fetch().
+ */
+inline bool VM::executeRegister(const RegisterInstruction& in, Value& ta, Value& tb)
+{
+  switch (in.op)
+  {
+    case ROP_STACK:
+      ip = in.source + 1;
+      execute(*in.source);
+      if (ip != in.source + 1)
+      {
+        if (ip == nullptr)
+        {
+          rip = nullptr;
+          return false;
+        }
+        rip = registerCode->getInstruction(ip);
+      }
       break;
-    case OP_ARINE:
-      stack.push(v1 != v2 ? 1 : 0);
+    case ROP_PUSH:
+      stack.push(fetch(in.a,ta));
       break;
-    case OP_ARIGE:
-      stack.push(v1 >= v2 ? 1 : 0);
+    case ROP_MOVE:
+      registers[in.dst] = fetch(in.a,ta);
       break;
-    case OP_ARILE:
-      stack.push(v1 <= v2 ? 1 : 0);
+    case ROP_ARI:
+    {
+      const Value& b = fetch(in.b,tb);
+      registers[in.dst] = calculate(in.subop,fetch(in.a,ta),b);
       break;
-    case OP_ARIGT:
-      stack.push(v1 > v2 ? 1 : 0);
+    }
+    case ROP_CMP:
+    {
+      const Value& b = fetch(in.b,tb);
+      registers[in.dst] = Value(compare(in.subop,fetch(in.a,ta),b) ? 1 : 0);
       break;
-    case OP_ARILT:
-      stack.push(v1 < v2 ? 1 : 0);
+    }
+    case ROP_STO:
+      storeScalar(fetch(in.a,ta),in.dst,0,in.type);
+      break;
+    case ROP_JZ:
+      if (fetch(in.a,ta).getInt() == 0) jump(in);
+      break;
+    case ROP_JNZ:
+      if (fetch(in.a,ta).getInt() != 0) jump(in);
       break;
   }
+  return true;
 }
 
-void VM::opBit(uint32_t op)
+/*
+ * Runs compiled blocks as long as there is one for the next instruction.
+ * A block returns the instruction to continue with, which is its first
+ * instruction if the block could not execute it.
+ */
+void VM::runJit()
 {
-  Value v2 = stack.pop();
-  Value v1 = stack.pop();
-  Value v;
-  switch (COp::getMnemonic(op))
+  while (!requestPause.load(std::memory_order_relaxed))
   {
-    case OP_ARIAND:
-      v = (v1 & v2);
-      break;
-    case OP_ARIOR:
-      v = (v1 | v2);
+    Jit::Block block = jit->getBlock(rip);
+    if (block == nullptr) return;
+    const RegisterInstruction* next = jitVerification ? runVerified(block) : block();
+    if (next == rip) return;
+    rip = next;
+  }
+}
+
+/* a compiled block must produce the same type, not only an equal value */
+static bool isIdentical(const Value& a, const Value& b)
+{
+  return a.isInt() == b.isInt() && a.isDouble() == b.isDouble() && a.isString() == b.isString() && Value::equals(a,b);
+}
+
+/*
+ * Runs the block, saves its results and puts the variables, the registers
+ * and the line back. Then the interpreter runs from the start of the block
+ * up to the instruction the block returned. If the block returned its start
+ * without any effect, it left at its first check and there is nothing to
+ * repeat. The results of the interpreter are kept.
+ */
+const RegisterInstruction* VM::runVerified(Jit::Block block)
+{
+  const RegisterInstruction* start = rip;
+  uint32_t size = program->getGlobalSize();
+  std::vector<Value> before;
+  before.reserve(size);
+  for (uint32_t addr=0;addr<size;addr++) before.push_back(mem.getScalarValue(addr));
+  std::vector<Value> registersBefore = registers;
+  uint32_t lineBefore = currentLine;
+  const RegisterInstruction* next = block();
+  std::vector<Value> after;
+  after.reserve(size);
+  bool changed = currentLine != lineBefore;
+  for (uint32_t addr=0;addr<size;addr++)
+  {
+    after.push_back(mem.getScalarValue(addr));
+    if (!isIdentical(after[addr],before[addr]))
+    {
+      *mem.getScalar(addr) = before[addr];
+      changed = true;
+    }
+  }
+  std::vector<Value> registersAfter = registers;
+  for (size_t i=0;i<registers.size();i++)
+  {
+    if (!isIdentical(registersAfter[i],registersBefore[i])) changed = true;
+  }
+  uint32_t lineAfter = currentLine;
+  registers = registersBefore;
+  currentLine = lineBefore;
+  if (next != start || changed)
+  {
+    Value ta;
+    Value tb;
+    int32_t n = 0;
+    do
+    {
+      const RegisterInstruction* in = rip++;
+      executeRegister(*in,ta,tb);
+      n++;
+    }
+    while (rip != next && n < JIT_MAX_BLOCK_LENGTH);
+  }
+  std::ostringstream error;
+  if (rip != next)
+    error << "continues at " << (next - registerCode->getStart()) << " instead of " << (rip - registerCode->getStart());
+  else if (currentLine != lineAfter)
+    error << "sets line " << lineAfter << " instead of " << currentLine;
+  for (uint32_t addr=0;addr<size && error.tellp()==0;addr++)
+  {
+    const Value& v = mem.getScalarValue(addr);
+    if (!isIdentical(after[addr],v))
+      error << "sets variable @" << addr << " to " << after[addr].getString() << " instead of " << v.getString();
+  }
+  for (size_t i=0;i<registers.size() && error.tellp()==0;i++)
+  {
+    if (!isIdentical(registersAfter[i],registers[i]))
+      error << "sets register " << i << " to " << registersAfter[i].getString() << " instead of " << registers[i].getString();
+  }
+  if (error.tellp() > 0)
+  {
+    std::ostringstream os;
+    os << "Compiled block at " << (start - registerCode->getStart()) << " in line " << lineBefore << " " << error.str();
+    throw JitMismatch(os.str());
+  }
+  rip = start;
+  return next;
+}
+
+/*
+ * Native module: the module runs the control flow itself and calls the
+ * handlers below for all other instructions. Like the dispatch loops, each
+ * handler sets the instruction pointer to the next instruction first, so
+ * that errors are reported and handled at the right place.
+ */
+void VM::loopNative()
+{
+  /* in the order of NativeModule::Api */
+  static const NativeModule::Function api[NativeModule::ApiSize] = {
+    &VM::nativeExecute,
+    &VM::nativePush,
+    &VM::nativeRecall,
+    &VM::nativeStore,
+    &VM::nativeArithmetic,
+    &VM::nativeCompare,
+    &VM::nativeLine,
+    &VM::nativePushInt,
+    &VM::nativePopInt,
+    &VM::nativeIllegalJump,
+    &VM::nativeSafepoint
+  };
+  int32_t next = nativeModule->run(this,api,program->getIndex(ip));
+  ip = next >= 0 ? program->getInstruction(next) : nullptr;
+}
+
+/*
+ * The module was generated from this very code (same hash), hence the index
+ * needs no range check.
+ */
+inline const Instruction& VM::enterNative(int32_t index)
+{
+  const Instruction* in = program->getStart() + index;
+  ip = in + 1;
+  return *in;
+}
+
+int32_t VM::nativeExecute(void* vm, int32_t index)
+{
+  VM* self = static_cast<VM*>(vm);
+  self->execute(self->enterNative(index));
+  return self->ip != nullptr ? self->program->getIndex(self->ip) : -1;
+}
+
+int32_t VM::nativePush(void* vm, int32_t index)
+{
+  VM* self = static_cast<VM*>(vm);
+  self->opPush(self->enterNative(index));
+  return 0;
+}
+
+int32_t VM::nativeRecall(void* vm, int32_t index)
+{
+  VM* self = static_cast<VM*>(vm);
+  self->opRecall(self->enterNative(index),false);
+  return 0;
+}
+
+int32_t VM::nativeStore(void* vm, int32_t index)
+{
+  VM* self = static_cast<VM*>(vm);
+  self->opStore(self->enterNative(index),false);
+  return 0;
+}
+
+int32_t VM::nativeArithmetic(void* vm, int32_t index)
+{
+  VM* self = static_cast<VM*>(vm);
+  self->opAriTyped(self->enterNative(index));
+  return 0;
+}
+
+int32_t VM::nativeCompare(void* vm, int32_t index)
+{
+  VM* self = static_cast<VM*>(vm);
+  self->opCmpNumeric(self->enterNative(index));
+  return 0;
+}
+
+int32_t VM::nativeLine(void* vm, int32_t index)
+{
+  VM* self = static_cast<VM*>(vm);
+  self->opLine(self->enterNative(index));
+  return 0;
+}
+
+int32_t VM::nativePushInt(void* vm, int32_t value)
+{
+  static_cast<VM*>(vm)->stack.push(value);
+  return 0;
+}
+
+int32_t VM::nativePopInt(void* vm, int32_t /*unused*/)
+{
+  return static_cast<VM*>(vm)->stack.pop().getInt();
+}
+
+int32_t VM::nativeIllegalJump(void* /*vm*/, int32_t /*index*/)
+{
+  throw std::runtime_error("Illegal jump target");
+}
+
+int32_t VM::nativeSafepoint(void* vm, int32_t /*unused*/)
+{
+  return static_cast<VM*>(vm)->requestPause.load(std::memory_order_relaxed) ? 1 : 0;
+}
+
+/*
+ * Stack operands must be fetched top first, i.e. operand b before operand a.
+ */
+inline const Value& VM::fetch(const Operand& o, Value& tmp)
+{
+  switch (o.kind)
+  {
+    case Operand::Global:
+      return mem.getScalarValue(o.index);
+    case Operand::Immediate:
+      return *o.value;
+    case Operand::Register:
+      return registers[o.index];
+    case Operand::Stack:
       break;
   }
-  stack.push(v);
+  tmp = stack.pop();
+  return tmp;
+}
+
+void VM::jump(const RegisterInstruction& in)
+{
+  if (in.target == nullptr) throw std::runtime_error("Illegal jump target");
+  rip = in.target;
+}
+
+template<bool checked> void VM::opPush(const Instruction& in)
+{
+  if (in.value != nullptr)
+    stack.push<checked>(*in.value);
+  else if (in.constant != nullptr)
+    pushArray(*in.constant);
+}
+
+template<bool checked> void VM::opPop()
+{
+  stack.pop<checked>();
+}
+
+template<bool checked> void VM::opAri(const Instruction& in)
+{
+  stack.reduce<checked>([this,&in](Value& v1, const Value& v2){ ariInPlace(in.op,v1,v2); });
 }
 
-void VM::opLogic(uint32_t op)
+template<bool checked> void VM::opAriTyped(const Instruction& in)
 {
-  Value v2 = stack.pop();
-  Value v1 = stack.pop();
-  bool v = false;
-  switch (COp::getMnemonic(op))
+  stack.reduce<checked>([this,&in](Value& v1, const Value& v2){ calculateInPlace(in.op,v1,v2); });
+}
+
+/*
+ * The arithmetic operations store the result in the first operand, so the
+ * operands on the stack are neither copied nor released and a string keeps
+ * its block when appending to it.
+ */
+void VM::ariInPlace(uint32_t op, Value& v1, const Value& v2)
+{
+  switch (op)
   {
-    case OP_AND:
-      v = (v1 && v2);
+    case OP_ARIADD:
+      v1 += v2;
+      return;
+    case OP_ARISUB:
+      v1 -= v2;
+      return;
+    case OP_ARIMUL:
+      v1 *= v2;
+      return;
+    case OP_ARIDIV:
+      v1 /= v2;
+      return;
+    case OP_ARIMOD:
+      v1 %= v2;
+      return;
+  }
+  throw std::runtime_error("Illegal arithmetic operation");
+}
+
+/*
+ * The type specialized operations fall back to the generic operation if the
+ * values do not have the expected types. A double operation requires two
+ * numbers with at least one double.
+ */
+static inline bool isDoubleOperation(const Value& v1, const Value& v2)
+{
+  return (v1.isDouble() && (v2.isDouble() || v2.isInt())) || (v1.isInt() && v2.isDouble());
+}
+
+void VM::calculateInPlace(uint32_t op, Value& v1, const Value& v2)
+{
+  switch (op)
+  {
+    case OP_ADDI:
+      if (v1.isInt() && v2.isInt()) return v1.set(v1.getInt() + v2.getInt());
       break;
-    case OP_OR:
-      v = (v1 || v2);
+    case OP_SUBI:
+      if (v1.isInt() && v2.isInt()) return v1.set(v1.getInt() - v2.getInt());
+      break;
+    case OP_MULI:
+      if (v1.isInt() && v2.isInt()) return v1.set(v1.getInt() * v2.getInt());
+      break;
+    case OP_DIVI:
+      if (v1.isInt() && v2.isInt()) return v1.set(v1.getInt() / v2.getInt());
+      break;
+    case OP_ADDD:
+      if (isDoubleOperation(v1,v2)) return v1.set(v1.getDouble() + v2.getDouble());
+      break;
+    case OP_SUBD:
+      if (isDoubleOperation(v1,v2)) return v1.set(v1.getDouble() - v2.getDouble());
+      break;
+    case OP_MULD:
+      if (isDoubleOperation(v1,v2)) return v1.set(v1.getDouble() * v2.getDouble());
+      break;
+    case OP_DIVD:
+      if (isDoubleOperation(v1,v2)) return v1.set(v1.getDouble() / v2.getDouble());
+      break;
+    case OP_CONCAT:
+      if (v1.isString() && v2.isString())
+      {
+        v1 += v2;
+        return;
+      }
       break;
   }
-  stack.push(static_cast<int32_t>(v));
+  ariInPlace(getGenericOp(op),v1,v2);
+}
+
+Value VM::calculate(uint32_t op, const Value& v1, const Value& v2)
+{
+  Value v(v1);
+  calculateInPlace(op,v,v2);
+  return v;
 }
 
-void VM::opNot(uint32_t /*op*/)
+template<bool checked> void VM::opCmp(const Instruction& in)
 {
-  Value v = stack.pop();
-  v.opnot();
-  stack.push(v);
+  stack.reduce<checked>([this,&in](Value& v1, const Value& v2){ v1.set(cmp(in.op,v1,v2) ? 1 : 0); });
 }
 
-void VM::opNeg(uint32_t /*op*/)
+template<bool checked> void VM::opCmpNumeric(const Instruction& in)
 {
-  Value v = stack.pop();
-  v.negate();
-  stack.push(v);
+  stack.reduce<checked>([this,&in](Value& v1, const Value& v2){ v1.set(compare(in.op,v1,v2) ? 1 : 0); });
 }
 
-void VM::opClr(uint32_t op)
+bool VM::cmp(uint32_t op, const Value& v1, const Value& v2)
 {
-  Type t = COp::getType(op);
-  uint32_t a = *cptr++;
-  int32_t addr = static_cast<int32_t>(Address::getAddress(a));
-  if (Address::isGlobalAddress(a))
-    mem.clr(Value::zero(t),addr);
+  switch (op)
+  {
+    case OP_ARIEQ:
+      return v1 == v2;
+    case OP_ARINE:
+      return v1 != v2;
+    case OP_ARIGE:
+      return v1 >= v2;
+    case OP_ARILE:
+      return v1 <= v2;
+    case OP_ARIGT:
+      return v1 > v2;
+    case OP_ARILT:
+      return v1 < v2;
+  }
+  throw std::runtime_error("Illegal comparison");
 }
 
-void VM::opRsz(uint32_t op)
+bool VM::compare(uint32_t op, const Value& v1, const Value& v2)
 {
-  Type t = COp::getType(op);
-  uint32_t a = *cptr++;
-  int32_t addr = static_cast<int32_t>(Address::getAddress(a));
-  uint32_t size = stack.pop().getInt();
-  if (Address::isGlobalAddress(a))
+  if (v1.isInt() && v2.isInt())
+  {
+    int32_t i1 = v1.getInt();
+    int32_t i2 = v2.getInt();
+    switch (op)
+    {
+      case OP_EQN:
+        return i1 == i2;
+      case OP_NEN:
+        return i1 != i2;
+      case OP_GEN:
+        return i1 >= i2;
+      case OP_LEN:
+        return i1 <= i2;
+      case OP_GTN:
+        return i1 > i2;
+      case OP_LTN:
+        return i1 < i2;
+    }
+  }
+  else if ((v1.isInt() || v1.isDouble()) && (v2.isInt() || v2.isDouble()))
   {
-    mem.resize(addr,size);
-    mem.clr(Value::zero(t),addr);
+    double d1 = v1.getDouble();
+    double d2 = v2.getDouble();
+    switch (op)
+    {
+      case OP_EQN:
+        return d1 == d2;
+      case OP_NEN:
+        return d1 != d2;
+      case OP_GEN:
+        return d1 >= d2;
+      case OP_LEN:
+        return d1 <= d2;
+      case OP_GTN:
+        return d1 > d2;
+      case OP_LTN:
+        return d1 < d2;
+    }
   }
+  return cmp(getGenericOp(op),v1,v2);
+}
+
+uint32_t VM::getGenericOp(uint32_t op)
+{
+  switch (op)
+  {
+    case OP_ADDI:
+    case OP_ADDD:
+    case OP_CONCAT:
+      return OP_ARIADD;
+    case OP_SUBI:
+    case OP_SUBD:
+      return OP_ARISUB;
+    case OP_MULI:
+    case OP_MULD:
+      return OP_ARIMUL;
+    case OP_DIVI:
+    case OP_DIVD:
+      return OP_ARIDIV;
+    case OP_EQN:
+      return OP_ARIEQ;
+    case OP_NEN:
+      return OP_ARINE;
+    case OP_GEN:
+      return OP_ARIGE;
+    case OP_LEN:
+      return OP_ARILE;
+    case OP_GTN:
+      return OP_ARIGT;
+    case OP_LTN:
+      return OP_ARILT;
+  }
+  return op;
+}
+
+template<bool checked> void VM::opBit(const Instruction& in)
+{
+  stack.reduce<checked>([&in](Value& v1, const Value& v2){
+    switch (in.op)
+    {
+      case OP_ARIAND:
+        v1 &= v2;
+        break;
+      case OP_ARIOR:
+        v1 |= v2;
+        break;
+      default:
+        v1 = Value();
+        break;
+    }
+  });
+}
+
+template<bool checked> void VM::opLogic(const Instruction& in)
+{
+  stack.reduce<checked>([&in](Value& v1, const Value& v2){
+    bool v = false;
+    switch (in.op)
+    {
+      case OP_AND:
+        v = (v1 && v2);
+        break;
+      case OP_OR:
+        v = (v1 || v2);
+        break;
+    }
+    v1.set(static_cast<int32_t>(v));
+  });
+}
+
+template<bool checked> void VM::opNot(const Instruction& /*in*/)
+{
+  stack.top<checked>().opnot();
+}
+
+template<bool checked> void VM::opNeg(const Instruction& /*in*/)
+{
+  stack.top<checked>().negate();
+}
+
+void VM::opClr(const Instruction& in)
+{
+  mem.clr(Value::zero(in.type),in.arg);
+}
+
+template<bool checked> void VM::opRsz(const Instruction& in)
+{
+  uint32_t size = stack.pop<checked>().getInt();
+  mem.resize(in.arg,size);
+  mem.clr(Value::zero(in.type),in.arg);
 }
 
-void VM::opStore(uint32_t op, bool indexed)
+template<bool checked> void VM::opStore(const Instruction& in, bool indexed)
 {
-  Type t = COp::getType(op);
-  uint32_t a = *cptr++;
-  int32_t addr = static_cast<int32_t>(Address::getAddress(a));
-  if (Address::isGlobalAddress(a))
-    opStoreG(addr,t,indexed);
+  int32_t offset = indexed ? stack.pop<checked>().getInt() : 0;
+  if (in.type.isArrayType())
+    opStoreArray(in.arg+offset,in.type);
+  else
+    storeScalar(stack.pop<checked>(),in.arg,offset,in.type);
 }
 
-void VM::opStoreG(int32_t addr, Type t, bool indexed)
+void VM::storeScalar(Value v, uint32_t addr, int32_t offset, Type t)
 {
-  int32_t offset = indexed ? stack.pop().getInt() : 0;
   /* Variables have a type. If we store in a variable, we must make sure the
    * value corresponds to the variable type */
   if (t == Type::int32Type)
-    mem.store(stack.pop().getInt(),addr,offset);
+    mem.store(v.getInt(),addr,offset);
   else if (t == Type::doubleType)
-    mem.store(stack.pop().getDouble(),addr,offset);
+    mem.store(v.getDouble(),addr,offset);
   else if (t == Type::stringType)
-    mem.store(stack.pop().getString(),addr,offset);
-  else if (t.isArrayType())
-    opStoreArrayG(addr+offset,t);
+  {
+    v.stringify();
+    v.materialize();
+    mem.store(std::move(v),addr,offset);
+  }
 }
 
-void VM::opStoreArrayG(int32_t addr, Type t)
+void VM::opStoreArray(uint32_t addr, Type t)
 {
   int32_t n = stack.pop().getInt();
   if (t == Type::aint32Type)
@@ -493,90 +1457,176 @@ void VM::opStoreArrayG(int32_t addr, Type t)
   else if (t == Type::adoubleType)
     for (int32_t i=n;i>0;i--) mem.store(stack.pop().getDouble(),addr,i-1);
   else if (t == Type::astringType)
-    for (int32_t i=n;i>0;i--) mem.store(stack.pop().getString(),addr,i-1);
+    for (int32_t i=n;i>0;i--) storeScalar(stack.pop(),addr,i-1,Type::stringType);
 }
 
-void VM::opRecall(uint32_t op, bool indexed)
+template<bool checked> void VM::opRecall(const Instruction& in, bool indexed)
 {
-  Type t1 = COp::getType(op);
-  uint32_t a = *cptr++;
-  int32_t addr = static_cast<int32_t>(Address::getAddress(a));
-  if (Address::isGlobalAddress(a))
-    opRecallG(addr,t1,indexed);
-  else if (Address::isConstantAddress(a))
-    opRecallC(static_cast<uint32_t>(addr),t1,indexed);
+  if (in.constant != nullptr)
+    opRecallC<checked>(*in.constant,indexed);
+  else
+    opRecallG<checked>(in.arg,in.type,indexed);
 }
 
-void VM::opRecallG(int32_t addr, Type t1, bool indexed)
+template<bool checked> void VM::opRecallG(uint32_t addr, Type t1, bool indexed)
 {
-  int32_t offset = indexed ? stack.pop().getInt() : 0;
+  int32_t offset = indexed ? stack.pop<checked>().getInt() : 0;
   if (t1.isArrayType())
   {
-    int32_t n = stack.pop().getInt();
-    for (int32_t i=0;i<n;i++) stack.push(mem.getValue(addr+offset,i));
-    stack.push(n);
+    int32_t n = stack.pop<checked>().getInt();
+    for (int32_t i=0;i<n;i++) stack.push<checked>(mem.getValue(addr+offset,i));
+    stack.push<checked>(n);
+  }
+  else if (indexed)
+  {
+    stack.push<checked>(mem.getValue(addr,offset));
   }
   else
   {
-    stack.push(mem.getValue(addr,offset));
+    stack.push<checked>(mem.getScalarValue(addr));
   }
 }
 
-void VM::opRecallC(uint32_t addr, Type /*t1*/, bool indexed)
+template<bool checked> void VM::opRecallC(const std::vector<Value>& values, bool indexed)
+{
+  int32_t offset = indexed ? stack.pop<checked>().getInt() : 0;
+  if (offset < 0 || static_cast<size_t>(offset) >= values.size())  throw std::runtime_error("Illegal getConstant access");
+  stack.push<checked>(values[static_cast<size_t>(offset)]);
+}
+
+/*
+ * Pops the two indices of a 2-D array and combines them like the generic
+ * code "rcl dim1, mul, add, cast int32" does. The stride is 0 if the array
+ * is not dimensioned with the same constants everywhere.
+ */
+template<bool checked> int32_t VM::popOffset2(const Instruction& in)
+{
+  int32_t stride = in.src2 != 0 ? static_cast<int32_t>(in.src2) : mem.getScalarValue(in.src1).getInt();
+  Value j = stack.pop<checked>();
+  Value i = stack.pop<checked>();
+  if (i.isInt() && j.isInt()) return i.getInt() + j.getInt() * stride;
+  return Value(i.getDouble() + j.getDouble() * stride).getInt();
+}
+
+template<bool checked> void VM::opStore2(const Instruction& in)
 {
-  int32_t offset = indexed ? stack.pop().getInt() : 0;
-  stack.push(executable->getConstant(addr,offset));
+  Value v = stack.pop<checked>();
+  storeScalar(std::move(v),in.arg,popOffset2<checked>(in),in.type);
 }
 
+template<bool checked> void VM::opRecall2(const Instruction& in)
+{
+  int32_t offset = popOffset2<checked>(in);
+  stack.push<checked>(mem.getValue(in.arg,offset));
+}
+
+
+void VM::opDec(const Instruction& in)
+{
+  mem.dec(in.arg);
+}
 
-void VM::opDec()
+void VM::opInc(const Instruction& in)
 {
-  uint32_t a = *cptr++;
-  uint32_t addr = static_cast<uint32_t>(Address::getAddress(a));
-  if (Address::isConstantAddress(a)) return;
-  mem.dec(addr);
+  mem.inc(in.arg);
 }
 
-void VM::opInc()
+template<bool checked> void VM::opAppend(const Instruction& in)
 {
-  uint32_t a = *cptr++;
-  uint32_t addr = static_cast<uint32_t>(Address::getAddress(a));
-  if (Address::isConstantAddress(a)) return;
-  mem.inc(addr);
+  Value v = stack.pop<checked>();
+  mem.append(v,in.arg);
 }
 
 
-void VM::opCall()
+void VM::opCall(const Instruction& in)
 {
-  uint32_t id = *cptr++;
-  uint32_t func = id & 0xFFFF;
-  library->execute(static_cast<uint16_t>(func),mem,stack,executable.get());
+  library->execute(static_cast<uint16_t>(in.arg),mem,stack,executable.get());
   if (library->isTerminateRequested())
   {
-    cptr = nullptr;
+    ip = nullptr;
   }
 }
 
-void VM::opDup()
+template<bool checked> void VM::opDup()
+{
+  stack.dup<checked>();
+}
+
+template<bool checked> void VM::opSwap()
+{
+  stack.swap<checked>();
+}
+
+template<bool checked> void VM::opJsr(const Instruction& in)
 {
-  Value v = stack.pop();
-  stack.push(v);
-  stack.push(v);
+  stack.push<checked>(program->getIndex(ip)); /* push index of next op */
+  opJump(in);                        /* jump to address */
 }
 
-void VM::opSwap()
+void VM::opRet()
 {
-  stack.swap();
+  /* always checked: the verifier accepts RETURN without GOSUB */
+  ip = program->getInstruction(stack.pop().getInt()); /* get return address from stack */
 }
 
-void VM::opCast(uint32_t op)
+template<bool checked> void VM::opJz(const Instruction& in)
 {
-  Type t2 = COp::getType(op);
-  if (t2 == Type::int32Type)
-    stack.push(stack.pop().getInt());
-  else if (t2 == Type::doubleType)
-    stack.push(stack.pop().getDouble());
-  else if (t2 == Type::stringType)
-    stack.push(stack.pop().getString());
+  if (stack.pop<checked>().getInt() == 0) opJump(in);
 }
 
+template<bool checked> void VM::opJnz(const Instruction& in)
+{
+  if (stack.pop<checked>().getInt() != 0) opJump(in);
+}
+
+void VM::opJump(const Instruction& in)
+{
+  if (in.target == nullptr) throw std::runtime_error("Illegal jump target");
+  ip = in.target;
+}
+
+void VM::opErrHdl(const Instruction& in)
+{
+  errorHandler = in.target;
+}
+
+/*
+ * End of a FOR loop: the variable is incremented by the step and the loop
+ * continues while (variable - limit) * step <= 0. The comparison uses the
+ * sum before it is converted to the type of the variable.
+ */
+void VM::opNext(const Instruction& in)
+{
+  Value step = mem.getScalarValue(in.src1);
+  Value v = calculate(in.subop & 0xFF,mem.getScalarValue(in.arg),step);
+  storeScalar(v,in.arg,0,in.type);
+  Value d = calculate((in.subop >> 8) & 0xFF,v,mem.getScalarValue(in.src2));
+  d = calculate((in.subop >> 16) & 0xFF,d,step);
+  if (!compare((in.subop >> 24) & 0xFF,d,Value(0.0))) opJump(in);
+}
+
+void VM::opAriSto(const Instruction& in)
+{
+  storeScalar(calculate(in.subop,mem.getScalarValue(in.src1),mem.getScalarValue(in.src2)),in.arg,0,in.type);
+}
+
+void VM::opCmpJz(const Instruction& in)
+{
+  if (!compare(in.subop,mem.getScalarValue(in.src1),*in.value)) opJump(in);
+}
+
+void VM::opLine(const Instruction& in)
+{
+  currentLine = in.arg;
+}
+
+template<bool checked> void VM::opCast(const Instruction& in)
+{
+  Value& v = stack.top<checked>();
+  if (in.type == Type::int32Type)
+    v.set(v.getInt());
+  else if (in.type == Type::doubleType)
+    v.set(v.getDouble());
+  else if (in.type == Type::stringType)
+    v.stringify();
+}
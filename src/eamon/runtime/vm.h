@@ -23,11 +23,20 @@
 #ifndef VM_H
 #define VM_H
 
+#include "decodedcode.h"
+#include "registercode.h"
+#include "jit.h"
+#include "nativemodule.h"
 #include "executable.h"
 #include "memory.h"
 #include "stack.h"
+#include "stringheap.h"
 #include "type.h"
 #include "library.h"
+#include "opprofile.h"
+#include "throttle.h"
+#include "verifier.h"
+#include <atomic>
 #include <map>
 #include <ostream>
 #include <memory>
@@ -40,7 +49,24 @@ class OutputStream;
 class VM
 {
 public:
+  /**
+   * @brief Engine used to dispatch the op codes in the execution loop.
+   */
+  enum DispatchMode {
+    SwitchDispatch,  /**< portable switch statement */
+    ThreadedDispatch /**< direct threaded code using computed gotos */
+  };
+
+  /**
+   * @brief Machine model used to execute the code.
+   */
+  enum Backend {
+    StackBackend,   /**< stack machine on the decoded code */
+    RegisterBackend /**< register machine with three address instructions */
+  };
+
   VM(std::shared_ptr<InputStream>& sin, std::shared_ptr<OutputStream>& sout);
+  ~VM();
 
   /**
    * @brief Clears the stack.
@@ -52,6 +78,8 @@ public:
    *
    * This method loads the xecutable and resets the code pointer.
    * It also setsup the global memory. It does not clear the stack.
+   * The code is decoded on the first load of an executable; the decoded
+   * code is kept by the executable and reused by all later loads.
    * @param x the executable to load
    */
   void load(std::shared_ptr<Executable> x);
@@ -105,10 +133,174 @@ public:
 //   */
 //  std::vector<Value> popArray();
 
+  /**
+   * @brief Slows down the execution to the given time per instruction on
+   * average.
+   *
+   * Same as setInstructionRate(1000000 / microseconds).
+   * @param microseconds time per instruction or 0 for full speed
+   */
   void setSlowdown(uint32_t microseconds);
 
   uint32_t getSlowdown() const;
 
+  /**
+   * @brief Limits the number of instructions executed per second.
+   *
+   * The instructions are executed in slices with one sleep per slice. The
+   * JIT compiler and native modules are not used while the speed is limited.
+   * @param ips instructions per second or 0 for full speed
+   */
+  void setInstructionRate(uint32_t ips);
+
+  uint32_t getInstructionRate() const;
+
+  /**
+   * @brief Selects the engine used to dispatch the op codes.
+   *
+   * If threaded dispatch is not available in this build, the switch engine
+   * will be used regardless of the selected mode.
+   * @param mode the dispatch mode
+   */
+  void setDispatchMode(DispatchMode mode);
+
+  DispatchMode getDispatchMode() const;
+
+  /**
+   * @brief Get whether the threaded dispatch engine was compiled in.
+   * @return true if threaded dispatch is available
+   */
+  static bool isThreadedDispatchAvailable();
+
+  /**
+   * @brief Selects the machine model used by run().
+   *
+   * The register machine is translated from the decoded code on first use.
+   * It does not collect an op code profile. The backend must not be changed
+   * while a program is paused.
+   * @param b the backend
+   */
+  void setBackend(Backend b);
+
+  Backend getBackend() const;
+
+  /**
+   * @brief Enables the JIT compiler of the register machine.
+   *
+   * Hot blocks of the register machine code are compiled to native code.
+   * The JIT compiler is not used while the execution is slowed down. The
+   * setting takes effect when the next executable is loaded.
+   * @param flag true to enable the JIT compiler
+   */
+  void setJitEnabled(bool flag);
+
+  bool isJitEnabled() const;
+
+  /**
+   * @brief Verifies the JIT compiler against the interpreter.
+   *
+   * Every run of a compiled block is repeated by the interpreter from the
+   * same state. The variables, the registers, the line number and the next
+   * instruction must match, otherwise the program stops with a JitMismatch,
+   * which an ONERR handler does not catch. Meant for tests; the execution
+   * gets much slower.
+   * @param flag true to verify the compiled blocks
+   */
+  void setJitVerification(bool flag);
+
+  bool isJitVerification() const;
+
+  /**
+   * @brief Get whether the JIT compiler is available in this build.
+   * @return true if native code can be generated
+   */
+  static bool isJitAvailable();
+
+  /**
+   * @brief Sets the directory of the native modules.
+   *
+   * If set, load() runs the native module of the executable instead of
+   * interpreting it. If the directory does not yet contain the module, it is
+   * built in the background while the program is interpreted; the execution
+   * switches to the module at the next safepoint the module can be entered
+   * at. Without a module, or while the execution is slowed down or profiled,
+   * the selected backend is used.
+   * @param dir the directory or an empty string to disable native modules
+   */
+  void setNativeModuleDirectory(const std::string& dir);
+
+  const std::string& getNativeModuleDirectory() const;
+
+  /**
+   * @brief Get whether the loaded executable runs as a native module.
+   * @return true if a native module was loaded
+   */
+  bool hasNativeModule() const;
+
+  /**
+   * @brief Get whether the stack effects of the loaded executable are verified.
+   *
+   * The stack machine runs verified code without checking the stack for
+   * overflow and underflow, until an error handler is entered: the handler
+   * finds the leftovers of the failed statement on the stack. The register
+   * machine, the JIT and native modules always use the checked stack.
+   * @return true if the code is verified
+   */
+  bool isStackVerified() const;
+
+  /**
+   * @brief Lets run() execute verified code on the unchecked stack.
+   *
+   * Enabled by default. When disabled, verified code runs on the checked
+   * stack like all other code, so a test can compare both. The setting takes
+   * effect with the next run().
+   * @param flag true to use the unchecked stack for verified code
+   */
+  void setUncheckedStackEnabled(bool flag);
+
+  bool isUncheckedStackEnabled() const;
+
+  /**
+   * @brief Sets the profile that collects the executed op code pairs.
+   *
+   * While a profile is set, the switch dispatch engine is used regardless
+   * of the dispatch mode. Pass a nullptr to stop profiling.
+   * @param p the profile or nullptr
+   */
+  void setProfile(std::shared_ptr<OpProfile> p);
+
+  std::shared_ptr<OpProfile> getProfile() const;
+
+  /**
+   * @brief Returns the string space of the running program.
+   *
+   * The strings are allocated in this heap while the virtual machine
+   * executes code. The statistics may be read while the program is paused.
+   * @return the string heap
+   */
+  const StringHeap& getStringHeap() const;
+
+  /**
+   * @brief Takes a checkpoint of the global variables.
+   *
+   * The checkpoint shares the memory pages, which are copied when they are
+   * written next, so it can be taken e.g. at every INPUT to undo a move.
+   * The program must not be running.
+   * @return the checkpoint
+   */
+  Memory::Checkpoint checkpoint();
+
+  /**
+   * @brief Restores the global variables from a checkpoint.
+   *
+   * A checkpoint of another virtual machine on the same thread running the
+   * same executable forks its state; its strings are copied into the string
+   * heap of this machine. The program must not be running.
+   * @param c the checkpoint
+   * @throws runtime_error if the checkpoint was taken on another thread
+   */
+  void restore(const Memory::Checkpoint& c);
+
   void setDisk(const std::string& d);
 
   const std::vector<uint8_t>& getHiresPage() const;
@@ -118,42 +310,108 @@ public:
 private:
   void setupGlobal(uint32_t numSize);
   uint32_t getVariableAddress(const std::string& name);
-  void pushArray(uint32_t addr, Type type);
+  void pushArray(const std::vector<Value>& values);
   void loop(int depth=0);
-  void opPush(uint32_t op);
-  void opPop();
-  void opAri(uint32_t op);
-  void opCmp(uint32_t op);
-  void opBit(uint32_t op);
-  void opLogic(uint32_t op);
-  void opNot(uint32_t op);
-  void opNeg(uint32_t op);
-  void opClr(uint32_t op);
-  void opRsz(uint32_t op);
-  void opStore(uint32_t op, bool indexed);
-  void opStoreG(int32_t addr, Type t, bool indexed);
-  void opStoreArrayG(int32_t addr, Type t);
-  void opRecall(uint32_t op, bool indexed);
-  void opRecallG(int32_t addr, Type t1, bool indexed);
-  void opRecallC(uint32_t addr, Type t1, bool indexed);
-  void opDec();
-  void opInc();
-  void opCall();
-  void opDup();
-  void opSwap();
-  void opCast(uint32_t op);
+  template<bool checked=true> void loopSwitch();
+  template<bool checked=true> void loopThreaded();
+  void loopRegister();
+  bool executeRegister(const RegisterInstruction& in, Value& ta, Value& tb);
+  void countInstruction();
+  void runJit();
+  const RegisterInstruction* runVerified(Jit::Block block);
+  void loopNative();
+  void enterModule();
+  const Instruction& enterNative(int32_t index);
+  static int32_t nativeExecute(void* vm, int32_t index);
+  static int32_t nativePush(void* vm, int32_t index);
+  static int32_t nativeRecall(void* vm, int32_t index);
+  static int32_t nativeStore(void* vm, int32_t index);
+  static int32_t nativeArithmetic(void* vm, int32_t index);
+  static int32_t nativeCompare(void* vm, int32_t index);
+  static int32_t nativeLine(void* vm, int32_t index);
+  static int32_t nativePushInt(void* vm, int32_t index);
+  static int32_t nativePopInt(void* vm, int32_t index);
+  static int32_t nativeIllegalJump(void* vm, int32_t index);
+  static int32_t nativeSafepoint(void* vm, int32_t index);
+  template<bool checked=true> void execute(const Instruction& in);
+  const Value& fetch(const Operand& o, Value& tmp);
+  void jump(const RegisterInstruction& in);
+  template<bool checked=true> void opPush(const Instruction& in);
+  template<bool checked=true> void opPop();
+  template<bool checked=true> void opAri(const Instruction& in);
+  template<bool checked=true> void opAriTyped(const Instruction& in);
+  void ariInPlace(uint32_t op, Value& v1, const Value& v2);
+  void calculateInPlace(uint32_t op, Value& v1, const Value& v2);
+  Value calculate(uint32_t op, const Value& v1, const Value& v2);
+  template<bool checked=true> void opCmp(const Instruction& in);
+  template<bool checked=true> void opCmpNumeric(const Instruction& in);
+  bool cmp(uint32_t op, const Value& v1, const Value& v2);
+  bool compare(uint32_t op, const Value& v1, const Value& v2);
+  static uint32_t getGenericOp(uint32_t op);
+  template<bool checked=true> void opBit(const Instruction& in);
+  template<bool checked=true> void opLogic(const Instruction& in);
+  template<bool checked=true> void opNot(const Instruction& in);
+  template<bool checked=true> void opNeg(const Instruction& in);
+  void opClr(const Instruction& in);
+  template<bool checked=true> void opRsz(const Instruction& in);
+  template<bool checked=true> void opStore(const Instruction& in, bool indexed);
+  void opStoreArray(uint32_t addr, Type t);
+  void storeScalar(Value v, uint32_t addr, int32_t offset, Type t);
+  template<bool checked=true> void opRecall(const Instruction& in, bool indexed);
+  template<bool checked=true> void opRecallG(uint32_t addr, Type t1, bool indexed);
+  template<bool checked=true> void opRecallC(const std::vector<Value>& values, bool indexed);
+  template<bool checked=true> int32_t popOffset2(const Instruction& in);
+  template<bool checked=true> void opStore2(const Instruction& in);
+  template<bool checked=true> void opRecall2(const Instruction& in);
+  void opDec(const Instruction& in);
+  void opInc(const Instruction& in);
+  template<bool checked=true> void opAppend(const Instruction& in);
+  void opCall(const Instruction& in);
+  template<bool checked=true> void opDup();
+  template<bool checked=true> void opSwap();
+  template<bool checked=true> void opCast(const Instruction& in);
+  template<bool checked=true> void opJsr(const Instruction& in);
+  void opRet();
+  template<bool checked=true> void opJz(const Instruction& in);
+  template<bool checked=true> void opJnz(const Instruction& in);
+  void opJump(const Instruction& in);
+  void opErrHdl(const Instruction& in);
+  void opNext(const Instruction& in);
+  void opAriSto(const Instruction& in);
+  void opCmpJz(const Instruction& in);
+  void opLine(const Instruction& in);
 
   std::shared_ptr<Executable> executable;
+  std::shared_ptr<const DecodedCode> program; //!< decoded code of the executable
+  std::shared_ptr<const Verifier::Verdict> stackVerdict; //!< verdict of the stack verifier on the code
+  bool uncheckedStack; //!< the verified code runs from its entry without errors
+  bool uncheckedStackEnabled; //!< verified code may run on the unchecked stack
+  StringHeap strings; //!< string space; declared before all values referring to it
   Stack stack;
-  const uint32_t* cptr;
+  const Instruction* ip; //!< next instruction to execute
   uint32_t currentLine;
-  bool requestPause;
+  std::atomic<bool> requestPause; //!< set by pause(); polled at the safepoints of the code
+  std::atomic<bool> userPause; //!< set by pause() only
   Memory mem;
   std::unique_ptr<Library> library;
   std::shared_ptr<OutputStream> os;
   std::shared_ptr<InputStream> is;
-  uint32_t errorHandler;
-  uint32_t slowdown; //!< number of microseconds to sleep after each instruction
+  const Instruction* errorHandler;
+  Throttle throttle;
+  uint32_t budget; //!< instructions left in the current slice of the throttle
+  DispatchMode dispatchMode;
+  std::shared_ptr<OpProfile> profile;
+  Backend backend;
+  std::shared_ptr<const RegisterCode> registerCode; //!< register machine code of the executable
+  const RegisterInstruction* rip; //!< next register machine instruction to execute
+  std::vector<Value> registers;
+  bool jitEnabled;
+  bool jitVerification;
+  std::unique_ptr<Jit> jit; //!< JIT compiler of the register machine; nullptr if not used
+  std::string nativeModuleDirectory;
+  std::shared_ptr<NativeModule> nativeModule; //!< native module of the executable; nullptr if interpreted
+  std::shared_ptr<NativeModule::Build> moduleBuild; //!< build of the native module; nullptr if none is running
+  std::vector<bool> moduleEntries; //!< instructions the native module can be entered at
 };
 
 
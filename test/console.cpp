@@ -0,0 +1,204 @@
+/********************************************************************************
+ *                                                                              *
+ * EamonInterpreter - test console                                              *
+ *                                                                              *
+ * modified: 2026-10-17                                                         *
+ *                                                                              *
+ ********************************************************************************
+ * Copyright (C) Harald Braeuning                                               *
+ ********************************************************************************
+ * This file is part of EamonInterpreter.                                       *
+ * EamonInterpreter is free software: you can redistribute it and/or modify it  *
+ * under the terms of the GNU General Public License as published by the Free   *
+ * Software Foundation, either version 3 of the License, or (at your option)    *
+ * any later version.                                                           *
+ * EamonInterpreter is distributed in the hope that it will be useful, but      *
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY   *
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for  *
+ * more details.                                                                *
+ * You should have received a copy of the GNU General Public License along with *
+ * EamonInterpreter. If not, see <https://www.gnu.org/licenses/>.               *
+ ********************************************************************************/
+
+#include "console.h"
+#include "runtime/inputstream.h"
+#include "runtime/outputstream.h"
+#include <algorithm>
+#include <ctype.h>
+#include <stdexcept>
+
+/* there is only one keyboard and one screen in a test */
+static std::string keys;
+static size_t position = 0;
+static std::string transcript;
+static int column = 0;
+static int row = 0;
+
+static void newLine()
+{
+  column = 0;
+  if (row < CONSOLE_ROWS - 1) row++;
+}
+
+static void endOfScript()
+{
+  throw std::runtime_error("end of the input script");
+}
+
+
+
+void Console::reset(const std::string& k)
+{
+  keys = k;
+  position = 0;
+  transcript.clear();
+  column = 0;
+  row = 0;
+}
+
+const std::string& Console::getTranscript()
+{
+  return transcript;
+}
+
+
+
+InputStream::InputStream(QObject *parent) : QObject(parent),
+  lastKey(-1),
+  state(Idle)
+{
+}
+
+InputStream::State InputStream::handleKey(QKeyEvent* /*event*/)
+{
+  return state;
+}
+
+bool InputStream::echoInput() const
+{
+  return false;
+}
+
+bool InputStream::canBackspace() const
+{
+  return false;
+}
+
+std::string InputStream::getLastEntry() const
+{
+  return lastentry;
+}
+
+char InputStream::getLastKey() const
+{
+  return lastKey;
+}
+
+/*
+ * The line is echoed like the screen does while it is typed.
+ */
+std::string InputStream::readLine()
+{
+  if (position >= keys.size()) endOfScript();
+  size_t end = keys.find('\n',position);
+  if (end == std::string::npos) end = keys.size();
+  text.clear();
+  for (size_t i=position;i<end;i++) text += static_cast<char>(toupper(keys[i]));
+  position = end + 1;
+  lastentry = text;
+  if (!text.empty()) lastKey = text.back();
+  transcript += text;
+  transcript += '\n';
+  newLine();
+  return text;
+}
+
+char InputStream::readChar()
+{
+  while (position < keys.size() && keys[position] == '\n') position++;
+  if (position >= keys.size()) endOfScript();
+  ch = static_cast<char>(toupper(keys[position++]));
+  lastKey = ch;
+  return ch;
+}
+
+
+
+OutputStream::OutputStream(Screen* screen, QObject *parent) : QObject(parent),
+  screen(screen)
+{
+}
+
+OutputStream::~OutputStream()
+{
+}
+
+void OutputStream::write(const std::string &s)
+{
+  transcript += s;
+  for (char c : s)
+  {
+    if (c == '\n')
+      newLine();
+    else if (++column == CONSOLE_COLUMNS)
+      newLine();
+  }
+}
+
+void OutputStream::gotoColumn(int c)
+{
+  column = std::max(0,std::min(c,CONSOLE_COLUMNS-1));
+  transcript += "{HTAB " + std::to_string(c) + "}";
+}
+
+void OutputStream::gotoRow(int r)
+{
+  row = std::max(0,std::min(r,CONSOLE_ROWS-1));
+  transcript += "{VTAB " + std::to_string(r) + "}";
+}
+
+void OutputStream::home()
+{
+  column = 0;
+  row = 0;
+  transcript += "{HOME}";
+}
+
+void OutputStream::inverse()
+{
+  transcript += "{INVERSE}";
+}
+
+void OutputStream::normal()
+{
+  transcript += "{NORMAL}";
+}
+
+void OutputStream::setScreenMode(ScreenMode m)
+{
+  newScreenMode(m);
+}
+
+void OutputStream::notifyHiresLoaded()
+{
+  transcript += "{HIRES}";
+}
+
+void OutputStream::flush()
+{
+}
+
+int OutputStream::getCursorColumn() const
+{
+  return column;
+}
+
+int OutputStream::getCursorRow() const
+{
+  return row;
+}
+
+void OutputStream::newScreenMode(int m)
+{
+  transcript += m == Text ? "{TEXT}" : "{GRAPHICS}";
+}
@@ -0,0 +1,64 @@
+/********************************************************************************
+ *                                                                              *
+ * EamonInterpreter - test console                                              *
+ *                                                                              *
+ * modified: 2026-10-17                                                         *
+ *                                                                              *
+ ********************************************************************************
+ * Copyright (C) Harald Braeuning                                               *
+ ********************************************************************************
+ * This file is part of EamonInterpreter.                                       *
+ * EamonInterpreter is free software: you can redistribute it and/or modify it  *
+ * under the terms of the GNU General Public License as published by the Free   *
+ * Software Foundation, either version 3 of the License, or (at your option)    *
+ * any later version.                                                           *
+ * EamonInterpreter is distributed in the hope that it will be useful, but      *
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY   *
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for  *
+ * more details.                                                                *
+ * You should have received a copy of the GNU General Public License along with *
+ * EamonInterpreter. If not, see <https://www.gnu.org/licenses/>.               *
+ ********************************************************************************/
+
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include <string>
+
+#define CONSOLE_COLUMNS 40
+#define CONSOLE_ROWS 24
+
+
+
+/**
+ * @brief The Console class replaces the screen and the keyboard in the tests.
+ *
+ * The tests link console.cpp instead of inputstream.cpp and outputstream.cpp.
+ * The input stream reads the keys from a script and throws a runtime_error
+ * once the script is used up. The output stream appends all text to a
+ * transcript; the control functions (HTAB, VTAB, HOME, ...) are recorded as
+ * tags in braces. The cursor moves like on the 40 column text screen, so
+ * PEEK(36) and PEEK(37) do not depend on a window.
+ */
+class Console
+{
+public:
+  /**
+   * @brief Clears the transcript and sets the keys to type.
+   *
+   * A line feed ends a line of input. GET skips the line feeds, so a script
+   * may put every single key on a line of its own.
+   * @param keys the keys to type
+   */
+  static void reset(const std::string& keys);
+
+  /**
+   * @brief Gets everything printed and typed since the last reset.
+   * @return the transcript
+   */
+  static const std::string& getTranscript();
+};
+
+
+
+#endif // CONSOLE_H
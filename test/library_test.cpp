@@ -0,0 +1,201 @@
+/********************************************************************************
+ *                                                                              *
+ * EamonInterpreter - library test                                              *
+ *                                                                              *
+ * modified: 2026-10-17                                                         *
+ *                                                                              *
+ ********************************************************************************
+ * Copyright (C) Harald Braeuning                                               *
+ ********************************************************************************
+ * This file is part of EamonInterpreter.                                       *
+ * EamonInterpreter is free software: you can redistribute it and/or modify it  *
+ * under the terms of the GNU General Public License as published by the Free   *
+ * Software Foundation, either version 3 of the License, or (at your option)    *
+ * any later version.                                                           *
+ * EamonInterpreter is distributed in the hope that it will be useful, but      *
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY   *
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for  *
+ * more details.                                                                *
+ * You should have received a copy of the GNU General Public License along with *
+ * EamonInterpreter. If not, see <https://www.gnu.org/licenses/>.               *
+ ********************************************************************************/
+
+#include "console.h"
+#include "runtime/inputstream.h"
+#include "runtime/library.h"
+#include "runtime/memory.h"
+#include "runtime/outputstream.h"
+#include "runtime/stack.h"
+#include "runtime/stringheap.h"
+#include "runtime/type.h"
+#include <stdint.h>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/*
+ * Calls every function of the library and compares the number of values it
+ * takes from and puts on the stack with Library::getStackEffect(). The
+ * verifier relies on these effects, and verified code runs on a stack which
+ * neither grows nor checks for underflow. Each function is called with the
+ * screen and the keyboard and, unless it needs the screen, without them.
+ *
+ * usage: library_test
+ */
+
+struct Call
+{
+  const char* name;
+  std::vector<Value> args; /* pushed in this order */
+  int32_t narg;            /* argument count of a variadic function */
+  bool screen;             /* needs the output stream */
+};
+
+/* READ finds no DATA statements */
+class NoData : public ConstantData
+{
+public:
+  Value getConstant(uint32_t, int32_t) const override { return Value(0); }
+  std::vector<Value> getConstantArray(uint32_t) const override { return {}; }
+  const Symbol* findConstant(const std::string&) const override { return nullptr; }
+};
+
+static int checks = 0;
+static int failed = 0;
+
+
+
+static void check(const Call& c, bool streams)
+{
+  checks++;
+  Console::reset("7,X\nK\n");
+  std::shared_ptr<InputStream> is;
+  std::shared_ptr<OutputStream> os;
+  if (streams)
+  {
+    is = std::make_shared<InputStream>();
+    os = std::make_shared<OutputStream>(nullptr);
+  }
+  Library library(is,os);
+  library.reset(); /* like the VM before a run */
+  Memory mem;
+  NoData data;
+  Stack stack;
+  stack.push(std::string("BOTTOM"));
+  for (const Value& v : c.args) stack.push(v);
+  const LibraryFunction& f = Library::findFunction(c.name);
+  int32_t pop = 0;
+  int32_t push = 0;
+  if (!Library::getStackEffect(f.id,c.narg,pop,push))
+  {
+    std::cerr << c.name << ": no stack effect" << std::endl;
+    failed++;
+    return;
+  }
+  int32_t depth = static_cast<int32_t>(stack.size());
+  library.execute(f.id,mem,stack,&data);
+  int32_t expected = depth - pop + push;
+  if (static_cast<int32_t>(stack.size()) != expected)
+  {
+    std::cerr << c.name << " with " << c.args.size() << " arguments" << (streams ? "" : " and no streams")
+              << ": " << stack.size() << " values on the stack instead of " << expected << std::endl;
+    failed++;
+  }
+  else
+  {
+    while (stack.size() > 1) stack.pop();
+    if (stack.pop().getString() != "BOTTOM")
+    {
+      std::cerr << c.name << ": took more than " << pop << " values from the stack" << std::endl;
+      failed++;
+    }
+  }
+}
+
+int main()
+{
+  StringHeap heap;
+  StringHeap::Scope scope(&heap);
+  /* the types are static members of another file, so they are read here */
+  const int32_t INT = static_cast<int32_t>(Type::int32Type.toInt());
+  const int32_t DOUBLE = static_cast<int32_t>(Type::doubleType.toInt());
+  const int32_t STRING = static_cast<int32_t>(Type::stringType.toInt());
+
+  const Call calls[] = {
+    { "print", { Value(0) }, 0, false },
+    { "print", { Value(std::string("A")), Value(STRING), Value(1) }, 1, false },
+    { "print", { Value(1), Value(INT), Value(2.5), Value(DOUBLE), Value(2) }, 2, false },
+    { "printf", { Value(0) }, 0, false },
+    { "printf", { Value(std::string("##")), Value(STRING), Value(5), Value(INT), Value(2) }, 2, false },
+    { "printf", { Value(5), Value(INT), Value(1) }, 1, false },
+    { "input", { Value(0), Value(0) }, 0, false },
+    { "input", { Value(INT), Value(STRING), Value(2), Value(1) }, 2, false },
+    { "read", { Value(0), Value(INT) }, 0, false },
+    { "get", { Value(STRING) }, 0, false },
+    { "sin", { Value(0.5) }, 0, false },
+    { "cos", { Value(0.5) }, 0, false },
+    { "tan", { Value(0.5) }, 0, false },
+    { "asin", { Value(0.5) }, 0, false },
+    { "acos", { Value(0.5) }, 0, false },
+    { "atan", { Value(0.5) }, 0, false },
+    { "atan2", { Value(1.0), Value(2.0) }, 0, false },
+    { "sqrt", { Value(2.0) }, 0, false },
+    { "exp", { Value(2.0) }, 0, false },
+    { "log", { Value(2.0) }, 0, false },
+    { "log10", { Value(2.0) }, 0, false },
+    { "log2", { Value(2.0) }, 0, false },
+    { "abs", { Value(-2.0) }, 0, false },
+    { "tab", { Value(5.0) }, 0, false },
+    { "sgn", { Value(-2.0) }, 0, false },
+    { "rnd", { Value(1.0) }, 0, false },
+    { "int", { Value(2.5) }, 0, false },
+    { "left$", { Value(std::string("HELLO")), Value(2) }, 0, false },
+    { "mid$", { Value(std::string("HELLO")), Value(2), Value(2) }, 0, false },
+    { "mid1$", { Value(std::string("HELLO")), Value(2) }, 0, false },
+    { "right$", { Value(std::string("HELLO")), Value(2) }, 0, false },
+    { "len", { Value(std::string("HELLO")) }, 0, false },
+    { "asc", { Value(std::string("HELLO")) }, 0, false },
+    { "chr$", { Value(65) }, 0, false },
+    { "val", { Value(std::string("12")) }, 0, false },
+    { "str$", { Value(12.0) }, 0, false },
+    { "pow", { Value(2.0), Value(3.0) }, 0, false },
+    { "peek", { Value(-16384) }, 0, false },
+    { "poke", { Value(0), Value(0) }, 0, false },
+    { "inverse", {}, 0, true },
+    { "normal", {}, 0, true },
+    { "vtab", { Value(1.0) }, 0, true },
+    { "htab", { Value(1.0) }, 0, true },
+    { "spc", { Value(3) }, 0, false },
+    { "home", {}, 0, true },
+    { "flash", {}, 0, true },
+    { "text", {}, 0, true },
+    { "fre", { Value(0) }, 0, false }
+  };
+  try
+  {
+    for (const LibraryFunction& f : Library::getFunctions())
+    {
+      bool found = false;
+      for (const Call& c : calls) found = found || f.name == c.name;
+      if (!found)
+      {
+        std::cerr << f.name << " is not called" << std::endl;
+        failed++;
+      }
+    }
+    for (const Call& c : calls)
+    {
+      check(c,true);
+      if (!c.screen) check(c,false);
+    }
+  }
+  catch (std::exception& ex)
+  {
+    std::cerr << ex.what() << std::endl;
+    return 2;
+  }
+  std::cout << failed << " of " << checks << " checks failed" << std::endl;
+  return failed > 0 ? 1 : 0;
+}
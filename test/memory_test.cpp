@@ -0,0 +1,441 @@
+/********************************************************************************
+ *                                                                              *
+ * EamonInterpreter - memory test                                               *
+ *                                                                              *
+ * modified: 2026-10-17                                                         *
+ *                                                                              *
+ ********************************************************************************
+ * Copyright (C) Harald Braeuning                                               *
+ ********************************************************************************
+ * This file is part of EamonInterpreter.                                       *
+ * EamonInterpreter is free software: you can redistribute it and/or modify it  *
+ * under the terms of the GNU General Public License as published by the Free   *
+ * Software Foundation, either version 3 of the License, or (at your option)    *
+ * any later version.                                                           *
+ * EamonInterpreter is distributed in the hope that it will be useful, but      *
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY   *
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for  *
+ * more details.                                                                *
+ * You should have received a copy of the GNU General Public License along with *
+ * EamonInterpreter. If not, see <https://www.gnu.org/licenses/>.               *
+ ********************************************************************************/
+
+#include "console.h"
+#include "runtime/compiler.h"
+#include "runtime/executable.h"
+#include "runtime/inputstream.h"
+#include "runtime/memory.h"
+#include "runtime/outputstream.h"
+#include "runtime/stringheap.h"
+#include "runtime/vm.h"
+#include <stdint.h>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Saves and restores the memory in all formats: the binary snapshot, the
+ * snapshots of the changes, the JSON of older versions and the log which
+ * BSAVE writes. Takes and restores checkpoints and compares them.
+ *
+ * usage: memory_test
+ */
+
+#define ADDRESSES 100
+
+/* offsets in the binary snapshot */
+#define SNAPSHOT_VERSION_OFFSET 8
+#define SNAPSHOT_SECTIONS_OFFSET 12
+#define SNAPSHOT_CHECKSUM_OFFSET 32
+#define SNAPSHOT_DATA_OFFSET 40
+
+/* a program which saves the memory three times and loads it again */
+static const char* program =
+    "10 D$ = CHR$(4)\n"
+    "20 DIM A(1000)\n"
+    "30 INPUT F$\n"
+    "40 IF F$ <> \"\" THEN PRINT D$;\"BLOAD \";F$: GOTO 120\n"
+    "50 A(50) = 7:N$ = \"ONE\":X = 1\n"
+    "60 PRINT D$;\"BSAVE MEM,A$69\"\n"
+    "70 A(50) = 8:N$ = \"TWO\":X = 2:A(99) = 5\n"
+    "80 PRINT D$;\"BSAVE MEM,A$69\"\n"
+    "90 A(50) = 9:N$ = \"THREE\":X = 3\n"
+    "95 PRINT D$;\"BSAVE MEM,A$69\"\n"
+    "100 A(50) = 10:N$ = \"FOUR\":X = 4\n"
+    "110 PRINT D$;\"BLOAD MEM\"\n"
+    "120 PRINT X;\" \";A(50);\" \";A(99);\" \";N$\n";
+
+static int checks = 0;
+static int failed = 0;
+
+
+
+static void check(bool ok, const std::string& what)
+{
+  checks++;
+  if (!ok)
+  {
+    std::cerr << what << " failed" << std::endl;
+    failed++;
+  }
+}
+
+/* values of the same type which are equal */
+static bool identical(const Value& a, const Value& b)
+{
+  if (a.isInt() != b.isInt() || a.isDouble() != b.isDouble() || a.isString() != b.isString()) return false;
+  if (!a.isInt() && !a.isDouble() && !a.isString()) return true;
+  return Value::equals(a,b);
+}
+
+static bool same(const Memory& a, const Memory& b)
+{
+  for (uint32_t addr=0;addr<ADDRESSES;addr++)
+  {
+    if (a.getSize(addr) != b.getSize(addr)) return false;
+    for (uint32_t i=0;i<a.getSize(addr);i++)
+    {
+      if (!identical(a.getValue(addr,i),b.getValue(addr,i))) return false;
+    }
+  }
+  return true;
+}
+
+/*
+ * Fills the memory with values of all types, an array in the slots, two
+ * arrays moved behind the slots and an empty array.
+ */
+static void fill(Memory& m)
+{
+  m.reset(ADDRESSES);
+  m.store(7,1,0);
+  m.store(2.5,2,0);
+  m.store(std::string("A STRING"),3,0);
+  m.resize(4,200);
+  for (int32_t i=0;i<200;i++) m.store(i*3,4,i);
+  m.resize(5,1);
+  m.resize(6,0);
+  m.resize(7,50);
+  m.resize(7,80);
+  for (int32_t i=0;i<80;i++) m.store("ELEMENT "+std::to_string(i),7,i);
+  m.store(-0.5,99,0);
+}
+
+static std::string snapshot(const Memory& m)
+{
+  std::ostringstream s;
+  m.saveSnapshot(s);
+  return s.str();
+}
+
+static bool rejected(const std::string& data)
+{
+  Memory m;
+  try
+  {
+    m.restoreSnapshot(data.data(),data.size());
+  }
+  catch (std::runtime_error&)
+  {
+    return true;
+  }
+  return false;
+}
+
+/* appends an empty section with the given id */
+static std::string addSection(std::string data, uint32_t id)
+{
+  uint32_t sections;
+  memcpy(&sections,data.data()+SNAPSHOT_SECTIONS_OFFSET,sizeof(sections));
+  sections++;
+  memcpy(&data[SNAPSHOT_SECTIONS_OFFSET],&sections,sizeof(sections));
+  uint32_t count = 0;
+  uint64_t size = 0;
+  uint64_t checksum = 14695981039346656037ULL; /* FNV-1a hash of no data */
+  data.append(reinterpret_cast<const char*>(&id),sizeof(id));
+  data.append(reinterpret_cast<const char*>(&count),sizeof(count));
+  data.append(reinterpret_cast<const char*>(&size),sizeof(size));
+  data.append(reinterpret_cast<const char*>(&checksum),sizeof(checksum));
+  return data;
+}
+
+/* sets the range of an address in the first section and fixes its checksum */
+static std::string setExtent(std::string data, uint32_t addr, uint32_t start, uint32_t size)
+{
+  memcpy(&data[SNAPSHOT_DATA_OFFSET+addr*8],&start,sizeof(start));
+  memcpy(&data[SNAPSHOT_DATA_OFFSET+addr*8+4],&size,sizeof(size));
+  uint64_t checksum = 14695981039346656037ULL;
+  for (uint32_t i=0;i<ADDRESSES*8;i++)
+  {
+    checksum ^= static_cast<uint8_t>(data[SNAPSHOT_DATA_OFFSET+i]);
+    checksum *= 1099511628211ULL;
+  }
+  memcpy(&data[SNAPSHOT_CHECKSUM_OFFSET],&checksum,sizeof(checksum));
+  return data;
+}
+
+static void testSnapshot()
+{
+  Memory m;
+  fill(m);
+  std::string data = snapshot(m);
+  check(Memory::isSnapshot(data.data(),data.size()),"snapshot magic");
+  Memory r;
+  r.restoreSnapshot(data.data(),data.size());
+  check(same(m,r),"snapshot round trip");
+  check(r.getString(3) == "A STRING" && r.getValue(7,79).getString() == "ELEMENT 79","snapshot strings");
+  check(snapshot(r) == data,"snapshot of a restored snapshot");
+}
+
+static void testChanges()
+{
+  Memory m;
+  fill(m);
+  std::string base = snapshot(m);
+  check(!m.canSaveChanges(),"changes before the first save");
+  m.markSaved();
+  check(m.canSaveChanges() && m.getChangeCount() == 0,"changes after a save");
+  m.store(8,1,0);
+  m.store(std::string("ANOTHER STRING"),3,0);
+  m.store(-1,4,150);
+  m.resize(6,20);
+  m.store(1.25,6,19);
+  m.resize(7,10);
+  std::ostringstream s1;
+  m.saveChanges(s1);
+  std::string delta1 = s1.str();
+  check(delta1.size() < base.size(),"size of the changes");
+  m.store(9,1,0);
+  m.resize(5,300);
+  m.store(std::string("LAST"),5,299);
+  std::ostringstream s2;
+  m.saveChanges(s2);
+  std::string delta2 = s2.str();
+  Memory r;
+  r.restoreSnapshot(base.data(),base.size());
+  r.restoreSnapshot(delta1.data(),delta1.size());
+  check(r.getInt(1) == 8 && r.getValue(4,150).getInt() == -1 && r.getSize(6) == 20 && r.getSize(7) == 10,"first changes");
+  r.restoreSnapshot(delta2.data(),delta2.size());
+  check(same(m,r),"changes on top of a snapshot");
+  check(snapshot(r) == snapshot(m),"snapshot after the changes");
+  /* a damaged snapshot of the changes leaves the memory alone */
+  std::string damaged = delta2;
+  damaged[SNAPSHOT_DATA_OFFSET] ^= 1;
+  Memory d;
+  d.restoreSnapshot(base.data(),base.size());
+  d.restoreSnapshot(delta1.data(),delta1.size());
+  bool thrown = false;
+  try
+  {
+    d.restoreSnapshot(damaged.data(),damaged.size());
+  }
+  catch (std::runtime_error&)
+  {
+    thrown = true;
+  }
+  check(thrown && d.getInt(1) == 8 && d.getSize(5) == 1,"damaged changes");
+}
+
+static void testDamaged()
+{
+  Memory m;
+  fill(m);
+  std::string data = snapshot(m);
+  std::string version = data;
+  uint32_t v = MEMORY_SNAPSHOT_VERSION + 1;
+  memcpy(&version[SNAPSHOT_VERSION_OFFSET],&v,sizeof(v));
+  check(rejected(version),"other version");
+  std::string damaged = data;
+  damaged[SNAPSHOT_DATA_OFFSET] ^= 1;
+  check(rejected(damaged),"wrong checksum");
+  damaged = data;
+  damaged[data.size()/2] ^= 0x10;
+  check(rejected(damaged),"wrong checksum in the values");
+  check(rejected(data.substr(0,data.size()-8)),"truncated snapshot");
+  check(rejected(data.substr(0,SNAPSHOT_DATA_OFFSET)),"snapshot without data");
+  check(rejected(addSection(data,0)),"section id 0");
+  check(!rejected(addSection(data,1000)),"unknown section");
+  /* the arrays 4 and 7 follow the slots */
+  check(!rejected(setExtent(data,7,ADDRESSES+200,80)),"same ranges");
+  check(rejected(setExtent(data,1,1,2)),"two values in a slot");
+  check(rejected(setExtent(data,1,2,1)),"slot of another address");
+  check(rejected(setExtent(data,7,ADDRESSES+150,80)),"overlapping arrays");
+}
+
+static void testJson()
+{
+  Memory m;
+  fill(m);
+  Memory r;
+  r.restore(nlohmann::json::parse(m.save().dump()));
+  check(same(m,r),"JSON round trip");
+}
+
+/*
+ * The writes after a checkpoint copy the slots and the pages they touch, so
+ * the checkpoint keeps the old values.
+ */
+static void testCheckpoint()
+{
+  Memory m;
+  fill(m);
+  m.markSaved();
+  Memory::Checkpoint c1 = m.checkpoint();
+  m.store(8,1,0);
+  m.store(-1,4,150);
+  check(m.getChangeCount() == 2,"pages changed by two values");
+  m.store(std::string("CHANGED STRING"),3,0);
+  m.store(std::string("NEW"),7,5);
+  m.store(3.5,99,0);
+  Memory::Checkpoint c2 = m.checkpoint();
+  std::vector<uint32_t> written = { 1, 3, 4, 7, 99 };
+  check(Memory::diff(c1,c2) == written,"diff of the written addresses");
+  check(Memory::diff(c2,c1) == written,"diff in reverse");
+  check(Memory::diff(c1,c1).empty(),"diff of a checkpoint with itself");
+  m.store(8,1,0);
+  m.store(std::string("NEW"),7,5);
+  check(Memory::diff(c2,m.checkpoint()).empty(),"diff after writing the same values");
+  m.resize(6,30);
+  check(Memory::diff(c2,m.checkpoint()) == std::vector<uint32_t>{ 6 },"diff of a resized array");
+  m.restore(c1);
+  check(m.getInt(1) == 7 && m.getString(3) == "A STRING" && m.getValue(4,150).getInt() == 450
+        && m.getValue(7,5).getString() == "ELEMENT 5" && m.getDouble(99) == -0.5 && m.getSize(6) == 0,"restored values");
+  check(!m.canSaveChanges(),"changes after a restore");
+  m.store(100,1,0);
+  Memory r;
+  r.restore(c1);
+  check(r.getInt(1) == 7,"checkpoint after writing the restored memory");
+  r.restore(c2);
+  check(r.getInt(1) == 8 && r.getString(3) == "CHANGED STRING" && r.getValue(4,150).getInt() == -1 && r.getSize(6) == 0,"second checkpoint");
+}
+
+static void testThread()
+{
+  Memory m;
+  fill(m);
+  Memory::Checkpoint c = m.checkpoint();
+  bool thrown = false;
+  std::thread t([&]() {
+    Memory f;
+    try
+    {
+      f.restore(c);
+    }
+    catch (std::runtime_error&)
+    {
+      thrown = true;
+    }
+  });
+  t.join();
+  check(thrown,"checkpoint of another thread");
+}
+
+/* a checkpoint restored with another heap shares no strings with its memory */
+static void testFork()
+{
+  Memory m;
+  fill(m);
+  Memory::Checkpoint c = m.checkpoint();
+  StringHeap heap;
+  StringHeap::Scope scope(&heap);
+  Memory f;
+  f.restore(c);
+  check(same(m,f),"fork");
+  check(f.getValue(7,79).getChars() != m.getValue(7,79).getChars(),"strings of a fork");
+  m.reset(ADDRESSES);
+  heap.collect();
+  check(f.getValue(7,79).getString() == "ELEMENT 79","fork after a reset");
+}
+
+static std::string run(const std::filesystem::path& dir, const std::string& keys)
+{
+  Console::reset(keys);
+  std::shared_ptr<InputStream> is = std::make_shared<InputStream>();
+  std::shared_ptr<OutputStream> os = std::make_shared<OutputStream>(nullptr);
+  VM vm(is,os);
+  Compiler compiler;
+  std::shared_ptr<Executable> x(compiler.compile((dir / "bsave").string()));
+  if (!x) throw std::runtime_error("cannot compile the program");
+  vm.setDisk(dir.string());
+  vm.run(x);
+  return Console::getTranscript();
+}
+
+static bool endsWith(const std::string& s, const std::string& end)
+{
+  return s.size() >= end.size() && s.compare(s.size()-end.size(),end.size(),end) == 0;
+}
+
+/*
+ * The second and third BSAVE append their changes to the first one, so
+ * BLOAD replays all of them. A log cut in the last record, like a save
+ * which was interrupted, is loaded up to the record before. The full
+ * snapshot at the start of the log is then converted to the JSON of older
+ * versions and loaded by the same program.
+ */
+static void testLog()
+{
+  std::filesystem::path dir = std::filesystem::temp_directory_path() / "eamon-memory-test";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  std::ofstream(dir / "bsave") << program;
+  check(endsWith(run(dir,"\n"),"3 9 5 THREE\n"),"BLOAD of the log");
+  std::ifstream in(dir / "mem",std::ios::binary);
+  uint32_t addr = 0;
+  uint32_t len = 0;
+  in.read(reinterpret_cast<char*>(&addr),sizeof(addr));
+  in.read(reinterpret_cast<char*>(&len),sizeof(len));
+  std::string base(len,0);
+  in.read(&base[0],len);
+  int deltas = 0;
+  while (in.read(reinterpret_cast<char*>(&len),sizeof(len)))
+  {
+    in.seekg(len,std::ios::cur);
+    deltas++;
+  }
+  check(in.eof() && addr == 0x69 && deltas == 2,"log of BSAVE");
+  in.close();
+  std::filesystem::resize_file(dir / "mem",std::filesystem::file_size(dir / "mem") - 3);
+  check(endsWith(run(dir,"MEM\n"),"2 8 5 TWO\n"),"BLOAD of a torn log");
+  Memory m;
+  m.restoreSnapshot(base.data(),base.size());
+  std::string json = m.save().dump();
+  std::ofstream out(dir / "old",std::ios::binary);
+  len = static_cast<uint32_t>(json.size());
+  out.write(reinterpret_cast<const char*>(&addr),sizeof(addr));
+  out.write(reinterpret_cast<const char*>(&len),sizeof(len));
+  out << json;
+  out.close();
+  check(endsWith(run(dir,"OLD\n"),"1 7 0 ONE\n"),"BLOAD of JSON");
+  std::filesystem::remove_all(dir);
+}
+
+int main()
+{
+  StringHeap heap;
+  StringHeap::Scope scope(&heap);
+  try
+  {
+    testSnapshot();
+    testChanges();
+    testDamaged();
+    testJson();
+    testCheckpoint();
+    testThread();
+    testFork();
+    testLog();
+  }
+  catch (std::exception& ex)
+  {
+    std::cerr << ex.what() << std::endl;
+    return 2;
+  }
+  std::cout << failed << " of " << checks << " checks failed" << std::endl;
+  return failed > 0 ? 1 : 0;
+}
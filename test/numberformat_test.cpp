@@ -0,0 +1,158 @@
+/********************************************************************************
+ *                                                                              *
+ * EamonInterpreter - number format test                                        *
+ *                                                                              *
+ * modified: 2026-10-17                                                         *
+ *                                                                              *
+ ********************************************************************************
+ * Copyright (C) Harald Braeuning                                               *
+ ********************************************************************************
+ * This file is part of EamonInterpreter.                                       *
+ * EamonInterpreter is free software: you can redistribute it and/or modify it  *
+ * under the terms of the GNU General Public License as published by the Free   *
+ * Software Foundation, either version 3 of the License, or (at your option)    *
+ * any later version.                                                           *
+ * EamonInterpreter is distributed in the hope that it will be useful, but      *
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY   *
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for  *
+ * more details.                                                                *
+ * You should have received a copy of the GNU General Public License along with *
+ * EamonInterpreter. If not, see <https://www.gnu.org/licenses/>.               *
+ ********************************************************************************/
+
+#include "runtime/numberformat.h"
+#include <math.h>
+#include <stdint.h>
+#include <iostream>
+#include <iterator>
+#include <string>
+
+/*
+ * Compares the texts of PRINT and STR$ and the results of VAL with the ones
+ * of Applesoft BASIC.
+ *
+ * usage: numberformat_test
+ */
+
+struct Formatted
+{
+  double value;
+  const char* text;
+};
+
+struct Scanned
+{
+  const char* text;
+  double value;
+  int32_t integer;
+};
+
+static const Formatted formatted[] = {
+  /* fixed point from .01 up to 999999999, without a leading zero */
+  { 0, "0" },
+  { -0.0, "0" },
+  { 0.5, ".5" },
+  { -0.25, "-.25" },
+  { 0.1, ".1" },
+  { 0.01, ".01" },
+  { 0.0123456789, ".0123456789" },
+  { 12.5, "12.5" },
+  { 1234.5678, "1234.5678" },
+  { 999999999, "999999999" },
+  { 999999999.4, "999999999" },
+  { -999999999, "-999999999" },
+  /* 9 significant digits */
+  { 1.0/3, ".333333333" },
+  { 2.0/3, ".666666667" },
+  { -2.0/3, "-.666666667" },
+  { 123456789.6, "123456790" },
+  { 99999.99999, "100000" },
+  /* exponent below .01 and from 1E+09 on */
+  { 0.0099999999, "9.9999999E-03" },
+  { 0.001, "1E-03" },
+  { 0.0015, "1.5E-03" },
+  { -0.0015, "-1.5E-03" },
+  { 1.23456789e-5, "1.23456789E-05" },
+  { 1e-10, "1E-10" },
+  { 2.93873588e-39, "2.93873588E-39" },
+  { 999999999.6, "1E+09" },
+  { 1e9, "1E+09" },
+  { -1e9, "-1E+09" },
+  { 1e15, "1E+15" },
+  { 1.70141183e38, "1.70141183E+38" },
+  { -1e38, "-1E+38" }
+};
+
+static const Scanned scanned[] = {
+  { "", 0, 0 },
+  { "ABC", 0, 0 },
+  { "$5", 0, 0 },
+  { ".", 0, 0 },
+  { "  -", 0, 0 },
+  { "--1", 0, 0 },
+  { "-.E5", 0, 0 },
+  { "inf", 0, 0 },
+  { "nan", 0, 0 },
+  { "12ABC", 12, 12 },
+  { " 1 2 3", 123, 123 },
+  { " . 5", 0.5, 0 },
+  { "+7", 7, 7 },
+  { "-.5", -0.5, 0 },
+  { "2.7", 2.7, 2 },
+  { "-2.7", -2.7, -2 },
+  { "1,000", 1, 1 },
+  { "1..2", 1, 1 },
+  { "1E", 1, 1 },
+  { "1E3", 1000, 1000 },
+  { "1E+2", 100, 100 },
+  { "1.5E-3X", 0.0015, 0 },
+  /* overflow */
+  { "3E9", 3e9, 2147483647 },
+  { "-3E9", -3e9, -2147483647-1 },
+  { "1E400", HUGE_VAL, 2147483647 },
+  { "-1E400", -HUGE_VAL, -2147483647-1 },
+  { "1E-400", 0, 0 }
+};
+
+static const int32_t integers[] = { 0, -1, 255, -256, 2147483647, -2147483647-1 };
+
+
+
+int main()
+{
+  int failed = 0;
+  for (const Formatted& f : formatted)
+  {
+    std::string s = NumberFormat::toString(f.value);
+    if (s != f.text)
+    {
+      std::cerr << "format " << f.value << ": expected " << f.text << ", got " << s << std::endl;
+      failed++;
+    }
+  }
+  /* twice, so the cached texts are checked as well */
+  for (int pass=0;pass<2;pass++)
+  {
+    for (int32_t i : integers)
+    {
+      std::string s = NumberFormat::toString(i);
+      if (s != std::to_string(i))
+      {
+        std::cerr << "format " << i << ": got " << s << std::endl;
+        failed++;
+      }
+    }
+  }
+  for (const Scanned& s : scanned)
+  {
+    double v = NumberFormat::scan(s.text);
+    int32_t i = NumberFormat::scanInt(s.text);
+    if (v != s.value || i != s.integer)
+    {
+      std::cerr << "scan \"" << s.text << "\": expected " << s.value << " and " << s.integer << ", got " << v << " and " << i << std::endl;
+      failed++;
+    }
+  }
+  std::cout << failed << " of " << std::size(formatted) + 2 * std::size(integers) + std::size(scanned) << " checks failed" << std::endl;
+  return failed > 0 ? 1 : 0;
+}
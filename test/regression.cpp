@@ -0,0 +1,219 @@
+/********************************************************************************
+ *                                                                              *
+ * EamonInterpreter - backend regression test                                   *
+ *                                                                              *
+ * modified: 2026-10-17                                                         *
+ *                                                                              *
+ ********************************************************************************
+ * Copyright (C) Harald Braeuning                                               *
+ ********************************************************************************
+ * This file is part of EamonInterpreter.                                       *
+ * EamonInterpreter is free software: you can redistribute it and/or modify it  *
+ * under the terms of the GNU General Public License as published by the Free   *
+ * Software Foundation, either version 3 of the License, or (at your option)    *
+ * any later version.                                                           *
+ * EamonInterpreter is distributed in the hope that it will be useful, but      *
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY   *
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for  *
+ * more details.                                                                *
+ * You should have received a copy of the GNU General Public License along with *
+ * EamonInterpreter. If not, see <https://www.gnu.org/licenses/>.               *
+ ********************************************************************************/
+
+#include "console.h"
+#include "runtime/compiler.h"
+#include "runtime/executable.h"
+#include "runtime/inputstream.h"
+#include "runtime/outputstream.h"
+#include "runtime/vm.h"
+#include <stdlib.h>
+#include <time.h>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*
+ * Runs a program with scripted input on every backend of the virtual
+ * machine and compares the transcript and the files on the disk with the
+ * ones of the stack machine byte by byte. The stack machine runs again
+ * with the switch dispatch engine and on the checked stack, which verified
+ * code otherwise skips. Every backend works on its own copy of the disk.
+ * The verified JIT compiler additionally repeats every compiled block in
+ * the interpreter and stops at the first difference. The run time of each
+ * backend is printed as well, so the programs in bench are run the same
+ * way.
+ *
+ * usage: regression <disk> <program> [<script>]
+ */
+
+struct Configuration
+{
+  const char* name;
+  VM::Backend backend;
+  VM::DispatchMode dispatch;
+  bool uncheckedStack;
+  bool jit;
+  bool verifyJit;
+};
+
+/*
+ * Without threaded dispatch in the build the stack machine runs the switch
+ * engine anyway; without a JIT the last two run the register machine again.
+ */
+static const Configuration configurations[] = {
+  { "stack machine", VM::StackBackend, VM::ThreadedDispatch, true, false, false },
+  { "switch dispatch", VM::StackBackend, VM::SwitchDispatch, true, false, false },
+  { "checked stack", VM::StackBackend, VM::ThreadedDispatch, false, false, false },
+  { "register machine", VM::RegisterBackend, VM::ThreadedDispatch, true, false, false },
+  { "JIT compiler", VM::RegisterBackend, VM::ThreadedDispatch, true, true, false },
+  { "verified JIT compiler", VM::RegisterBackend, VM::ThreadedDispatch, true, true, true }
+};
+
+struct Result
+{
+  std::string transcript;
+  std::string error;
+  std::map<std::string,std::string> files;
+};
+
+
+
+static std::string readFile(const std::filesystem::path& path)
+{
+  std::ifstream in(path,std::ios::binary);
+  if (!in) throw std::runtime_error("cannot read "+path.string());
+  std::ostringstream s;
+  s << in.rdbuf();
+  return s.str();
+}
+
+/*
+ * Runs the program and all programs it chains to like the main window does.
+ * An error ends the run; it is part of the transcript, since all backends
+ * must fail the same way.
+ */
+static Result run(const Configuration& c, const std::filesystem::path& disk, const std::string& program, const std::string& keys)
+{
+  std::filesystem::path dir = std::filesystem::temp_directory_path() / "eamon-regression" / c.name;
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir.parent_path());
+  std::filesystem::copy(disk,dir,std::filesystem::copy_options::recursive);
+  Console::reset(keys);
+  srand(1);
+  std::shared_ptr<InputStream> is = std::make_shared<InputStream>();
+  std::shared_ptr<OutputStream> os = std::make_shared<OutputStream>(nullptr);
+  VM vm(is,os);
+  Result r;
+  vm.setBackend(c.backend);
+  vm.setDispatchMode(c.dispatch);
+  vm.setUncheckedStackEnabled(c.uncheckedStack);
+  vm.setJitEnabled(c.jit);
+  vm.setJitVerification(c.verifyJit);
+  std::string file = program;
+  while (!file.empty())
+  {
+    Compiler compiler;
+    std::shared_ptr<Executable> x(compiler.compile((dir / file).string()));
+    if (!x) throw std::runtime_error("cannot compile "+file);
+    vm.setDisk(dir.string());
+    try
+    {
+      vm.run(x);
+    }
+    catch (std::exception& ex)
+    {
+      r.error = ex.what();
+      break;
+    }
+    file = vm.getChainedFile();
+  }
+  r.transcript = Console::getTranscript();
+  for (const auto& e : std::filesystem::directory_iterator(dir))
+  {
+    r.files[e.path().filename().string()] = readFile(e.path());
+  }
+  return r;
+}
+
+static bool compare(const char* what, const std::string& expected, const std::string& actual)
+{
+  if (expected == actual) return true;
+  size_t n = 0;
+  while (n < expected.size() && n < actual.size() && expected[n] == actual[n]) n++;
+  size_t from = n > 40 ? n - 40 : 0;
+  std::cerr << what << " differs at byte " << n << std::endl;
+  std::cerr << "expected: ..." << expected.substr(from,80) << std::endl;
+  std::cerr << "actual:   ..." << actual.substr(from,80) << std::endl;
+  return false;
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc < 3 || argc > 4)
+  {
+    std::cerr << "usage: regression <disk> <program> [<script>]" << std::endl;
+    return 2;
+  }
+  try
+  {
+    std::string keys = argc > 3 ? readFile(argv[3]) : "";
+    std::vector<Result> results;
+    bool ok = true;
+    for (const Configuration& c : configurations)
+    {
+      auto start = std::chrono::steady_clock::now();
+      results.push_back(run(c,argv[1],argv[2],keys));
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+      const Result& expected = results.front();
+      const Result& actual = results.back();
+      std::cout << c.name << ": " << actual.transcript.size() << " bytes of output in " << elapsed.count() << " s" << std::endl;
+      if (!compare("transcript",expected.transcript,actual.transcript)) ok = false;
+      if (!compare("error",expected.error,actual.error)) ok = false;
+      for (const auto& f : expected.files)
+      {
+        auto i = actual.files.find(f.first);
+        if (i == actual.files.end())
+        {
+          std::cerr << "file " << f.first << " is missing" << std::endl;
+          ok = false;
+        }
+        else if (!compare(("file "+f.first).c_str(),f.second,i->second))
+        {
+          ok = false;
+        }
+      }
+      if (actual.files.size() != expected.files.size())
+      {
+        std::cerr << "the disk holds " << actual.files.size() << " instead of " << expected.files.size() << " files" << std::endl;
+        ok = false;
+      }
+      if (!ok)
+      {
+        std::cerr << c.name << " differs from " << configurations[0].name << std::endl;
+        return 1;
+      }
+    }
+  }
+  catch (std::exception& ex)
+  {
+    std::cerr << ex.what() << std::endl;
+    return 2;
+  }
+  return 0;
+}
+
+/*
+ * PEEK(78) and PEEK(79) read the clock to seed RND. A fixed clock gives all
+ * backends the same random numbers.
+ */
+extern "C" time_t time(time_t* t)
+{
+  if (t != nullptr) *t = 1000000;
+  return 1000000;
+}